@@ -7,6 +7,7 @@
 #include "_global.h"
 #include "bridgemain.h"
 #include <stdio.h>
+#include <unordered_map>
 #include "Utf8Ini.h"
 
 static HINSTANCE hInst;
@@ -15,6 +16,25 @@ static wchar_t szIniFile[MAX_PATH] = L"";
 static CRITICAL_SECTION csIni;
 static bool bDisableGUIUpdate;
 
+/*
+A resolved setting, parsed once when it is resolved and again every time it is set.
+The typed values are published with a sequence number (odd while being updated) so
+they can be read without taking csIni, the string value is read under csIni.
+*/
+struct SETTINGSLOT_
+{
+    std::string section;
+    std::string key;
+    volatile LONG sequence;
+    bool hasValue;
+    bool uintValid;
+    duint uintValue;
+    std::string stringValue;
+};
+
+// "section\nkey" -> slot, the slots are never freed because the handles can be kept anywhere
+static std::unordered_map<std::string, SETTINGSLOT_*> settingSlots;
+
 #define CHEKC_GUI_UPDATE_DISABLED \
     if (bDisableGUIUpdate) \
         return;
@@ -124,6 +144,39 @@ BRIDGE_IMPEXP void BridgeFree(void* ptr)
         GlobalFree(ptr);
 }
 
+//call with csIni held
+static void settingSlotUpdate(SETTINGSLOT_* slot)
+{
+    std::string value = settings.GetValue(slot->section, slot->key);
+    duint uintValue = 0;
+#ifdef _WIN64
+    bool uintValid = value.length() && sscanf(value.c_str(), "%llX", &uintValue) == 1;
+#else
+    bool uintValid = value.length() && sscanf(value.c_str(), "%X", &uintValue) == 1;
+#endif //_WIN64
+    InterlockedIncrement(&slot->sequence);
+    slot->hasValue = value.length() > 0;
+    slot->uintValid = uintValid;
+    slot->uintValue = uintValue;
+    slot->stringValue = std::move(value);
+    InterlockedIncrement(&slot->sequence);
+}
+
+//call with csIni held, key == nullptr updates the whole section and section == nullptr everything
+static void settingSlotsUpdate(const char* section, const char* key)
+{
+    if(section && key)
+    {
+        auto found = settingSlots.find(std::string(section) + '\n' + key);
+        if(found != settingSlots.end())
+            settingSlotUpdate(found->second);
+        return;
+    }
+    for(auto & slot : settingSlots)
+        if(!section || slot.second->section == section)
+            settingSlotUpdate(slot.second);
+}
+
 BRIDGE_IMPEXP bool BridgeSettingGet(const char* section, const char* key, char* value)
 {
     if(!section || !key || !value)
@@ -166,6 +219,8 @@ BRIDGE_IMPEXP bool BridgeSettingSet(const char* section, const char* key, const
             success = settings.SetValue(section, key, "");
         else
             success = settings.SetValue(section, key, value);
+        if(success)
+            settingSlotsUpdate(section, key);
         LeaveCriticalSection(&csIni);
     }
     return success;
@@ -236,11 +291,84 @@ BRIDGE_IMPEXP bool BridgeSettingRead(int* errorLine)
         success = settings.Deserialize(iniData, errline);
         if(errorLine)
             *errorLine = errline;
+        settingSlotsUpdate(nullptr, nullptr);
         LeaveCriticalSection(&csIni);
     }
     return success;
 }
 
+/**
+\brief Resolves a setting to a handle that can be read without looking it up again.
+\param section The section of the setting (UTF-8).
+\param key The key of the setting (UTF-8).
+\return The handle, it stays valid until the process exits. nullptr if section or key is nullptr.
+*/
+BRIDGE_IMPEXP SETTINGHANDLE BridgeSettingResolve(const char* section, const char* key)
+{
+    if(!section || !key)
+        return nullptr;
+    std::string name = std::string(section) + '\n' + key;
+    EnterCriticalSection(&csIni);
+    auto & slot = settingSlots[name];
+    if(!slot)
+    {
+        slot = new SETTINGSLOT_;
+        slot->section = section;
+        slot->key = key;
+        slot->sequence = 0;
+        settingSlotUpdate(slot);
+    }
+    auto result = slot;
+    LeaveCriticalSection(&csIni);
+    return result;
+}
+
+BRIDGE_IMPEXP bool BridgeSettingGetHandle(SETTINGHANDLE handle, char* value)
+{
+    if(!handle || !value)
+        return false;
+    EnterCriticalSection(&csIni);
+    bool result = handle->hasValue;
+    if(result)
+        strcpy_s(value, MAX_SETTING_SIZE, handle->stringValue.c_str());
+    LeaveCriticalSection(&csIni);
+    return result;
+}
+
+BRIDGE_IMPEXP bool BridgeSettingGetUintHandle(SETTINGHANDLE handle, duint* value)
+{
+    if(!handle || !value)
+        return false;
+    for(;;)
+    {
+        LONG sequence = handle->sequence;
+        if(sequence & 1) //being updated
+        {
+            YieldProcessor();
+            continue;
+        }
+        MemoryBarrier();
+        bool valid = handle->uintValid;
+        duint result = handle->uintValue;
+        MemoryBarrier();
+        if(handle->sequence != sequence)
+            continue;
+        if(valid)
+            *value = result;
+        return valid;
+    }
+}
+
+/**
+\brief Gets a boolean setting through its handle.
+\return true if the setting was set and is not zero, like settingboolget.
+*/
+BRIDGE_IMPEXP bool BridgeSettingGetBoolHandle(SETTINGHANDLE handle)
+{
+    duint value;
+    return BridgeSettingGetUintHandle(handle, &value) && value != 0;
+}
+
 BRIDGE_IMPEXP int BridgeGetDbgVersion()
 {
     return DBG_VERSION;
@@ -1375,6 +1503,11 @@ BRIDGE_IMPEXP void GuiFocusView(int hWindow)
     _gui_sendmessage(GUI_FOCUS_VIEW, (void*)hWindow, nullptr);
 }
 
+BRIDGE_IMPEXP void GuiPaintBenchmark(int count)
+{
+    _gui_sendmessage(GUI_PAINT_BENCHMARK, (void*)count, nullptr);
+}
+
 BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved)
 {
     hInst = hinstDLL;
@@ -42,6 +42,9 @@ extern "C"
 #define MAX_SETTING_SIZE 65536
 #define DBG_VERSION 25
 
+//Bridge typedefs
+typedef struct SETTINGSLOT_* SETTINGHANDLE;
+
 //Bridge functions
 BRIDGE_IMPEXP const char* BridgeInit();
 BRIDGE_IMPEXP const char* BridgeStart();
@@ -53,6 +56,10 @@ BRIDGE_IMPEXP bool BridgeSettingSet(const char* section, const char* key, const
 BRIDGE_IMPEXP bool BridgeSettingSetUint(const char* section, const char* key, duint value);
 BRIDGE_IMPEXP bool BridgeSettingFlush();
 BRIDGE_IMPEXP bool BridgeSettingRead(int* errorLine);
+BRIDGE_IMPEXP SETTINGHANDLE BridgeSettingResolve(const char* section, const char* key);
+BRIDGE_IMPEXP bool BridgeSettingGetHandle(SETTINGHANDLE handle, char* value);
+BRIDGE_IMPEXP bool BridgeSettingGetUintHandle(SETTINGHANDLE handle, duint* value);
+BRIDGE_IMPEXP bool BridgeSettingGetBoolHandle(SETTINGHANDLE handle);
 BRIDGE_IMPEXP int BridgeGetDbgVersion();
 
 //Debugger defines
@@ -853,6 +860,7 @@ typedef enum
     GUI_UNREGISTER_SCRIPT_LANG,     // param1=int id,               param2=unused
     GUI_UPDATE_ARGUMENT_VIEW,       // param1=unused,               param2=unused
     GUI_FOCUS_VIEW,                 // param1=int hWindow,          param2=unused
+    GUI_PAINT_BENCHMARK,            // param1=int count,            param2=unused
 } GUIMSG;
 
 //GUI Typedefs
@@ -969,6 +977,7 @@ BRIDGE_IMPEXP void GuiRegisterScriptLanguage(SCRIPTTYPEINFO* info);
 BRIDGE_IMPEXP void GuiUnregisterScriptLanguage(int id);
 BRIDGE_IMPEXP void GuiUpdateArgumentWidget();
 BRIDGE_IMPEXP void GuiFocusView(int hWindow);
+BRIDGE_IMPEXP void GuiPaintBenchmark(int count);
 BRIDGE_IMPEXP bool GuiIsUpdateDisabled();
 BRIDGE_IMPEXP void GuiUpdateEnable(bool updateNow);
 BRIDGE_IMPEXP void GuiUpdateDisable();
@@ -4,28 +4,54 @@
 #include "memory.h"
 #include "threading.h"
 #include "console.h"
+#include "filehelper.h"
+#include "handle.h"
+#include "lz4\lz4.h"
+#include "function.h"
+#include "label.h"
 #include <algorithm>
 
 TraceRecordManager TraceRecord;
 
-TraceRecordManager::TraceRecordManager() : instructionCounter(0)
+TraceRecordManager::TraceRecordManager() : traceQuiescent(0), instructionCounter(0), generation(1), modified(0), savedGeneration(0)
 {
     ModuleNames.emplace_back("");
+    PageDirectory = (PageTableEntry * volatile*)VirtualAlloc(nullptr, sizeof(PageTableEntry*) << PageTableDirectoryBits, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
 }
 
 TraceRecordManager::~TraceRecordManager()
 {
     clear();
+    {
+        EXCLUSIVE_ACQUIRE(LockTraceRecord);
+        freeRetiredMemory(true);
+    }
+    if(PageDirectory)
+    {
+        for(duint i = 0; i < (duint(1) << PageTableDirectoryBits); i++)
+            if(PageDirectory[i])
+                VirtualFree((void*)PageDirectory[i], 0, MEM_RELEASE);
+        VirtualFree((void*)PageDirectory, 0, MEM_RELEASE);
+    }
 }
 
 void TraceRecordManager::clear()
 {
     EXCLUSIVE_ACQUIRE(LockTraceRecord);
     for(auto i = TraceRecord.begin(); i != TraceRecord.end(); i++)
-        efree(i->second.rawPtr, "TraceRecordManager");
+    {
+        unmapPage(i->second);
+        retireMemory(i->second.rawPtr, i->second.dataType == TraceRecordType::TraceRecordByteWithExecTypeAndFullCounter);
+    }
     TraceRecord.clear();
+    {
+        EXCLUSIVE_ACQUIRE(LockTraceRecordCounters);
+        CounterOverflow.clear();
+    }
+    freeRetiredMemory(false);
     ModuleNames.clear();
     ModuleNames.emplace_back("");
+    InterlockedIncrement(&generation);
 }
 
 bool TraceRecordManager::setTraceRecordType(duint pageAddress, TraceRecordType type)
@@ -46,6 +72,7 @@ bool TraceRecordManager::setTraceRecordType(duint pageAddress, TraceRecordType t
                 memset(newPage.rawPtr, 0, 4096 / 8);
                 break;
             case TraceRecordByteWithExecTypeAndCounter:
+            case TraceRecordByteWithExecTypeAndFullCounter:
                 newPage.rawPtr = emalloc(4096, "TraceRecordManager");
                 memset(newPage.rawPtr, 0, 4096);
                 break;
@@ -57,13 +84,18 @@ bool TraceRecordManager::setTraceRecordType(duint pageAddress, TraceRecordType t
                 return false;
             }
             newPage.dataType = type;
+            newPage.va = 0;
+            newPage.mapped = nullptr;
             if(ModNameFromAddr(pageAddress, modName, true))
             {
                 newPage.rva = pageAddress - ModBaseFromAddr(pageAddress);
                 newPage.moduleIndex = getModuleIndex(std::string(modName));
             }
             else
+            {
+                newPage.rva = pageAddress;
                 newPage.moduleIndex = ~0;
+            }
 
             auto inserted = TraceRecord.insert(std::make_pair(ModHashFromAddr(pageAddress), newPage));
             if(inserted.second == false) // we failed to insert new page into the map
@@ -71,6 +103,8 @@ bool TraceRecordManager::setTraceRecordType(duint pageAddress, TraceRecordType t
                 efree(newPage.rawPtr);
                 return false;
             }
+            mapPage(pageAddress, inserted.first->second);
+            InterlockedIncrement(&generation);
             return true;
         }
         else
@@ -82,8 +116,12 @@ bool TraceRecordManager::setTraceRecordType(duint pageAddress, TraceRecordType t
         {
             if(pageInfo != TraceRecord.end())
             {
-                efree(pageInfo->second.rawPtr, "TraceRecordManager");
+                unmapPage(pageInfo->second);
+                eraseOverflowCounts(pageInfo->second);
+                retireMemory(pageInfo->second.rawPtr, pageInfo->second.dataType == TraceRecordType::TraceRecordByteWithExecTypeAndFullCounter);
                 TraceRecord.erase(pageInfo);
+                freeRetiredMemory(false);
+                InterlockedIncrement(&generation);
             }
             return true;
         }
@@ -95,32 +133,75 @@ bool TraceRecordManager::setTraceRecordType(duint pageAddress, TraceRecordType t
 TraceRecordManager::TraceRecordType TraceRecordManager::getTraceRecordType(duint pageAddress)
 {
     SHARED_ACQUIRE(LockTraceRecord);
-    pageAddress &= ~((duint)4096 - 1);
-    auto pageInfo = TraceRecord.find(ModHashFromAddr(pageAddress));
-    if(pageInfo == TraceRecord.end())
+    auto pageInfo = lookupPage(pageAddress);
+    if(!pageInfo)
         return TraceRecordNone;
     else
-        return pageInfo->second.dataType;
+        return pageInfo->dataType;
 }
 
+/**
+\brief Records the execution of an instruction. Only call this on the debugging thread, it does not take LockTraceRecord.
+*/
 void TraceRecordManager::TraceExecute(duint address, duint size)
 {
-    SHARED_ACQUIRE(LockTraceRecord);
     if(size == 0)
         return;
-    duint base = address & ~((duint)4096 - 1);
-    auto pageInfoIterator = TraceRecord.find(ModHashFromAddr(base));
-    if(pageInfoIterator == TraceRecord.end())
+    auto pageInfoPtr = lookupPage(address);
+    if(!pageInfoPtr)
+        return;
+    traceExecutePage(*pageInfoPtr, address, size);
+    InterlockedIncrement(&traceQuiescent);
+}
+
+/**
+\brief Records the execution of the instruction at address (if its page has a trace record) and counts it.
+       Only call this on the debugging thread, it does not take LockTraceRecord.
+*/
+void TraceRecordManager::TraceInstruction(duint address)
+{
+    auto pageInfoPtr = lookupPage(address);
+    if(!pageInfoPtr)
+    {
+        increaseInstructionCounter();
         return;
-    TraceRecordPage pageInfo;
-    pageInfo = pageInfoIterator->second;
+    }
+    unsigned char buffer[16];
+    duint size;
+    if(!MemRead(address, buffer, 16))
+    {
+        duint base = MemFindBaseAddr(address, &size);
+        if(address - base + 16 <= size) // Only CIP near the end of the page is a corner case
+            size = 0;
+        else
+            size = base + size - address;
+        // if the memory can't be read, then the executable had executed an invalid address. Don't trace it.
+        if(!size || !MemRead(address, buffer, size))
+        {
+            InterlockedIncrement(&traceQuiescent);
+            return;
+        }
+    }
+    BASIC_INSTRUCTION_INFO basicInfo;
+    increaseInstructionCounter();
+    DbgDisasmFastAt(address, &basicInfo);
+    if(basicInfo.size)
+        traceExecutePage(*pageInfoPtr, address, basicInfo.size);
+    InterlockedIncrement(&traceQuiescent);
+}
+
+//lock-free, the caller increments traceQuiescent when it no longer uses pageInfo
+void TraceRecordManager::traceExecutePage(const TraceRecordPage & pageInfo, duint address, duint size)
+{
+    duint base = address & ~((duint)4096 - 1);
     duint offset = address - base;
     bool isMixed;
     if((offset + size) > 4096) // execution crossed page boundary, splitting into 2 sub calls. Noting that byte type may be mislabelled.
     {
-        SHARED_RELEASE();
-        TraceExecute(address, 4096 - offset);
-        TraceExecute(base + 4096, size + offset - 4096);
+        traceExecutePage(pageInfo, address, 4096 - offset);
+        auto nextPage = lookupPage(base + 4096);
+        if(nextPage)
+            traceExecutePage(*nextPage, base + 4096, size + offset - 4096);
         return;
     }
     isMixed = false;
@@ -132,6 +213,7 @@ void TraceRecordManager::TraceExecute(duint address, duint size)
         break;
 
     case TraceRecordType::TraceRecordByteWithExecTypeAndCounter:
+    case TraceRecordType::TraceRecordByteWithExecTypeAndFullCounter:
         for(unsigned char i = 0; i < size; i++)
         {
             TraceRecordByteType_2bit currentByteType;
@@ -152,6 +234,8 @@ void TraceRecordManager::TraceExecute(duint address, duint size)
             else
             {
                 isMixed |= (*data & 0xC0) >> 6 == currentByteType;
+                if((*data & 0x3F) == 0x3F && i == 0 && pageInfo.dataType == TraceRecordType::TraceRecordByteWithExecTypeAndFullCounter)
+                    increaseOverflowCount(pageInfo, offset);
                 *data = ((char)currentByteType << 6) | ((*data & 0x3F) == 0x3F ? 0x3F : (*data & 0x3F) + 1);
             }
         }
@@ -192,18 +276,21 @@ void TraceRecordManager::TraceExecute(duint address, duint size)
     default:
         break;
     }
+    // Set after the data, a plain check keeps the cache line shared while tracing
+    if(!modified)
+        modified = 1;
 }
 
 unsigned int TraceRecordManager::getHitCount(duint address)
 {
     SHARED_ACQUIRE(LockTraceRecord);
     duint base = address & ~((duint)4096 - 1);
-    auto pageInfoIterator = TraceRecord.find(ModHashFromAddr(base));
-    if(pageInfoIterator == TraceRecord.end())
+    auto pageInfoPtr = lookupPage(base);
+    if(!pageInfoPtr)
         return 0;
     else
     {
-        TraceRecordPage pageInfo = pageInfoIterator->second;
+        const TraceRecordPage & pageInfo = *pageInfoPtr;
         duint offset = address - base;
         switch(pageInfo.dataType)
         {
@@ -211,6 +298,13 @@ unsigned int TraceRecordManager::getHitCount(duint address)
             return ((char*)pageInfo.rawPtr)[offset / 8] & (1 << (offset % 8)) ? 1 : 0;
         case TraceRecordType::TraceRecordByteWithExecTypeAndCounter:
             return ((char*)pageInfo.rawPtr)[offset] & 0x3F;
+        case TraceRecordType::TraceRecordByteWithExecTypeAndFullCounter:
+        {
+            unsigned int count = ((char*)pageInfo.rawPtr)[offset] & 0x3F;
+            if(count == 0x3F)
+                count += getOverflowCount(pageInfo, offset);
+            return count;
+        }
         case TraceRecordType::TraceRecordWordWithExecTypeAndCounter:
             return ((short*)pageInfo.rawPtr)[offset] & 0x3FFF;
         default:
@@ -223,12 +317,12 @@ TraceRecordManager::TraceRecordByteType TraceRecordManager::getByteType(duint ad
 {
     SHARED_ACQUIRE(LockTraceRecord);
     duint base = address & ~((duint)4096 - 1);
-    auto pageInfoIterator = TraceRecord.find(ModHashFromAddr(base));
-    if(pageInfoIterator == TraceRecord.end())
+    auto pageInfoPtr = lookupPage(base);
+    if(!pageInfoPtr)
         return TraceRecordByteType::InstructionHeading;
     else
     {
-        TraceRecordPage pageInfo = pageInfoIterator->second;
+        const TraceRecordPage & pageInfo = *pageInfoPtr;
         duint offset = address - base;
         switch(pageInfo.dataType)
         {
@@ -236,6 +330,7 @@ TraceRecordManager::TraceRecordByteType TraceRecordManager::getByteType(duint ad
         default:
             return TraceRecordByteType::InstructionHeading;
         case TraceRecordType::TraceRecordByteWithExecTypeAndCounter:
+        case TraceRecordType::TraceRecordByteWithExecTypeAndFullCounter:
             return (TraceRecordByteType)((((char*)pageInfo.rawPtr)[offset] & 0xC0) >> 6);
         case TraceRecordType::TraceRecordWordWithExecTypeAndCounter:
             return (TraceRecordByteType)((((short*)pageInfo.rawPtr)[offset] & 0xC000) >> 14);
@@ -248,66 +343,557 @@ void TraceRecordManager::increaseInstructionCounter()
     InterlockedIncrement(&instructionCounter);
 }
 
+/**
+\brief Gets a number that changes whenever the data saved in the database changes.
+*/
+duint TraceRecordManager::getGeneration()
+{
+    if(InterlockedExchange(&modified, 0))
+        InterlockedIncrement(&generation);
+    return duint(generation);
+}
 
-void TraceRecordManager::saveToDb(JSON root)
+
+/***************************************************************
+ * Trace record file layout (stored next to the database)
+ * TraceRecordFileHeader
+ * moduleCount x (unsigned short length, name bytes)
+ * runCount x (TraceRecordFileRun, storedSize bytes of page data)
+ * A run is up to MaxRunPages pages of one module with consecutive
+ * RVAs and the same type. The page data is optionally run-length
+ * encoded (TraceRecordBitExec only) and then LZ4 compressed.
+ * Optionally followed by an unsigned int count and that many
+ * TraceRecordFileCounter (TraceRecordByteWithExecTypeAndFullCounter).
+ **************************************************************/
+#pragma pack(push, 1)
+struct TraceRecordFileHeader
 {
-    EXCLUSIVE_ACQUIRE(LockTraceRecord);
-    const JSON jsonTraceRecords = json_array();
-    const char* byteToHex = "0123456789ABCDEF";
-    for(auto i : TraceRecord)
-    {
-        JSON jsonObj = json_object();
-        duint j;
-        json_object_set_new(jsonObj, "idx", json_hex(i.first));
-        if(i.second.moduleIndex != ~0)
+    char magic[4];
+    unsigned int version;
+    unsigned int moduleCount;
+    unsigned int runCount;
+};
+
+struct TraceRecordFileRun
+{
+    unsigned int moduleIndex;
+    unsigned int type;
+    unsigned long long rva;
+    unsigned int pageCount;
+    unsigned int encoding;
+    unsigned int storedSize;
+};
+
+struct TraceRecordFileCounter
+{
+    unsigned int moduleIndex;
+    unsigned long long rva;
+    unsigned int count; //hits above 63
+};
+#pragma pack(pop)
+
+enum TraceRecordFileEncoding
+{
+    EncodingRle = 1,
+    EncodingLz4 = 2
+};
+
+static const char TraceRecordFileMagic[4] = { 'X', 'T', 'R', 'C' };
+static const unsigned int TraceRecordFileVersion = 1;
+static const unsigned int MaxRunPages = 256;
+
+//PackBits style: control byte c < 128 is followed by c + 1 literal bytes, otherwise the next byte is repeated c - 125 times
+static void rleEncode(const unsigned char* data, size_t size, std::vector<unsigned char> & output)
+{
+    size_t i = 0;
+    while(i < size)
+    {
+        size_t run = 1;
+        while(i + run < size && run < 130 && data[i + run] == data[i])
+            run++;
+        if(run >= 3)
         {
-            json_object_set_new(jsonObj, "module", json_string(ModuleNames[i.second.moduleIndex].c_str()));
-            json_object_set_new(jsonObj, "rva", json_hex(i.second.rva));
+            output.push_back((unsigned char)(run + 125));
+            output.push_back(data[i]);
+            i += run;
+            continue;
+        }
+        size_t literal = 0;
+        while(i + literal < size && literal < 128)
+        {
+            if(i + literal + 2 < size && data[i + literal] == data[i + literal + 1] && data[i + literal] == data[i + literal + 2])
+                break;
+            literal++;
+        }
+        output.push_back((unsigned char)(literal - 1));
+        output.insert(output.end(), data + i, data + i + literal);
+        i += literal;
+    }
+}
+
+static bool rleDecode(const unsigned char* data, size_t size, unsigned char* output, size_t outputSize)
+{
+    size_t i = 0, o = 0;
+    while(i < size)
+    {
+        unsigned char control = data[i++];
+        if(control < 128)
+        {
+            size_t literal = control + 1;
+            if(i + literal > size || o + literal > outputSize)
+                return false;
+            memcpy(output + o, data + i, literal);
+            i += literal;
+            o += literal;
         }
         else
         {
-            json_object_set_new(jsonObj, "module", json_string(""));
-            json_object_set_new(jsonObj, "rva", json_hex(i.first));
+            size_t run = control - 125;
+            if(i >= size || o + run > outputSize)
+                return false;
+            memset(output + o, data[i++], run);
+            o += run;
         }
-        json_object_set_new(jsonObj, "type", json_hex((duint)i.second.dataType));
-        char* ptr = (char*)i.second.rawPtr;
-        duint size = 0;
-        char* temp;
-        switch(i.second.dataType)
+    }
+    return o == outputSize;
+}
+
+size_t TraceRecordManager::getPageDataSize(TraceRecordType type)
+{
+    switch(type)
+    {
+    case TraceRecordType::TraceRecordBitExec:
+        return 4096 / 8;
+    case TraceRecordType::TraceRecordByteWithExecTypeAndCounter:
+    case TraceRecordType::TraceRecordByteWithExecTypeAndFullCounter:
+        return 4096;
+    case TraceRecordType::TraceRecordWordWithExecTypeAndCounter:
+        return 4096 * 2;
+    default:
+        return 0;
+    }
+}
+
+void TraceRecordManager::saveToDb(JSON root, const String & dbPath)
+{
+    String fileName;
+    size_t pageCount;
+    if(!saveToFile(dbPath, fileName, pageCount))
+        return;
+    JSON jsonTraceRecordFile = json_object();
+    json_object_set_new(jsonTraceRecordFile, "file", json_string(fileName.c_str()));
+    json_object_set_new(jsonTraceRecordFile, "pages", json_hex(pageCount));
+    json_object_set_new(root, "tracerecordfile", jsonTraceRecordFile);
+}
+
+void TraceRecordManager::saveToDb(DbFileWriter & writer, const String & dbPath)
+{
+    String fileName;
+    size_t pageCount;
+    if(!saveToFile(dbPath, fileName, pageCount))
+        return;
+    writer.BeginChunk("tracerecordfile");
+    writer.BeginRecord();
+    writer.PutString("file", fileName.c_str());
+    writer.PutHex("pages", pageCount);
+    writer.EndRecord();
+    writer.EndChunk();
+}
+
+/**
+\brief Writes the pages to the trace record file next to the database. The pages are copied under the shared
+       lock and encoded without holding it. The file is not written again when nothing changed since it was
+       last saved (the database lock serializes the callers).
+\param [out] fileName The file name relative to the database directory, which the database references.
+\param [out] pageCount The number of pages in the file.
+\return false if there is nothing to reference.
+*/
+bool TraceRecordManager::saveToFile(const String & dbPath, String & fileName, size_t & pageCount)
+{
+    fileName = dbPath + ".trace";
+    duint currentGeneration = getGeneration();
+
+    std::vector<std::string> moduleNames;
+    std::vector<TraceRecordFileRun> runs; //storedSize is the size of the raw data at first
+    std::vector<unsigned char> raw;
+    std::vector<TraceRecordFileCounter> counters;
+    bool unchanged;
+    {
+        SHARED_ACQUIRE(LockTraceRecord);
+        pageCount = TraceRecord.size();
+        if(TraceRecord.empty())
         {
-        case TraceRecordType::TraceRecordBitExec:
-            size = 4096 / 8;
-            break;
-        case TraceRecordType::TraceRecordByteWithExecTypeAndCounter:
-            size = 4096;
-            break;
-        case TraceRecordType::TraceRecordWordWithExecTypeAndCounter:
-            size = 4096 * 2;
+            savedFile.clear();
+            DeleteFileW(StringUtils::Utf8ToUtf16(fileName).c_str());
+            return false;
+        }
+        unchanged = currentGeneration == savedGeneration && fileName == savedFile && FileExists(fileName.c_str());
+        if(!unchanged)
+        {
+            moduleNames = ModuleNames;
+            for(auto i = TraceRecord.begin(); i != TraceRecord.end();)
+            {
+                //collect a run of consecutive pages
+                const TraceRecordPage & first = i->second;
+                size_t pageSize = getPageDataSize(first.dataType);
+                TraceRecordFileRun run;
+                run.moduleIndex = first.moduleIndex;
+                run.type = first.dataType;
+                run.rva = first.rva;
+                run.pageCount = 0;
+                run.encoding = 0;
+                for(; i != TraceRecord.end() && run.pageCount < MaxRunPages; ++i, run.pageCount++)
+                {
+                    const TraceRecordPage & page = i->second;
+                    if(page.moduleIndex != first.moduleIndex || page.dataType != first.dataType || page.rva != first.rva + run.pageCount * 4096)
+                        break;
+                    raw.insert(raw.end(), (unsigned char*)page.rawPtr, (unsigned char*)page.rawPtr + pageSize);
+                }
+                run.storedSize = (unsigned int)(pageSize * run.pageCount);
+                runs.push_back(run);
+            }
+
+            //hit counts above 63 of TraceRecordByteWithExecTypeAndFullCounter pages
+            for(const auto & i : TraceRecord)
+            {
+                const TraceRecordPage & page = i.second;
+                if(page.dataType != TraceRecordType::TraceRecordByteWithExecTypeAndFullCounter)
+                    continue;
+                for(duint offset = 0; offset < 4096; offset++)
+                {
+                    if((((char*)page.rawPtr)[offset] & 0x3F) != 0x3F)
+                        continue;
+                    unsigned int count = getOverflowCount(page, offset);
+                    if(!count)
+                        continue;
+                    TraceRecordFileCounter counter;
+                    counter.moduleIndex = page.moduleIndex;
+                    counter.rva = page.rva + offset;
+                    counter.count = count;
+                    counters.push_back(counter);
+                }
+            }
+        }
+    }
+    // The database only references the file, relative to the database directory
+    String relativeName = fileName;
+    auto nameStart = fileName.find_last_of("\\/");
+    if(nameStart != String::npos)
+        relativeName = fileName.substr(nameStart + 1);
+    if(unchanged)
+    {
+        fileName = relativeName;
+        return true;
+    }
+
+    std::vector<unsigned char> file;
+    TraceRecordFileHeader header;
+    memcpy(header.magic, TraceRecordFileMagic, sizeof(header.magic));
+    header.version = TraceRecordFileVersion;
+    header.moduleCount = (unsigned int)moduleNames.size();
+    header.runCount = (unsigned int)runs.size();
+    file.insert(file.end(), (unsigned char*)&header, (unsigned char*)&header + sizeof(header));
+    for(const auto & name : moduleNames)
+    {
+        unsigned short length = (unsigned short)name.length();
+        file.insert(file.end(), (unsigned char*)&length, (unsigned char*)&length + sizeof(length));
+        file.insert(file.end(), name.begin(), name.begin() + length);
+    }
+
+    std::vector<unsigned char> rle;
+    std::vector<char> lz4;
+    size_t rawOffset = 0;
+    for(auto & run : runs)
+    {
+        const unsigned char* data = raw.data() + rawOffset;
+        size_t size = run.storedSize;
+        rawOffset += size;
+        if(run.type == TraceRecordType::TraceRecordBitExec)
+        {
+            rle.clear();
+            rleEncode(data, size, rle);
+            if(rle.size() < size)
+            {
+                run.encoding |= EncodingRle;
+                data = rle.data();
+                size = rle.size();
+            }
+        }
+        lz4.resize(LZ4_compressBound(int(size)));
+        int compressedSize = LZ4_compress((const char*)data, lz4.data(), int(size));
+        if(compressedSize > 0 && size_t(compressedSize) < size)
+        {
+            run.encoding |= EncodingLz4;
+            data = (const unsigned char*)lz4.data();
+            size = compressedSize;
+        }
+        run.storedSize = (unsigned int)size;
+        file.insert(file.end(), (unsigned char*)&run, (unsigned char*)&run + sizeof(run));
+        file.insert(file.end(), data, data + size);
+    }
+
+    if(!counters.empty())
+    {
+        unsigned int counterCount = (unsigned int)counters.size();
+        file.insert(file.end(), (unsigned char*)&counterCount, (unsigned char*)&counterCount + sizeof(counterCount));
+        file.insert(file.end(), (unsigned char*)counters.data(), (unsigned char*)(counters.data() + counters.size()));
+    }
+
+    // Write a temporary file and replace the old one with it, a failed save never leaves a truncated trace record
+    String tempFile = fileName + ".tmp";
+    auto wtempFile = StringUtils::Utf8ToUtf16(tempFile);
+    bool written = FileHelper::WriteAllData(tempFile, file.data(), file.size()) &&
+                   MoveFileExW(wtempFile.c_str(), StringUtils::Utf8ToUtf16(fileName).c_str(), MOVEFILE_REPLACE_EXISTING);
+    DeleteFileW(wtempFile.c_str());
+    if(!written)
+    {
+        savedFile.clear();
+        dputs("\nFailed to write trace record file!");
+        return false;
+    }
+    savedGeneration = currentGeneration;
+    savedFile = fileName;
+    fileName = relativeName;
+    return true;
+}
+
+bool TraceRecordManager::loadFromFile(const String & fileName)
+{
+    Handle hFile = CreateFileW(StringUtils::Utf8ToUtf16(fileName).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+    if(hFile == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart < LONGLONG(sizeof(TraceRecordFileHeader)) || fileSize.QuadPart > 0x7FFFFFFF)
+        return false;
+    Handle hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(!hMapping)
+        return false;
+    auto view = (const unsigned char*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    if(!view)
+        return false;
+
+    const unsigned char* ptr = view;
+    const unsigned char* end = view + size_t(fileSize.QuadPart);
+    bool success = false;
+    std::vector<String> moduleNames;
+    std::vector<unsigned char> rle;
+    //everything is decoded and validated before the first page is added, a corrupt file changes nothing
+    std::vector<std::pair<duint, TraceRecordPage>> pages; //key, page
+    std::vector<duint> pageVas;
+    std::unordered_map<duint, size_t> pageIndices; //key -> index in pages
+    std::vector<std::pair<size_t, unsigned int>> counters; //index in pages + offset, count
+    do
+    {
+        TraceRecordFileHeader header;
+        memcpy(&header, ptr, sizeof(header));
+        ptr += sizeof(header);
+        if(memcmp(header.magic, TraceRecordFileMagic, sizeof(header.magic)) != 0 || header.version != TraceRecordFileVersion)
             break;
-        default:
-            __debugbreak(); // We have encountered an error condition.
+
+        bool valid = true;
+        for(unsigned int i = 0; i < header.moduleCount && valid; i++)
+        {
+            unsigned short length;
+            if(size_t(end - ptr) < sizeof(length))
+            {
+                valid = false;
+                break;
+            }
+            memcpy(&length, ptr, sizeof(length));
+            ptr += sizeof(length);
+            if(size_t(end - ptr) < length)
+            {
+                valid = false;
+                break;
+            }
+            moduleNames.push_back(String((const char*)ptr, length));
+            ptr += length;
         }
-        temp = (char*)emalloc(size * 2 + 1, "TraceRecordManager::saveToDb");
-        for(j = 0; j < size; j++)
+
+        for(unsigned int i = 0; i < header.runCount && valid; i++)
         {
-            temp[j * 2 + 1] = byteToHex[ptr[j] & 0xF];
-            temp[j * 2] = byteToHex[(ptr[j] & 0xF0) >> 4];
+            TraceRecordFileRun run;
+            if(size_t(end - ptr) < sizeof(run))
+            {
+                valid = false;
+                break;
+            }
+            memcpy(&run, ptr, sizeof(run));
+            ptr += sizeof(run);
+            size_t pageSize = getPageDataSize((TraceRecordType)run.type);
+            if(size_t(end - ptr) < run.storedSize || !pageSize || run.pageCount > MaxRunPages || (run.moduleIndex != ~0 && run.moduleIndex >= moduleNames.size()))
+            {
+                valid = false;
+                break;
+            }
+            const unsigned char* data = ptr;
+            ptr += run.storedSize;
+
+            //decode the run straight from the mapped view
+            size_t rawSize = pageSize * run.pageCount;
+            unsigned char* raw = (unsigned char*)emalloc(rawSize, "TraceRecordManager::loadFromFile");
+            bool decoded;
+            if(run.encoding & EncodingRle)
+            {
+                rle.resize(rawSize * 2 + 16);
+                int size = int(run.storedSize);
+                if(run.encoding & EncodingLz4)
+                    size = LZ4_decompress_safe((const char*)data, (char*)rle.data(), int(run.storedSize), int(rle.size()));
+                else if(size <= int(rle.size()))
+                    memcpy(rle.data(), data, size);
+                else
+                    size = -1;
+                decoded = size >= 0 && rleDecode(rle.data(), size, raw, rawSize);
+            }
+            else if(run.encoding & EncodingLz4)
+                decoded = LZ4_decompress_safe((const char*)data, (char*)raw, int(run.storedSize), int(rawSize)) == int(rawSize);
+            else if(run.storedSize == rawSize)
+            {
+                memcpy(raw, data, rawSize);
+                decoded = true;
+            }
+            else
+                decoded = false;
+            if(!decoded)
+            {
+                efree(raw, "TraceRecordManager::loadFromFile");
+                valid = false;
+                break;
+            }
+
+            const char* moduleName = run.moduleIndex == ~0 ? "" : moduleNames[run.moduleIndex].c_str();
+            duint moduleHash = *moduleName ? ModHashFromName(moduleName) : 0;
+            duint moduleBase = *moduleName ? ModBaseFromName(moduleName) : 0;
+            for(unsigned int j = 0; j < run.pageCount; j++)
+            {
+                TraceRecordPage currentPage;
+                currentPage.dataType = (TraceRecordType)run.type;
+                currentPage.rva = duint(run.rva) + j * 4096;
+                currentPage.rawPtr = emalloc(pageSize, "TraceRecordManager");
+                memcpy(currentPage.rawPtr, raw + j * pageSize, pageSize);
+                currentPage.va = 0;
+                currentPage.mapped = nullptr;
+                currentPage.moduleIndex = run.moduleIndex; //index in moduleNames until the pages are added
+                pageIndices.insert(std::make_pair(currentPage.rva + moduleHash, pages.size()));
+                pages.push_back(std::make_pair(currentPage.rva + moduleHash, currentPage));
+                pageVas.push_back(*moduleName ? (moduleBase ? moduleBase + currentPage.rva : 0) : currentPage.rva);
+            }
+            efree(raw, "TraceRecordManager::loadFromFile");
+        }
+
+        //optional hit counts above 63
+        unsigned int counterCount = 0;
+        if(valid && size_t(end - ptr) >= sizeof(counterCount))
+        {
+            memcpy(&counterCount, ptr, sizeof(counterCount));
+            ptr += sizeof(counterCount);
+            if(size_t(end - ptr) / sizeof(TraceRecordFileCounter) < counterCount)
+                valid = false;
+        }
+        for(unsigned int i = 0; i < counterCount && valid; i++)
+        {
+            TraceRecordFileCounter counter;
+            memcpy(&counter, ptr, sizeof(counter));
+            ptr += sizeof(counter);
+            if(counter.moduleIndex != ~0 && counter.moduleIndex >= moduleNames.size())
+                continue;
+            const char* moduleName = counter.moduleIndex == ~0 ? "" : moduleNames[counter.moduleIndex].c_str();
+            duint pageRva = duint(counter.rva) & ~((duint)4096 - 1);
+            auto found = pageIndices.find(pageRva + (*moduleName ? ModHashFromName(moduleName) : 0));
+            if(found != pageIndices.end() && pages[found->second].second.dataType == TraceRecordType::TraceRecordByteWithExecTypeAndFullCounter)
+                counters.push_back(std::make_pair(found->second * 4096 + (duint(counter.rva) - pageRva), counter.count));
         }
-        temp[size * 2] = 0;
-        json_object_set_new(jsonObj, "data", json_string(temp));
-        efree(temp, "TraceRecordManager::saveToDb");
-        json_array_append_new(jsonTraceRecords, jsonObj);
+        success = valid;
+    }
+    while(false);
+    UnmapViewOfFile(view);
+
+    if(!success)
+    {
+        for(auto & page : pages)
+            efree(page.second.rawPtr, "TraceRecordManager");
+        return false;
     }
-    if(json_array_size(jsonTraceRecords))
-        json_object_set_new(root, "tracerecord", jsonTraceRecords);
-    json_decref(jsonTraceRecords);
+
+    std::vector<unsigned int> moduleIndices;
+    for(const auto & name : moduleNames)
+        moduleIndices.push_back(getModuleIndex(name));
+    std::vector<TraceRecordPage*> inserted(pages.size(), nullptr);
+    for(size_t i = 0; i < pages.size(); i++)
+    {
+        auto & page = pages[i].second;
+        page.moduleIndex = page.moduleIndex == ~0 ? ~0 : moduleIndices[page.moduleIndex];
+        auto result = TraceRecord.insert(pages[i]);
+        if(!result.second)
+        {
+            efree(page.rawPtr, "TraceRecordManager");
+            continue;
+        }
+        inserted[i] = &result.first->second;
+        if(pageVas[i])
+            mapPage(pageVas[i], *inserted[i]);
+    }
+    EXCLUSIVE_ACQUIRE(LockTraceRecordCounters);
+    for(const auto & counter : counters)
+    {
+        auto page = inserted[counter.first / 4096];
+        if(page)
+            CounterOverflow[duint(page->rawPtr) + counter.first % 4096] = counter.second;
+    }
+    return true;
 }
 
-void TraceRecordManager::loadFromDb(JSON root)
+void TraceRecordManager::loadFromDb(const DbFileReader & reader, const String & dbPath)
 {
     clear();
     EXCLUSIVE_ACQUIRE(LockTraceRecord);
-    // get the root object
+    InterlockedIncrement(&generation);
+
+    String file;
+    reader.EnumRecords("tracerecordfile", [&file](const DbRecord & record)
+    {
+        const char* name;
+        if(record.GetString("file", name))
+            file = name;
+        return false;
+    });
+    loadFromDbFile(file.c_str(), dbPath);
+}
+
+/**
+\brief Loads the trace record file referenced by a database (called with LockTraceRecord held).
+\param file The file name relative to the database directory.
+*/
+void TraceRecordManager::loadFromDbFile(const char* file, const String & dbPath)
+{
+    if(!file || !*file)
+        return;
+    auto dirEnd = dbPath.find_last_of("\\/");
+    String fileName = (dirEnd == String::npos ? String() : dbPath.substr(0, dirEnd + 1)) + file;
+    if(!loadFromFile(fileName))
+    {
+        dprintf("\nFailed to load trace record file \"%s\"!", fileName.c_str());
+        return;
+    }
+    // The file matches what was loaded, it only has to be written again after a change
+    savedGeneration = getGeneration();
+    savedFile = fileName;
+}
+
+void TraceRecordManager::loadFromDb(JSON root, const String & dbPath)
+{
+    clear();
+    EXCLUSIVE_ACQUIRE(LockTraceRecord);
+    InterlockedIncrement(&generation);
+
+    const JSON tracerecordfile = json_object_get(root, "tracerecordfile");
+    if(tracerecordfile)
+    {
+        loadFromDbFile(json_string_value(json_object_get(tracerecordfile, "file")), dbPath);
+        return;
+    }
+
+    // get the root object of the old JSON format
     const JSON tracerecord = json_object_get(root, "tracerecord");
 
     // return if nothing found
@@ -322,32 +908,20 @@ void TraceRecordManager::loadFromDb(JSON root)
         size_t size;
         currentPage.dataType = (TraceRecordType)json_hex_value(json_object_get(value, "type"));
         currentPage.rva = (duint)json_hex_value(json_object_get(value, "rva"));
-        switch(currentPage.dataType)
-        {
-        case TraceRecordType::TraceRecordBitExec:
-            size = 4096 / 8;
-            break;
-        case TraceRecordType::TraceRecordByteWithExecTypeAndCounter:
-            size = 4096;
-            break;
-        case TraceRecordType::TraceRecordWordWithExecTypeAndCounter:
-            size = 4096 * 2;
-            break;
-        default:
-            size = 0;
-            break;
-        }
+        size = getPageDataSize(currentPage.dataType);
         if(size != 0)
         {
-            currentPage.rawPtr = emalloc(size, "TraceRecordManager");
             const char* p = json_string_value(json_object_get(value, "data"));
+            if(!p)
+                continue;
+            currentPage.rawPtr = emalloc(size, "TraceRecordManager");
             char* read_ptr = (char*)currentPage.rawPtr;
             const char* c;
-            for(c = p; c < p + size * 2 && *c != '\0'; c += 2, read_ptr++)
+            for(c = p; c < p + size * 2 && c[0] != '\0' && c[1] != '\0'; c += 2, read_ptr++)
             {
                 if(c[1] >= '0' && c[1] <= '9')
                     *read_ptr = c[1] - '0';
-                else if(c[1] >= 'A' && c[0] <= 'F')
+                else if(c[1] >= 'A' && c[1] <= 'F')
                     *read_ptr = c[1] - 'A' + 10;
                 else
                     break;
@@ -366,68 +940,445 @@ void TraceRecordManager::loadFromDb(JSON root)
             {
                 const char* moduleName = json_string_value(json_object_get(value, "module"));
                 duint key;
-                dprintf("%s\n", moduleName);
-                if(*moduleName)
+                duint va;
+                currentPage.va = 0;
+                currentPage.mapped = nullptr;
+                if(moduleName && *moduleName)
                 {
                     currentPage.moduleIndex = getModuleIndex(std::string(moduleName));
                     key = currentPage.rva + ModHashFromName(moduleName);
+                    va = ModBaseFromName(moduleName);
+                    if(va) //pages of modules that are not loaded yet are mapped in mapModule
+                        va += currentPage.rva;
                 }
                 else
                 {
                     currentPage.moduleIndex = ~0;
                     key = currentPage.rva;
+                    va = currentPage.rva;
                 }
-                TraceRecord.insert(std::make_pair(key, currentPage));
+                auto inserted = TraceRecord.insert(std::make_pair(key, currentPage));
+                if(!inserted.second)
+                    efree(currentPage.rawPtr, "TraceRecordManager");
+                else if(va)
+                    mapPage(va, inserted.first->second);
             }
         }
     }
 }
 
-unsigned int TraceRecordManager::getModuleIndex(std::string moduleName)
+/**
+\brief Streams coverage blocks to a drcov file and per function hit counts to a CSV file.
+*/
+class CoverageExporter
 {
-    auto iterator = std::find(ModuleNames.begin(), ModuleNames.end(), moduleName);
-    if(iterator != ModuleNames.end())
-        return (unsigned int)(iterator - ModuleNames.begin());
-    else
+public:
+    CoverageExporter(FILE* drcov, FILE* csv, const std::vector<std::string> & moduleNames, const std::vector<duint> & moduleBases)
+        : mDrcov(drcov), mCsv(csv), mModuleNames(moduleNames), mModuleBases(moduleBases),
+          mBlockCount(0), mInBlock(false), mInFunction(false)
     {
-        ModuleNames.push_back(moduleName);
-        return (unsigned int)(ModuleNames.size() - 1);
     }
-}
 
-void _dbg_dbgtraceexecute(duint CIP)
+    void Executed(unsigned int module, duint rva, bool head, unsigned int hits)
+    {
+        duint base = mModuleBases[module];
+        bool functionStart = false;
+        if(head && base)
+        {
+            duint va = base + rva;
+            if(!mInFunction || mFunctionModule != module || va < mFunctionStart || va > mFunctionEnd)
+            {
+                flushFunction();
+                duint start, end;
+                if(FunctionGet(va, &start, &end))
+                {
+                    mInFunction = true;
+                    mFunctionModule = module;
+                    mFunctionStart = start;
+                    mFunctionEnd = end;
+                    mFunctionInstructions = 0;
+                    mFunctionBytes = 0;
+                    mFunctionHits = 0;
+                }
+            }
+            functionStart = mInFunction && va == mFunctionStart;
+        }
+        if(mInFunction && mFunctionModule == module && base + rva >= mFunctionStart && base + rva <= mFunctionEnd)
+        {
+            mFunctionBytes++;
+            if(head)
+            {
+                mFunctionInstructions++;
+                mFunctionHits += hits;
+            }
+        }
+        //a block ends at a gap, a function start or an instruction with a different hit count
+        if(!mInBlock || mBlockModule != module || rva != mBlockEnd || (head && (hits != mBlockHits || functionStart)) || mBlockEnd - mBlockStart == 0xFFFF)
+        {
+            flushBlock();
+            mInBlock = true;
+            mBlockModule = module;
+            mBlockStart = rva;
+            mBlockHits = hits;
+        }
+        mBlockEnd = rva + 1;
+    }
+
+    void Gap()
+    {
+        flushBlock();
+    }
+
+    unsigned int Finish()
+    {
+        flushBlock();
+        flushFunction();
+        return mBlockCount;
+    }
+
+private:
+    //drcov bb_entry_t
+    struct BlockEntry
+    {
+        unsigned int start;
+        unsigned short size;
+        unsigned short moduleId;
+    };
+
+    void flushBlock()
+    {
+        if(!mInBlock)
+            return;
+        BlockEntry entry;
+        entry.start = (unsigned int)mBlockStart;
+        entry.size = (unsigned short)(mBlockEnd - mBlockStart);
+        entry.moduleId = (unsigned short)(mBlockModule - 1);
+        fwrite(&entry, sizeof(entry), 1, mDrcov);
+        mBlockCount++;
+        mInBlock = false;
+    }
+
+    void flushFunction()
+    {
+        if(!mInFunction)
+            return;
+        char label[MAX_LABEL_SIZE] = "";
+        LabelGet(mFunctionStart, label);
+        for(auto ch = label; *ch; ch++) //keep the CSV parseable
+            if(*ch == '"' || *ch == ',')
+                *ch = '_';
+        duint base = mModuleBases[mFunctionModule];
+        fprintf(mCsv, "%s,0x%llX,0x%llX,\"%s\",%llu,%llu,%llu\n",
+                mModuleNames[mFunctionModule].c_str(),
+                (unsigned long long)(mFunctionStart - base),
+                (unsigned long long)(mFunctionEnd - base),
+                label,
+                (unsigned long long)mFunctionInstructions,
+                (unsigned long long)mFunctionBytes,
+                mFunctionHits);
+        mInFunction = false;
+    }
+
+    FILE* mDrcov;
+    FILE* mCsv;
+    const std::vector<std::string> & mModuleNames;
+    const std::vector<duint> & mModuleBases;
+    unsigned int mBlockCount;
+
+    bool mInBlock;
+    unsigned int mBlockModule;
+    duint mBlockStart;
+    duint mBlockEnd;
+    unsigned int mBlockHits;
+
+    bool mInFunction;
+    unsigned int mFunctionModule;
+    duint mFunctionStart;
+    duint mFunctionEnd;
+    duint mFunctionInstructions;
+    duint mFunctionBytes;
+    unsigned long long mFunctionHits;
+};
+
+/**
+\brief Exports the recorded execution as basic block coverage in drcov (version 2) format and as a CSV with the hit counts per function.
+       Blocks are joined from the executed instruction headings and split at function starts. Both files are written while walking
+       the pages, nothing is accumulated in memory. TraceRecordBitExec pages have no instruction boundaries, every run of executed
+       bytes counts as one instruction with one hit.
+*/
+bool TraceRecordManager::exportCoverage(const String & drcovFile, const String & csvFile)
 {
-    if(TraceRecord.getTraceRecordType(CIP) != TraceRecordManager::TraceRecordType::TraceRecordNone)
+    SHARED_ACQUIRE(LockTraceRecord);
+    FILE* drcov = _wfopen(StringUtils::Utf8ToUtf16(drcovFile).c_str(), L"wb");
+    if(!drcov)
+    {
+        dprintf("Failed to create \"%s\"!\n", drcovFile.c_str());
+        return false;
+    }
+    FILE* csv = _wfopen(StringUtils::Utf8ToUtf16(csvFile).c_str(), L"wb");
+    if(!csv)
+    {
+        fclose(drcov);
+        dprintf("Failed to create \"%s\"!\n", csvFile.c_str());
+        return false;
+    }
+
+    //module table, drcov module id = module index - 1
+    std::vector<duint> moduleBases(ModuleNames.size(), 0);
+    fprintf(drcov, "DRCOV VERSION: 2\nDRCOV FLAVOR: x64dbg\n");
+    fprintf(drcov, "Module Table: version 2, count %u\n", (unsigned int)(ModuleNames.size() - 1));
+    fprintf(drcov, "Columns: id, base, end, entry, checksum, timestamp, path\n");
+    for(size_t i = 1; i < ModuleNames.size(); i++)
+    {
+        const char* name = ModuleNames[i].c_str();
+        duint base = ModBaseFromName(name);
+        duint size = base ? ModSizeFromAddr(base) : 0;
+        duint entry = base ? ModEntryFromAddr(base) : 0;
+        char path[MAX_PATH] = "";
+        if(!base || !ModPathFromAddr(base, path, MAX_PATH))
+            strcpy_s(path, name);
+        moduleBases[i] = base;
+        fprintf(drcov, "%u, 0x%llx, 0x%llx, 0x%llx, 0x00000000, 0x00000000, %s\n", (unsigned int)(i - 1),
+                (unsigned long long)base, (unsigned long long)(base + size), (unsigned long long)entry, path);
+    }
+    //the block count is patched in at the end
+    fputs("BB Table: ", drcov);
+    long blockCountPos = ftell(drcov);
+    fprintf(drcov, "%010u bbs\n", 0);
+    fputs("module,start,end,function,instructions,executed bytes,hits\n", csv);
+
+    CoverageExporter exporter(drcov, csv, ModuleNames, moduleBases);
+    duint skippedPages = 0;
+    for(const auto & i : TraceRecord)
     {
-        unsigned char buffer[16];
-        duint size;
-        if(MemRead(CIP, buffer, 16))
+        const TraceRecordPage & page = i.second;
+        if(page.moduleIndex == ~0 || page.moduleIndex == 0)
         {
-            BASIC_INSTRUCTION_INFO basicInfo;
-            TraceRecord.increaseInstructionCounter();
-            DbgDisasmFastAt(CIP, &basicInfo);
-            TraceRecord.TraceExecute(CIP, basicInfo.size);
+            skippedPages++; //drcov can only express module relative blocks
+            continue;
         }
+        for(duint offset = 0; offset < 4096; offset++)
+        {
+            bool executed;
+            bool head;
+            unsigned int hits = 0;
+            switch(page.dataType)
+            {
+            case TraceRecordType::TraceRecordBitExec:
+            {
+                executed = (((unsigned char*)page.rawPtr)[offset / 8] & (1 << (offset % 8))) != 0;
+                head = executed && (offset == 0 || !(((unsigned char*)page.rawPtr)[(offset - 1) / 8] & (1 << ((offset - 1) % 8))));
+                hits = 1;
+            }
+            break;
+            case TraceRecordType::TraceRecordByteWithExecTypeAndCounter:
+            case TraceRecordType::TraceRecordByteWithExecTypeAndFullCounter:
+            {
+                unsigned char data = ((unsigned char*)page.rawPtr)[offset];
+                executed = data != 0;
+                head = executed && (data >> 6 == _InstructionHeading || data >> 6 == _InstructionOverlapped);
+                hits = data & 0x3F;
+                if(hits == 0x3F && page.dataType == TraceRecordType::TraceRecordByteWithExecTypeAndFullCounter)
+                    hits += getOverflowCount(page, offset);
+            }
+            break;
+            case TraceRecordType::TraceRecordWordWithExecTypeAndCounter:
+            {
+                unsigned short data = ((unsigned short*)page.rawPtr)[offset];
+                executed = data != 0;
+                head = executed && (data >> 14 == _InstructionHeading || data >> 14 == _InstructionOverlapped);
+                hits = data & 0x3FFF;
+            }
+            break;
+            default:
+                executed = head = false;
+                break;
+            }
+            if(executed)
+                exporter.Executed(page.moduleIndex, page.rva + offset, head, hits);
+            else
+                exporter.Gap();
+        }
+    }
+    unsigned int blockCount = exporter.Finish();
+
+    fseek(drcov, blockCountPos, SEEK_SET);
+    fprintf(drcov, "%010u", blockCount);
+    bool success = !ferror(drcov) && !ferror(csv);
+    fclose(drcov);
+    fclose(csv);
+    if(skippedPages)
+        dprintf("%" fext "u page(s) outside of modules were skipped\n", skippedPages);
+    dprintf("%u block(s) written to \"%s\", function hit counts written to \"%s\"\n", blockCount, drcovFile.c_str(), csvFile.c_str());
+    return success;
+}
+
+/**
+\brief Maps the trace record pages of a module into the page table at its current base. Call after ModLoad.
+*/
+void TraceRecordManager::mapModule(duint base)
+{
+    char modName[MAX_MODULE_SIZE];
+    if(!ModNameFromAddr(base, modName, true))
+        return;
+    EXCLUSIVE_ACQUIRE(LockTraceRecord);
+    auto found = std::find(ModuleNames.begin(), ModuleNames.end(), std::string(modName));
+    if(found == ModuleNames.end())
+        return;
+    auto moduleIndex = (unsigned int)(found - ModuleNames.begin());
+    for(auto & i : TraceRecord)
+        if(i.second.moduleIndex == moduleIndex)
+            mapPage(base + i.second.rva, i.second);
+    freeRetiredMemory(false);
+}
+
+/**
+\brief Removes the trace record pages of a module from the page table, the records are kept. Call before ModUnload.
+*/
+void TraceRecordManager::unmapModule(duint base)
+{
+    duint size = ModSizeFromAddr(base);
+    EXCLUSIVE_ACQUIRE(LockTraceRecord);
+    for(auto & i : TraceRecord)
+        if(i.second.va >= base && i.second.va < base + size)
+            unmapPage(i.second);
+    freeRetiredMemory(false);
+}
+
+unsigned int TraceRecordManager::getOverflowCount(const TraceRecordPage & page, duint offset)
+{
+    SHARED_ACQUIRE(LockTraceRecordCounters);
+    auto found = CounterOverflow.find(duint(page.rawPtr) + offset);
+    return found == CounterOverflow.end() ? 0 : found->second;
+}
+
+void TraceRecordManager::increaseOverflowCount(const TraceRecordPage & page, duint offset)
+{
+    EXCLUSIVE_ACQUIRE(LockTraceRecordCounters);
+    auto & count = CounterOverflow[duint(page.rawPtr) + offset];
+    if(count < 0xFFFFFFFF - 0x3F)
+        count++;
+}
+
+//requires LockTraceRecord to be held exclusively
+void TraceRecordManager::eraseOverflowCounts(const TraceRecordPage & page)
+{
+    if(page.dataType != TraceRecordType::TraceRecordByteWithExecTypeAndFullCounter)
+        return;
+    EXCLUSIVE_ACQUIRE(LockTraceRecordCounters); //TraceExecute adds counts without LockTraceRecord
+    for(auto i = CounterOverflow.begin(); i != CounterOverflow.end();)
+    {
+        if(i->first >= duint(page.rawPtr) && i->first < duint(page.rawPtr) + 4096)
+            i = CounterOverflow.erase(i);
         else
+            ++i;
+    }
+}
+
+TraceRecordManager::TraceRecordPage* TraceRecordManager::lookupPage(duint address) const
+{
+    duint pageNumber = address >> 12;
+    duint directoryIndex = pageNumber >> PageTableLeafBits;
+    if(!PageDirectory || directoryIndex >= (duint(1) << PageTableDirectoryBits))
+        return nullptr;
+    PageTableEntry* leaf = PageDirectory[directoryIndex];
+    if(!leaf)
+        return nullptr;
+    return leaf[pageNumber & ((duint(1) << PageTableLeafBits) - 1)];
+}
+
+void TraceRecordManager::mapPage(duint pageAddress, TraceRecordPage & page)
+{
+    duint pageNumber = pageAddress >> 12;
+    duint directoryIndex = pageNumber >> PageTableLeafBits;
+    if(!PageDirectory || directoryIndex >= (duint(1) << PageTableDirectoryBits))
+        return;
+    unmapPage(page);
+    PageTableEntry* leaf = PageDirectory[directoryIndex];
+    if(!leaf)
+    {
+        leaf = (PageTableEntry*)VirtualAlloc(nullptr, sizeof(PageTableEntry) << PageTableLeafBits, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if(!leaf)
+            return;
+        InterlockedExchangePointer((void* volatile*)&PageDirectory[directoryIndex], (void*)leaf);
+    }
+    page.va = pageNumber << 12;
+    //the copy never changes after it is published, the lock-free readers only see complete pages
+    auto mapped = (TraceRecordPage*)emalloc(sizeof(TraceRecordPage), "TraceRecordManager::mapPage");
+    *mapped = page;
+    mapped->mapped = nullptr;
+    page.mapped = mapped;
+    InterlockedExchangePointer((void* volatile*)&leaf[pageNumber & ((duint(1) << PageTableLeafBits) - 1)], mapped);
+}
+
+void TraceRecordManager::unmapPage(TraceRecordPage & page)
+{
+    if(!page.va)
+        return;
+    duint pageNumber = page.va >> 12;
+    PageTableEntry* leaf = PageDirectory[pageNumber >> PageTableLeafBits];
+    auto & entry = leaf[pageNumber & ((duint(1) << PageTableLeafBits) - 1)];
+    if(entry == page.mapped)
+        InterlockedExchangePointer((void* volatile*)&entry, nullptr);
+    retireMemory(page.mapped, false);
+    page.mapped = nullptr;
+    page.va = 0;
+}
+
+//requires LockTraceRecord to be held exclusively, ptr must no longer be reachable from the page table
+void TraceRecordManager::retireMemory(void* ptr, bool pageData)
+{
+    if(!ptr)
+        return;
+    RetiredMemory retired;
+    retired.ptr = ptr;
+    retired.pageData = pageData;
+    retired.quiescent = traceQuiescent; //read after the page table entry was cleared with a full barrier
+    RetiredList.push_back(retired);
+}
+
+//requires LockTraceRecord to be held exclusively, frees the memory the debugging thread can no longer be using (or everything)
+void TraceRecordManager::freeRetiredMemory(bool all)
+{
+    LONG quiescent = traceQuiescent;
+    for(auto i = RetiredList.begin(); i != RetiredList.end();)
+    {
+        if(!all && i->quiescent == quiescent)
         {
-            duint base = MemFindBaseAddr(CIP, &size);
-            if(CIP - base + 16 > size) // Corner case where CIP is near the end of the page
+            ++i;
+            continue;
+        }
+        if(i->pageData) //TraceExecute can still have counted overflows after the page was removed
+        {
+            EXCLUSIVE_ACQUIRE(LockTraceRecordCounters);
+            for(auto j = CounterOverflow.begin(); j != CounterOverflow.end();)
             {
-                size = base + size - CIP;
-                if(MemRead(CIP, buffer, size))
-                {
-                    BASIC_INSTRUCTION_INFO basicInfo;
-                    TraceRecord.increaseInstructionCounter();
-                    DbgDisasmFastAt(CIP, &basicInfo);
-                    TraceRecord.TraceExecute(CIP, basicInfo.size);
-                    return;
-                }
+                if(j->first >= duint(i->ptr) && j->first < duint(i->ptr) + 4096)
+                    j = CounterOverflow.erase(j);
+                else
+                    ++j;
             }
-            // if we reaches here, then the executable had executed an invalid address. Don't trace it.
         }
+        efree(i->ptr, "TraceRecordManager");
+        i = RetiredList.erase(i);
     }
+}
+
+unsigned int TraceRecordManager::getModuleIndex(std::string moduleName)
+{
+    auto iterator = std::find(ModuleNames.begin(), ModuleNames.end(), moduleName);
+    if(iterator != ModuleNames.end())
+        return (unsigned int)(iterator - ModuleNames.begin());
     else
-        TraceRecord.increaseInstructionCounter();
+    {
+        ModuleNames.push_back(moduleName);
+        return (unsigned int)(ModuleNames.size() - 1);
+    }
+}
+
+void _dbg_dbgtraceexecute(duint CIP)
+{
+    TraceRecord.TraceInstruction(CIP);
 }
 
 unsigned int _dbg_dbggetTraceRecordHitCount(duint address)
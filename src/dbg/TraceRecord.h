@@ -2,6 +2,7 @@
 #define TRACERECORD_H
 #include "_global.h"
 #include "_dbgfunctions.h"
+#include "dbfile.h"
 
 class TraceRecordManager
 {
@@ -32,6 +33,9 @@ public:
      * TraceRecordBitExec: single-bit, executed.
      * TraceRecordByteWithExecTypeAndCounter: 8-bit, YYXXXXXX YY:=TraceRecordByteType_2bit, XXXXXX:=Hit count(6bit)
      * TraceRecordWordWithExecTypeAndCounter: 16-bit, YYXXXXXX XXXXXXXX YY:=TraceRecordByteType_2bit, XX:=Hit count(14bit)
+     * TraceRecordByteWithExecTypeAndFullCounter: 8-bit, same as TraceRecordByteWithExecTypeAndCounter, but hits of an
+     *     instruction heading above 63 are counted in CounterOverflow, giving it a 32-bit hit count.
+     *     A page takes 4KB like the byte type, plus one hash map node (~32 bytes) per hot instruction.
      * Other: reserved for future expanding
      **************************************************************/
     enum TraceRecordType
@@ -39,7 +43,8 @@ public:
         TraceRecordNone,
         TraceRecordBitExec,
         TraceRecordByteWithExecTypeAndCounter,
-        TraceRecordWordWithExecTypeAndCounter
+        TraceRecordWordWithExecTypeAndCounter,
+        TraceRecordByteWithExecTypeAndFullCounter
     };
 
     TraceRecordManager();
@@ -50,14 +55,23 @@ public:
     TraceRecordType getTraceRecordType(duint pageAddress);
 
     void TraceExecute(duint address, duint size);
+    void TraceInstruction(duint address);
     //void TraceAccess(duint address, unsigned char size, TraceRecordByteType accessType);
 
     unsigned int getHitCount(duint address);
     TraceRecordByteType getByteType(duint address);
     void increaseInstructionCounter();
+    duint getGeneration();
 
-    void saveToDb(JSON root);
-    void loadFromDb(JSON root);
+    void saveToDb(JSON root, const String & dbPath);
+    void loadFromDb(JSON root, const String & dbPath);
+    void saveToDb(DbFileWriter & writer, const String & dbPath);
+    void loadFromDb(const DbFileReader & reader, const String & dbPath);
+
+    bool exportCoverage(const String & drcovFile, const String & csvFile);
+
+    void mapModule(duint base);
+    void unmapModule(duint base);
 private:
     enum TraceRecordByteType_2bit
     {
@@ -73,13 +87,65 @@ private:
         duint rva;
         TraceRecordType dataType;
         unsigned int moduleIndex;
+        duint va; //address the page is mapped at in the page table, 0 if it is not mapped
+        TraceRecordPage* mapped; //copy of this page published in the page table, nullptr if it is not mapped
+    };
+
+    struct RetiredMemory
+    {
+        void* ptr;
+        bool pageData; //page data that can have entries in CounterOverflow
+        LONG quiescent; //value of traceQuiescent when it was retired
     };
 
+    /***************************************************************
+     * Page table from virtual page number to copies of the pages in
+     * TraceRecord. Directory entries are never freed while the manager
+     * exists and all entries are published atomically, so lookupPage
+     * can be used without holding LockTraceRecord. The debugging thread
+     * (TraceExecute, TraceInstruction) dereferences the pages it finds
+     * without the lock, every other reader holds LockTraceRecord.
+     * Unmapped copies and the data of removed pages are retired instead
+     * of freed, and only freed once the debugging thread has passed
+     * traceQuiescent (incremented after every lock-free access).
+     **************************************************************/
+#ifdef _WIN64
+    enum { PageTableLeafBits = 16, PageTableDirectoryBits = 47 - 12 - PageTableLeafBits };
+#else
+    enum { PageTableLeafBits = 10, PageTableDirectoryBits = 32 - 12 - PageTableLeafBits };
+#endif //_WIN64
+    typedef TraceRecordPage* volatile PageTableEntry;
+
+    static size_t getPageDataSize(TraceRecordType type);
+    bool saveToFile(const String & dbPath, String & fileName, size_t & pageCount);
+    bool loadFromFile(const String & fileName);
+    void loadFromDbFile(const char* file, const String & dbPath);
+    unsigned int getOverflowCount(const TraceRecordPage & page, duint offset);
+    void increaseOverflowCount(const TraceRecordPage & page, duint offset);
+    void eraseOverflowCounts(const TraceRecordPage & page);
+
+    TraceRecordPage* lookupPage(duint address) const;
+    void mapPage(duint pageAddress, TraceRecordPage & page);
+    void unmapPage(TraceRecordPage & page);
+    void retireMemory(void* ptr, bool pageData);
+    void freeRetiredMemory(bool all);
+    void traceExecutePage(const TraceRecordPage & pageInfo, duint address, duint size);
+
     //Key := page base, value := trace record raw data
     std::map<duint, TraceRecordPage> TraceRecord;
+    //Key := rawPtr + offset of an instruction heading, value := hits above 63 (TraceRecordByteWithExecTypeAndFullCounter)
+    std::unordered_map<duint, unsigned int> CounterOverflow;
+    PageTableEntry* volatile* PageDirectory; //1 << PageTableDirectoryBits entries, committed on demand by the system
+    std::vector<RetiredMemory> RetiredList;
+    volatile LONG traceQuiescent;
     std::vector<std::string> ModuleNames;
     unsigned int getModuleIndex(std::string moduleName);
     unsigned int instructionCounter;
+    volatile LONG generation; //changes when the saved data changes, see getGeneration
+    volatile LONG modified; //set by TraceExecute, turned into a new generation by getGeneration
+    //trace record file that matches savedGeneration (used when saving and loading, with LockDatabase held)
+    duint savedGeneration;
+    String savedFile;
 };
 
 extern TraceRecordManager TraceRecord;
@@ -24,6 +24,7 @@
 #include "handles.h"
 #include "../bridge/bridgelist.h"
 #include "tcpconnections.h"
+#include "thread.h"
 
 static DBGFUNCTIONS _dbgfunctions;
 
@@ -274,6 +275,14 @@ static bool _gethandlename(duint handle, char* name, size_t nameSize, char* type
     return true;
 }
 
+static bool _enumhandledetails(ListOf(HANDLEDETAILS) handles, bool parallel)
+{
+    std::vector<HANDLEDETAILS> handleV;
+    if(!HandlesEnumDetails(fdProcessInfo->dwProcessId, fdProcessInfo->hProcess, handleV, parallel))
+        return false;
+    return BridgeList<HANDLEDETAILS>::CopyData(handles, handleV);
+}
+
 static bool _enumtcpconnections(ListOf(TCPCONNECTIONINFO) connections)
 {
     std::vector<TCPCONNECTIONINFO> connectionsV;
@@ -282,6 +291,15 @@ static bool _enumtcpconnections(ListOf(TCPCONNECTIONINFO) connections)
     return BridgeList<TCPCONNECTIONINFO>::CopyData(connections, connectionsV);
 }
 
+static bool _enumthreads(ListOf(THREADINFO) threads, int* currentThread)
+{
+    std::vector<THREADINFO> threadsV;
+    int current = ThreadGetList(threadsV);
+    if(currentThread)
+        *currentThread = current;
+    return BridgeList<THREADINFO>::CopyData(threads, threadsV);
+}
+
 void dbgfunctionsinit()
 {
     _dbgfunctions.AssembleAtEx = _assembleatex;
@@ -331,4 +349,9 @@ void dbgfunctionsinit()
     _dbgfunctions.EnumHandles = _enumhandles;
     _dbgfunctions.GetHandleName = _gethandlename;
     _dbgfunctions.EnumTcpConnections = _enumtcpconnections;
+    _dbgfunctions.EnumThreads = _enumthreads;
+    _dbgfunctions.GetThreadDetails = ThreadGetDetails;
+    _dbgfunctions.EnumHandleDetails = _enumhandledetails;
+    _dbgfunctions.GetStackAnnotations = stackannotationsget;
+    _dbgfunctions.GetMemMapChanges = MemGetMapChanges;
 }
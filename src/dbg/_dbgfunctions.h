@@ -70,7 +70,8 @@ enum TRACERECORDTYPE
     TraceRecordNone,
     TraceRecordBitExec,
     TraceRecordByteWithExecTypeAndCounter,
-    TraceRecordWordWithExecTypeAndCounter
+    TraceRecordWordWithExecTypeAndCounter,
+    TraceRecordByteWithExecTypeAndFullCounter
 };
 
 typedef struct
@@ -80,6 +81,32 @@ typedef struct
     unsigned int GrantedAccess;
 } HANDLEINFO;
 
+typedef struct
+{
+    duint Handle;
+    unsigned char TypeNumber;
+    unsigned int GrantedAccess;
+    char TypeName[MAX_STRING_SIZE];
+    char Name[MAX_STRING_SIZE];
+} HANDLEDETAILS;
+
+typedef struct
+{
+    bool hasLabel; //the stack slot itself has a label
+    bool hasComment;
+    STACK_COMMENT comment;
+} STACK_ANNOTATION;
+
+typedef struct
+{
+    duint generation; //generation of the memory map the changes lead to
+    bool reset; //the changes since the requested generation are unknown, pages holds the whole map
+    int pageCount;
+    MEMPAGE* pages; //inserted and changed regions, sorted by base address (BridgeFree)
+    int removedCount;
+    duint* removed; //base addresses of removed regions (BridgeFree)
+} MEMMAPCHANGES;
+
 // The longest ip address is 1234:6789:1234:6789:1234:6789:123.567.901.345 (46 bytes)
 #define TCP_ADDR_SIZE 50
 
@@ -139,7 +166,12 @@ typedef bool (*SETTRACERECORDTYPE)(duint pageAddress, TRACERECORDTYPE type);
 typedef TRACERECORDTYPE(*GETTRACERECORDTYPE)(duint pageAddress);
 typedef bool(*ENUMHANDLES)(ListOf(HANDLEINFO) handles);
 typedef bool(*GETHANDLENAME)(duint handle, char* name, size_t nameSize, char* typeName, size_t typeNameSize);
+typedef bool(*ENUMHANDLEDETAILS)(ListOf(HANDLEDETAILS) handles, bool parallel);
+typedef bool(*GETSTACKANNOTATIONS)(duint addr, duint count, STACK_ANNOTATION* annotations);
+typedef bool(*GETMEMMAPCHANGES)(duint sinceGeneration, MEMMAPCHANGES* changes);
 typedef bool(*ENUMTCPCONNECTIONS)(ListOf(TCPCONNECTIONINFO) connections);
+typedef bool(*ENUMTHREADS)(ListOf(THREADINFO) threads, int* currentThread);
+typedef bool(*GETTHREADDETAILS)(DWORD threadId, THREADALLINFO* info);
 
 typedef struct DBGFUNCTIONS_
 {
@@ -190,6 +222,11 @@ typedef struct DBGFUNCTIONS_
     ENUMHANDLES EnumHandles;
     GETHANDLENAME GetHandleName;
     ENUMTCPCONNECTIONS EnumTcpConnections;
+    ENUMTHREADS EnumThreads;
+    GETTHREADDETAILS GetThreadDetails;
+    ENUMHANDLEDETAILS EnumHandleDetails;
+    GETSTACKANNOTATIONS GetStackAnnotations;
+    GETMEMMAPCHANGES GetMemMapChanges;
 } DBGFUNCTIONS;
 
 #ifdef BUILD_DBG
@@ -30,6 +30,7 @@
 #include "threading.h"
 #include "stringformat.h"
 #include "xrefs.h"
+#include "console.h"
 
 static bool bOnlyCipAutoComments = false;
 
@@ -817,6 +818,7 @@ extern "C" DLL_EXPORT duint _dbg_sendmessage(DBGMSG type, void* param1, void* pa
         bListAllPages = settingboolget("Engine", "ListAllPages");
         bUndecorateSymbolNames = settingboolget("Engine", "UndecorateSymbolNames");
         bEnableSourceDebugging = settingboolget("Engine", "EnableSourceDebugging");
+        dlogconfigure();
 
         duint setting;
         if(BridgeSettingGetUint("Engine", "BreakpointType", &setting))
@@ -13,6 +13,7 @@
 #include <shlwapi.h>
 #include <vector>
 #include <stack>
+#include <deque>
 #include <map>
 #include <set>
 #include <algorithm>
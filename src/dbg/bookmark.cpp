@@ -53,6 +53,21 @@ void BookmarkCacheLoad(JSON Root)
     bookmarks.CacheLoad(Root, false, "auto"); //legacy support
 }
 
+void BookmarkCacheSave(DbFileWriter & Writer)
+{
+    bookmarks.CacheSave(Writer);
+}
+
+void BookmarkCacheLoad(const DbFileReader & Reader)
+{
+    bookmarks.CacheLoad(Reader);
+}
+
+duint BookmarkCacheGeneration()
+{
+    return bookmarks.GetGeneration();
+}
+
 bool BookmarkEnum(BOOKMARKSINFO* List, size_t* Size)
 {
     return bookmarks.Enum(List, Size);
@@ -3,6 +3,7 @@
 
 #include "_global.h"
 #include "addrinfo.h"
+#include "dbfile.h"
 
 struct BOOKMARKSINFO : AddrInfo
 {
@@ -14,6 +15,9 @@ bool BookmarkDelete(duint Address);
 void BookmarkDelRange(duint Start, duint End, bool Manual);
 void BookmarkCacheSave(JSON Root);
 void BookmarkCacheLoad(JSON Root);
+void BookmarkCacheSave(DbFileWriter & Writer);
+void BookmarkCacheLoad(const DbFileReader & Reader);
+duint BookmarkCacheGeneration();
 bool BookmarkEnum(BOOKMARKSINFO* List, size_t* Size);
 void BookmarkClear();
 void BookmarkGetList(std::vector<BOOKMARKSINFO> & list);
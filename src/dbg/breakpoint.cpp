@@ -13,6 +13,7 @@
 
 typedef std::pair<BP_TYPE, duint> BreakpointKey;
 std::map<BreakpointKey, BREAKPOINT> breakpoints;
+static volatile LONG breakpointsGeneration = 1; //hit counts are not saved and do not change it
 
 static void setBpActive(BREAKPOINT & bp)
 {
@@ -92,6 +93,7 @@ bool BpNew(duint Address, bool Enable, bool Singleshot, short OldBytes, BP_TYPE
     EXCLUSIVE_ACQUIRE(LockBreakpoints);
 
     breakpoints.insert(std::make_pair(BreakpointKey(Type, ModHashFromAddr(Address)), bp));
+    InterlockedIncrement(&breakpointsGeneration);
     return true;
 }
 
@@ -158,7 +160,10 @@ bool BpDelete(duint Address, BP_TYPE Type)
     EXCLUSIVE_ACQUIRE(LockBreakpoints);
 
     // Erase the index from the global list
-    return (breakpoints.erase(BreakpointKey(Type, ModHashFromAddr(Address))) > 0);
+    if(!breakpoints.erase(BreakpointKey(Type, ModHashFromAddr(Address))))
+        return false;
+    InterlockedIncrement(&breakpointsGeneration);
+    return true;
 }
 
 bool BpEnable(duint Address, BP_TYPE Type, bool Enable)
@@ -173,6 +178,7 @@ bool BpEnable(duint Address, BP_TYPE Type, bool Enable)
         return false;
 
     bpInfo->enabled = Enable;
+    InterlockedIncrement(&breakpointsGeneration);
 
     //Re-read oldbytes
     if(Enable && Type == BPNORMAL)
@@ -199,6 +205,7 @@ bool BpSetName(duint Address, BP_TYPE Type, const char* Name)
         return false;
 
     strcpy_s(bpInfo->name, Name);
+    InterlockedIncrement(&breakpointsGeneration);
     return true;
 }
 
@@ -214,6 +221,7 @@ bool BpSetTitanType(duint Address, BP_TYPE Type, int TitanType)
         return false;
 
     bpInfo->titantype = TitanType;
+    InterlockedIncrement(&breakpointsGeneration);
     return true;
 }
 
@@ -229,6 +237,7 @@ bool BpSetBreakCondition(duint Address, BP_TYPE Type, const char* Condition)
         return false;
 
     strcpy_s(bpInfo->breakCondition, Condition);
+    InterlockedIncrement(&breakpointsGeneration);
     return true;
 }
 
@@ -244,6 +253,7 @@ bool BpSetLogText(duint Address, BP_TYPE Type, const char* Log)
         return false;
 
     strcpy_s(bpInfo->logText, Log);
+    InterlockedIncrement(&breakpointsGeneration);
     return true;
 }
 
@@ -259,6 +269,7 @@ bool BpSetLogCondition(duint Address, BP_TYPE Type, const char* Condition)
         return false;
 
     strcpy_s(bpInfo->logCondition, Condition);
+    InterlockedIncrement(&breakpointsGeneration);
     return true;
 }
 
@@ -274,6 +285,7 @@ bool BpSetCommandText(duint Address, BP_TYPE Type, const char* Cmd)
         return false;
 
     strcpy_s(bpInfo->commandText, Cmd);
+    InterlockedIncrement(&breakpointsGeneration);
     return true;
 }
 
@@ -289,6 +301,7 @@ bool BpSetCommandCondition(duint Address, BP_TYPE Type, const char* Condition)
         return false;
 
     strcpy_s(bpInfo->commandCondition, Condition);
+    InterlockedIncrement(&breakpointsGeneration);
     return true;
 }
 
@@ -304,6 +317,7 @@ bool BpSetFastResume(duint Address, BP_TYPE Type, bool fastResume)
         return false;
 
     bpInfo->fastResume = fastResume;
+    InterlockedIncrement(&breakpointsGeneration);
     return true;
 }
 
@@ -514,6 +528,7 @@ void BpCacheLoad(JSON Root)
 
     // Remove all existing elements
     breakpoints.clear();
+    InterlockedIncrement(&breakpointsGeneration);
 
     // Get a handle to the root object -> breakpoints subtree
     const JSON jsonBreakpoints = json_object_get(Root, "breakpoints");
@@ -554,8 +569,98 @@ void BpCacheLoad(JSON Root)
     }
 }
 
+void BpCacheSave(DbFileWriter & Writer)
+{
+    EXCLUSIVE_ACQUIRE(LockBreakpoints);
+
+    Writer.BeginChunk("breakpoints");
+    for(auto & i : breakpoints)
+    {
+        auto & breakpoint = i.second;
+
+        // Ignore single-shot breakpoints
+        if(breakpoint.singleshoot)
+            continue;
+
+        Writer.BeginRecord();
+        Writer.PutHex("address", breakpoint.addr);
+        Writer.PutBool("enabled", breakpoint.enabled);
+        if(breakpoint.type == BPNORMAL)
+            Writer.PutHex("oldbytes", breakpoint.oldbytes);
+        Writer.PutInt("type", breakpoint.type);
+        Writer.PutHex("titantype", breakpoint.titantype);
+        Writer.PutString("name", breakpoint.name);
+        Writer.PutString("module", breakpoint.mod);
+        Writer.PutString("breakCondition", breakpoint.breakCondition);
+        Writer.PutString("logText", breakpoint.logText);
+        Writer.PutString("logCondition", breakpoint.logCondition);
+        Writer.PutString("commandText", breakpoint.commandText);
+        Writer.PutString("commandCondition", breakpoint.commandCondition);
+        Writer.PutBool("fastResume", breakpoint.fastResume);
+        Writer.EndRecord();
+    }
+    Writer.EndChunk();
+}
+
+template<typename T>
+static void loadStringValue(const DbRecord & record, T dest, const char* key)
+{
+    const char* text;
+    if(record.GetString(key, text))
+        strcpy_s(dest, _TRUNCATE, text);
+}
+
+void BpCacheLoad(const DbFileReader & Reader)
+{
+    EXCLUSIVE_ACQUIRE(LockBreakpoints);
+
+    // Remove all existing elements
+    breakpoints.clear();
+    InterlockedIncrement(&breakpointsGeneration);
+
+    Reader.EnumRecords("breakpoints", [](const DbRecord & record)
+    {
+        BREAKPOINT breakpoint;
+        memset(&breakpoint, 0, sizeof(BREAKPOINT));
+
+        long long type = 0;
+        duint value = 0;
+        record.GetInt("type", type);
+        breakpoint.type = (BP_TYPE)type;
+        if(breakpoint.type == BPNORMAL && record.GetHex("oldbytes", value))
+            breakpoint.oldbytes = (unsigned short)(value & 0xFFFF);
+        record.GetHex("address", breakpoint.addr);
+        record.GetBool("enabled", breakpoint.enabled);
+        if(record.GetHex("titantype", value))
+            breakpoint.titantype = (DWORD)value;
+
+        // String values
+        loadStringValue(record, breakpoint.name, "name");
+        loadStringValue(record, breakpoint.mod, "module");
+        loadStringValue(record, breakpoint.breakCondition, "breakCondition");
+        loadStringValue(record, breakpoint.logText, "logText");
+        loadStringValue(record, breakpoint.logCondition, "logCondition");
+        loadStringValue(record, breakpoint.commandText, "commandText");
+        loadStringValue(record, breakpoint.commandCondition, "commandCondition");
+
+        // Fast resume
+        record.GetBool("fastResume", breakpoint.fastResume);
+
+        // Build the hash map key: MOD_HASH + ADDRESS
+        duint key = ModHashFromName(breakpoint.mod) + breakpoint.addr;
+        breakpoints.insert(std::make_pair(BreakpointKey(breakpoint.type, key), breakpoint));
+        return true;
+    });
+}
+
+duint BpCacheGeneration()
+{
+    return duint(breakpointsGeneration);
+}
+
 void BpClear()
 {
     EXCLUSIVE_ACQUIRE(LockBreakpoints);
     breakpoints.clear();
+    InterlockedIncrement(&breakpointsGeneration);
 }
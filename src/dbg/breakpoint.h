@@ -2,6 +2,7 @@
 #define _BREAKPOINT_H
 
 #include "_global.h"
+#include "dbfile.h"
 
 #define TITANSETDRX(titantype, drx) titantype &= 0x0FF; titantype |= (drx<<8)
 #define TITANGETDRX(titantype) (titantype >> 8) & 0xF
@@ -63,6 +64,9 @@ bool BpResetHitCount(duint Address, BP_TYPE Type, uint32 newHitCount);
 void BpToBridge(const BREAKPOINT* Bp, BRIDGEBP* BridgeBp);
 void BpCacheSave(JSON Root);
 void BpCacheLoad(JSON Root);
+void BpCacheSave(DbFileWriter & Writer);
+void BpCacheLoad(const DbFileReader & Reader);
+duint BpCacheGeneration();
 void BpClear();
 
 #endif // _BREAKPOINT_H
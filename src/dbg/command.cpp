@@ -8,123 +8,153 @@
 #include "value.h"
 #include "console.h"
 #include "commandparser.h"
+#include "threading.h"
 
-COMMAND* cmd_list = 0;
+//non-owning view of a command name, the string is owned by the command record (or the caller for lookups)
+struct CommandName
+{
+    const char* str;
+    size_t len;
 
-/**
-\brief Finds a ::COMMAND in a command list.
-\param [in] command list.
-\param name The name of the command to find.
-\param [out] Link to the command.
-\return null if it fails, else a ::COMMAND*.
-*/
-COMMAND* cmdfind(const char* name, COMMAND** link)
+    CommandName(const char* str, size_t len)
+        : str(str),
+          len(len)
+    {
+    }
+};
+
+struct CommandNameHash
 {
-    COMMAND* cur = cmd_list;
-    if(!cur->name)
-        return 0;
-    COMMAND* prev = 0;
-    while(cur)
+    size_t operator()(const CommandName & name) const
     {
-        if(arraycontains(cur->name, name))
+        //FNV-1a over the lowercase characters
+        size_t hash = size_t(2166136261);
+        for(size_t i = 0; i < name.len; i++)
         {
-            if(link)
-                *link = prev;
-            return cur;
+            hash ^= size_t(tolower((unsigned char)name.str[i]));
+            hash *= size_t(16777619);
         }
-        prev = cur;
-        cur = cur->next;
+        return hash;
+    }
+};
+
+struct CommandNameEqual
+{
+    bool operator()(const CommandName & a, const CommandName & b) const
+    {
+        return a.len == b.len && !_strnicmp(a.str, b.str, a.len);
     }
-    return 0;
+};
+
+typedef COMMANDINFO CommandRecord;
+
+//every alias maps to the same (interned) command record
+static std::unordered_map<CommandName, CommandRecord*, CommandNameHash, CommandNameEqual> commandMap;
+//records in registration order, owns the memory
+static std::vector<CommandRecord*> commandList;
+//incremented every time a record is added, changed or removed
+static volatile duint commandGeneration = 0;
+
+static CommandRecord* cmdfindNoLock(const CommandName & name)
+{
+    auto found = commandMap.find(name);
+    return found == commandMap.end() ? nullptr : found->second;
+}
+
+//copies the command out while the registry is locked, records can be deleted as soon as the lock is released
+static bool cmdcopy(const CommandName & name, COMMAND* cmd)
+{
+    SHARED_ACQUIRE(LockCommands);
+    auto found = cmdfindNoLock(name);
+    if(!found)
+        return false;
+    if(cmd)
+        *cmd = found->command;
+    return true;
+}
+
+static CommandName cmdname(const char* str, char delim)
+{
+    auto end = strchr(str, delim);
+    return CommandName(str, end ? end - str : strlen(str));
+}
+
+/**
+\brief Finds a ::COMMAND in the command registry.
+\param name The name (or alias) of the command to find, case insensitive.
+\param [out] cmd A copy of the command (optional).
+\return true if the command was found.
+*/
+bool cmdfind(const char* name, COMMAND* cmd)
+{
+    if(!name)
+        return false;
+    return cmdcopy(CommandName(name, strlen(name)), cmd);
 }
 
 /**
-\brief Initialize a command list.
-\return a ::COMMAND*
+\brief Initialize the command registry.
 */
-COMMAND* cmdinit()
+void cmdinit()
 {
-    cmd_list = (COMMAND*)emalloc(sizeof(COMMAND), "cmdinit:cmd");
-    memset(cmd_list, 0, sizeof(COMMAND));
-    return cmd_list;
+    cmdfree();
 }
 
 /**
-\brief Clear a command list.
-\param [in] cmd_list Command list to clear.
+\brief Clear the command registry.
 */
 void cmdfree()
 {
-    COMMAND* cur = cmd_list;
-    while(cur)
-    {
-        efree(cur->name, "cmdfree:cur->name");
-        COMMAND* next = cur->next;
-        efree(cur, "cmdfree:cur");
-        cur = next;
-    }
+    EXCLUSIVE_ACQUIRE(LockCommands);
+    for(auto cmd : commandList)
+        delete cmd;
+    commandList.clear();
+    commandMap.clear();
+    commandGeneration++;
 }
 
 /**
-\brief Creates a new command and adds it to the list.
-\param [in,out] command_list Command list. Cannot be null.
-\param name The command name.
+\brief Creates a new command and adds it to the registry.
+\param name The command name, aliases are separated by '\1'.
 \param cbCommand The command callback.
 \param debugonly true if the command can only be executed in a debugging context.
-\return true if the command was successfully added to the list.
+\return true if the command was successfully added to the registry.
 */
 bool cmdnew(const char* name, CBCOMMAND cbCommand, bool debugonly)
 {
-    if(!cmd_list || !cbCommand || !name || !*name || cmdfind(name, 0))
+    if(!cbCommand || !name || !*name)
         return false;
-    COMMAND* cmd;
-    bool nonext = false;
-    if(!cmd_list->name)
-    {
-        cmd = cmd_list;
-        nonext = true;
-    }
-    else
-        cmd = (COMMAND*)emalloc(sizeof(COMMAND), "cmdnew:cmd");
-    memset(cmd, 0, sizeof(COMMAND));
-    cmd->name = (char*)emalloc(strlen(name) + 1, "cmdnew:cmd->name");
-    strcpy(cmd->name, name);
-    cmd->cbCommand = cbCommand;
-    cmd->debugonly = debugonly;
-    COMMAND* cur = cmd_list;
-    if(!nonext)
-    {
-        while(cur->next)
-            cur = cur->next;
-        cur->next = cmd;
-    }
+    auto names = StringUtils::Split(name, '\1');
+    EXCLUSIVE_ACQUIRE(LockCommands);
+    for(const auto & alias : names)
+        if(alias.empty() || cmdfindNoLock(CommandName(alias.c_str(), alias.length())))
+            return false;
+    auto cmd = new CommandRecord;
+    cmd->names = std::move(names);
+    cmd->command.cbCommand = cbCommand;
+    cmd->command.debugonly = debugonly;
+    for(const auto & alias : cmd->names)
+        commandMap.insert({ CommandName(alias.c_str(), alias.length()), cmd });
+    commandList.push_back(cmd);
+    commandGeneration++;
     return true;
 }
 
 /**
-\brief Gets a ::COMMAND from the command list.
-\param [in] command_list Command list.
-\param cmd The command to get from the list.
-\return null if the command was not found. Otherwise a ::COMMAND*.
+\brief Gets a ::COMMAND from the command registry.
+\param cmd The command line to get the command from (everything after the first space is ignored).
+\param [out] command A copy of the command (optional).
+\return true if the command was found.
 */
-COMMAND* cmdget(const char* cmd)
+bool cmdget(const char* cmd, COMMAND* command)
 {
-    char new_cmd[deflen] = "";
-    strcpy_s(new_cmd, deflen, cmd);
-    int len = (int)strlen(new_cmd);
-    int start = 0;
-    while(new_cmd[start] != ' ' && start < len)
-        start++;
-    new_cmd[start] = 0;
-    COMMAND* found = cmdfind(new_cmd, 0);
-    if(!found)
-        return 0;
-    return found;
+    if(!cmd)
+        return false;
+    return cmdcopy(cmdname(cmd, ' '), command);
 }
 
 /**
-\brief Sets a new command callback and debugonly property in a command list.
-\param [in] command_list Command list.
+\brief Sets a new command callback and debugonly property of a registered command.
 \param name The name of the command to change.
 \param cbCommand The new command callback.
 \param debugonly The new debugonly value.
@@ -132,50 +162,99 @@ COMMAND* cmdget(const char* cmd)
 */
 CBCOMMAND cmdset(const char* name, CBCOMMAND cbCommand, bool debugonly)
 {
-    if(!cbCommand)
+    if(!cbCommand || !name)
         return 0;
-    COMMAND* found = cmdfind(name, 0);
+    EXCLUSIVE_ACQUIRE(LockCommands);
+    CommandRecord* found = cmdfindNoLock(CommandName(name, strlen(name)));
     if(!found)
         return 0;
-    CBCOMMAND old = found->cbCommand;
-    found->cbCommand = cbCommand;
-    found->debugonly = debugonly;
+    CBCOMMAND old = found->command.cbCommand;
+    found->command.cbCommand = cbCommand;
+    found->command.debugonly = debugonly;
+    commandGeneration++;
     return old;
 }
 
 /**
-\brief Deletes a command from a command list.
-\param [in] command_list Command list.
-\param name The name of the command to delete.
+\brief Deletes a command (and all its aliases) from the command registry.
+\param name The name of the command to delete, aliases are separated by '\1' (only the first one is used for the lookup).
 \return true if the command was deleted.
 */
 bool cmddel(const char* name)
 {
-    COMMAND* prev = 0;
-    COMMAND* found = cmdfind(name, &prev);
+    if(!name)
+        return false;
+    EXCLUSIVE_ACQUIRE(LockCommands);
+    CommandRecord* found = cmdfindNoLock(cmdname(name, '\1'));
     if(!found)
         return false;
-    efree(found->name, "cmddel:found->name");
-    if(found == cmd_list)
-    {
-        COMMAND* next = cmd_list->next;
-        if(next)
-        {
-            memcpy(cmd_list, cmd_list->next, sizeof(COMMAND));
-            cmd_list->next = next->next;
-            efree(next, "cmddel:next");
-        }
-        else
-            memset(cmd_list, 0, sizeof(COMMAND));
-    }
-    else
-    {
-        prev->next = found->next;
-        efree(found, "cmddel:found");
-    }
+    for(const auto & alias : found->names)
+        commandMap.erase(CommandName(alias.c_str(), alias.length()));
+    commandList.erase(std::find(commandList.begin(), commandList.end(), found));
+    delete found;
+    commandGeneration++;
     return true;
 }
 
+/**
+\brief Gets a copy of all registered commands with their names, in registration order.
+\param [out] list The command list.
+*/
+void cmdgetlist(std::vector<COMMANDINFO> & list)
+{
+    SHARED_ACQUIRE(LockCommands);
+    list.clear();
+    list.reserve(commandList.size());
+    for(auto cmd : commandList)
+        list.push_back(*cmd);
+}
+
+/**
+\brief Gets the generation of the command registry. A ::COMMAND copy is only current as long as the generation does not change.
+\return The current generation.
+*/
+duint cmdgeneration()
+{
+    return commandGeneration;
+}
+
+/**
+\brief Executes an already resolved command with already tokenized arguments.
+\param cmd The command to execute.
+\param argc The argument count (including argv[0]).
+\param [in] argv The arguments, argv[0] is the full command.
+\return A CMDRESULT.
+*/
+CMDRESULT cmdexec(const COMMAND & cmd, int argc, char* argv[])
+{
+    if(!cmd.cbCommand)
+        return STATUS_ERROR;
+    if(cmd.debugonly && !DbgIsDebugging())
+        return STATUS_ERROR;
+    return cmd.cbCommand(argc, argv);
+}
+
+/**
+\brief Trims whitespace from both ends of a command, in place.
+\param [in,out] command The command to trim.
+*/
+static void cmdtrim(char* command)
+{
+    auto isws = [](char ch)
+    {
+        return ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t';
+    };
+    auto start = command;
+    while(isws(*start))
+        start++;
+    auto len = strlen(start);
+    while(len && isws(start[len - 1]))
+        len--;
+    if(start != command)
+        memmove(command, start, len);
+    command[len] = '\0';
+}
+
 /*
 command_list:         command list
 cbUnknownCommand:     function to execute when an unknown command was found
@@ -205,14 +284,15 @@ CMDRESULT cmdloop(CBCOMMAND cbUnknownCommand, CBCOMMANDPROVIDER cbCommandProvide
             break;
         if(strlen(command))
         {
-            strcpy_s(command, StringUtils::Trim(command).c_str());
-            COMMAND* cmd;
+            cmdtrim(command);
+            COMMAND cmd;
+            bool found;
             if(!cbCommandFinder) //'clean' command processing
-                cmd = cmdget(command);
+                found = cmdget(command, &cmd);
             else //'dirty' command processing
-                cmd = cbCommandFinder(command);
+                found = cbCommandFinder(command, &cmd);
 
-            if(!cmd || !cmd->cbCommand) //unknown command
+            if(!found || !cmd.cbCommand) //unknown command
             {
                 char* argv[1];
                 *argv = command;
@@ -222,7 +302,7 @@ CMDRESULT cmdloop(CBCOMMAND cbUnknownCommand, CBCOMMANDPROVIDER cbCommandProvide
             }
             else
             {
-                if(cmd->debugonly && !DbgIsDebugging())
+                if(cmd.debugonly && !DbgIsDebugging())
                 {
                     dputs("this command is debug-only");
                     if(error_is_fatal)
@@ -230,20 +310,8 @@ CMDRESULT cmdloop(CBCOMMAND cbUnknownCommand, CBCOMMANDPROVIDER cbCommandProvide
                 }
                 else
                 {
-                    Command commandParsed(command);
-                    int argcount = commandParsed.GetArgCount();
-                    char** argv = (char**)emalloc((argcount + 1) * sizeof(char*), "cmdloop:argv");
-                    argv[0] = command;
-                    for(int i = 0; i < argcount; i++)
-                    {
-                        argv[i + 1] = (char*)emalloc(deflen, "cmdloop:argv[i+1]");
-                        *argv[i + 1] = 0;
-                        strcpy_s(argv[i + 1], deflen, commandParsed.GetArg(i).c_str());
-                    }
-                    CMDRESULT res = cmd->cbCommand(argcount + 1, argv);
-                    for(int i = 0; i < argcount; i++)
-                        efree(argv[i + 1], "cmdloop:argv[i+1]");
-                    efree(argv, "cmdloop:argv");
+                    CommandArgv commandArgv(command);
+                    CMDRESULT res = cmd.cbCommand(commandArgv.GetArgc(), commandArgv.GetArgv());
                     if((error_is_fatal && res == STATUS_ERROR) || res == STATUS_EXIT)
                         bLoop = false;
                 }
@@ -358,17 +426,15 @@ static void specialformat(char* string)
 \brief Default command finder. It uses specialformat() and mathformat() to make sure the command is optimally checked.
 \param [in] cmd_list Command list.
 \param [in] command Command name.
-\return null if it fails, else a COMMAND*.
+\param [out] cmd A copy of the command (optional).
+\return true if the command was found.
 */
-COMMAND* cmdfindmain(char* command)
+bool cmdfindmain(char* command, COMMAND* cmd)
 {
-    COMMAND* cmd = cmdfind(command, 0);
-    if(!cmd)
-    {
-        specialformat(command);
-        cmd = cmdget(command);
-    }
-    return cmd;
+    if(cmdfind(command, cmd))
+        return true;
+    specialformat(command);
+    return cmdget(command, cmd);
 }
 
 /**
@@ -392,25 +458,12 @@ CMDRESULT cmddirectexec(const char* cmd, ...)
     _vsnprintf_s(command, _TRUNCATE, cmd, ap);
     va_end(ap);
 
-    strcpy_s(command, StringUtils::Trim(command).c_str());
-    COMMAND* found = cmdfindmain(command);
-    if(!found || !found->cbCommand)
+    cmdtrim(command);
+    COMMAND found;
+    if(!cmdfindmain(command, &found) || !found.cbCommand)
         return STATUS_ERROR;
-    if(found->debugonly && !DbgIsDebugging())
+    if(found.debugonly && !DbgIsDebugging())
         return STATUS_ERROR;
-    Command cmdParsed(command);
-    int argcount = cmdParsed.GetArgCount();
-    char** argv = (char**)emalloc((argcount + 1) * sizeof(char*), "cmddirectexec:argv");
-    argv[0] = command;
-    for(int i = 0; i < argcount; i++)
-    {
-        argv[i + 1] = (char*)emalloc(deflen, "cmddirectexec:argv[i+1]");
-        *argv[i + 1] = 0;
-        strcpy_s(argv[i + 1], deflen, cmdParsed.GetArg(i).c_str());
-    }
-    CMDRESULT res = found->cbCommand(argcount + 1, argv);
-    for(int i = 0; i < argcount; i++)
-        efree(argv[i + 1], "cmddirectexec:argv[i+1]");
-    efree(argv, "cmddirectexec:argv");
-    return res;
+    CommandArgv commandArgv(command);
+    return found.cbCommand(commandArgv.GetArgc(), commandArgv.GetArgv());
 }
@@ -17,26 +17,35 @@ enum CMDRESULT
 
 typedef CMDRESULT(*CBCOMMAND)(int, char**);
 typedef bool (*CBCOMMANDPROVIDER)(char*, int);
-typedef COMMAND* (*CBCOMMANDFINDER)(char*);
+typedef bool (*CBCOMMANDFINDER)(char*, COMMAND*);
 
+//copy of a registered command, it stays usable when the registry changes
 struct COMMAND
 {
-    char* name;
     CBCOMMAND cbCommand;
     bool debugonly;
-    COMMAND* next;
+};
+
+//copy of a registered command with its names, as returned by cmdgetlist
+struct COMMANDINFO
+{
+    std::vector<String> names; //first entry is the primary name, the rest are aliases
+    COMMAND command;
 };
 
 //functions
-COMMAND* cmdinit();
+void cmdinit();
 void cmdfree();
-COMMAND* cmdfind(const char* name, COMMAND** link);
+bool cmdfind(const char* name, COMMAND* cmd);
 bool cmdnew(const char* name, CBCOMMAND cbCommand, bool debugonly);
-COMMAND* cmdget(const char* cmd);
+bool cmdget(const char* cmd, COMMAND* command);
 CBCOMMAND cmdset(const char* name, CBCOMMAND cbCommand, bool debugonly);
 bool cmddel(const char* name);
+void cmdgetlist(std::vector<COMMANDINFO> & list);
+duint cmdgeneration();
+CMDRESULT cmdexec(const COMMAND & cmd, int argc, char* argv[]);
 CMDRESULT cmdloop(CBCOMMAND cbUnknownCommand, CBCOMMANDPROVIDER cbCommandProvider, CBCOMMANDFINDER cbCommandFinder, bool error_is_fatal);
-COMMAND* cmdfindmain(char* command);
+bool cmdfindmain(char* command, COMMAND* cmd);
 CMDRESULT cmddirectexec(const char* cmd, ...);
 
 #endif // _COMMAND_H
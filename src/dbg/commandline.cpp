@@ -5,6 +5,7 @@
 #include "debugger_commands.h"
 
 char commandLine[MAX_COMMAND_LINE_SIZE];
+static volatile LONG commandLineGeneration = 1;
 
 bool isCmdLineEmpty()
 {
@@ -51,6 +52,7 @@ void CmdLineCacheLoad(JSON Root)
 
     // Clear command line
     memset(commandLine, 0, MAX_COMMAND_LINE_SIZE);
+    InterlockedIncrement(&commandLineGeneration);
 
     // Get a handle to the root object -> commandLine
     const JSON jsonCmdLine = json_object_get(Root, "commandLine");
@@ -66,9 +68,47 @@ void CmdLineCacheLoad(JSON Root)
     json_decref(jsonCmdLine);
 }
 
+void CmdLineCacheSave(DbFileWriter & Writer)
+{
+    EXCLUSIVE_ACQUIRE(LockCmdLine);
+
+    // return if command line is empty
+    if(!strlen(commandLine))
+        return;
+
+    Writer.BeginChunk("commandLine");
+    Writer.BeginRecord();
+    Writer.PutString("cmdLine", commandLine);
+    Writer.EndRecord();
+    Writer.EndChunk();
+}
+
+void CmdLineCacheLoad(const DbFileReader & Reader)
+{
+    EXCLUSIVE_ACQUIRE(LockCmdLine);
+
+    // Clear command line
+    memset(commandLine, 0, MAX_COMMAND_LINE_SIZE);
+    InterlockedIncrement(&commandLineGeneration);
+
+    Reader.EnumRecords("commandLine", [](const DbRecord & record)
+    {
+        const char* cmdLine;
+        if(record.GetString("cmdLine", cmdLine))
+            strcpy_s(commandLine, _TRUNCATE, cmdLine);
+        return false;
+    });
+}
+
+duint CmdLineCacheGeneration()
+{
+    return duint(commandLineGeneration);
+}
+
 void copyCommandLine(const char* cmdLine)
 {
     strcpy_s(commandLine, cmdLine);
+    InterlockedIncrement(&commandLineGeneration);
 }
 
 CMDRESULT SetCommandLine()
@@ -3,11 +3,15 @@
 
 #include "_global.h"
 #include "command.h"
+#include "dbfile.h"
 
 bool isCmdLineEmpty();
 char* getCommandLineArgs();
 void CmdLineCacheSave(JSON Root);
 void CmdLineCacheLoad(JSON Root);
+void CmdLineCacheSave(DbFileWriter & Writer);
+void CmdLineCacheLoad(const DbFileReader & Reader);
+duint CmdLineCacheGeneration();
 void copyCommandLine(const char* cmdLine);
 CMDRESULT setCommandLine();
 
@@ -1,88 +1,106 @@
 #include "commandparser.h"
 
-Command::Command(const String & command)
+class CommandTokenizer
 {
-    ParseState state = Default;
-    int len = (int)command.length();
-    for(int i = 0; i < len; i++)
+public:
+    template<class TSink>
+    static void Tokenize(const char* command, size_t len, TSink & sink)
     {
-        char ch = command[i];
-        switch(state)
+        ParseState state = Default;
+        for(size_t i = 0; i < len; i++)
         {
-        case Default:
-            switch(ch)
-            {
-            case '\t':
-            case ' ':
-                if(!_tokens.size())
-                    dataFinish();
-                break;
-            case ',':
-                dataFinish();
-                break;
-            case '\\':
-                state = Escaped;
-                break;
-            case '\"':
-                state = Text;
-                break;
-            default:
-                dataAppend(ch);
-                break;
-            }
-            break;
-        case Escaped:
-            switch(ch)
-            {
-            case '\t':
-            case ' ':
-                dataAppend(' ');
-                break;
-            case ',':
-                dataAppend(ch);
-                break;
-            case '\"':
-                dataAppend(ch);
-                break;
-            default:
-                dataAppend('\\');
-                dataAppend(ch);
-                break;
-            }
-            state = Default;
-            break;
-        case Text:
-            switch(ch)
+            char ch = command[i];
+            switch(state)
             {
-            case '\\':
-                state = TextEscaped;
+            case Default:
+                switch(ch)
+                {
+                case '\t':
+                case ' ':
+                    if(!sink.tokenCount())
+                        sink.dataFinish();
+                    break;
+                case ',':
+                    sink.dataFinish();
+                    break;
+                case '\\':
+                    state = Escaped;
+                    break;
+                case '\"':
+                    state = Text;
+                    break;
+                default:
+                    sink.dataAppend(ch);
+                    break;
+                }
                 break;
-            case '\"':
+            case Escaped:
+                switch(ch)
+                {
+                case '\t':
+                case ' ':
+                    sink.dataAppend(' ');
+                    break;
+                case ',':
+                    sink.dataAppend(ch);
+                    break;
+                case '\"':
+                    sink.dataAppend(ch);
+                    break;
+                default:
+                    sink.dataAppend('\\');
+                    sink.dataAppend(ch);
+                    break;
+                }
                 state = Default;
                 break;
-            default:
-                dataAppend(ch);
-                break;
-            }
-            break;
-        case TextEscaped:
-            switch(ch)
-            {
-            case '\"':
-                dataAppend(ch);
+            case Text:
+                switch(ch)
+                {
+                case '\\':
+                    state = TextEscaped;
+                    break;
+                case '\"':
+                    state = Default;
+                    break;
+                default:
+                    sink.dataAppend(ch);
+                    break;
+                }
                 break;
-            default:
-                dataAppend('\\');
-                dataAppend(ch);
+            case TextEscaped:
+                switch(ch)
+                {
+                case '\"':
+                    sink.dataAppend(ch);
+                    break;
+                default:
+                    sink.dataAppend('\\');
+                    sink.dataAppend(ch);
+                    break;
+                }
+                state = Text;
                 break;
             }
-            state = Text;
-            break;
         }
+        if(state == Escaped || state == TextEscaped)
+            sink.dataAppend('\\');
+        sink.dataFinish();
     }
-    if(state == Escaped || state == TextEscaped)
-        dataAppend('\\');
-    dataFinish();
+
+private:
+    enum ParseState
+    {
+        Default,
+        Escaped,
+        Text,
+        TextEscaped
+    };
+};
+
+Command::Command(const String & command)
+{
+    CommandTokenizer::Tokenize(command.c_str(), command.length(), *this);
 }
 
 const String Command::GetText()
@@ -100,6 +118,11 @@ const String Command::GetArg(int argnum)
     return (int)_tokens.size() < argnum + 1 ? String() : _tokens[argnum + 1];
 }
 
+int Command::tokenCount() const
+{
+    return int(_tokens.size());
+}
+
 void Command::dataAppend(const char ch)
 {
     _data += ch;
@@ -113,3 +136,55 @@ void Command::dataFinish()
         _data.clear();
     }
 }
+
+CommandArgv::CommandArgv(char* command)
+    : mArgc(1),
+      mSize(0),
+      mTokenCount(0),
+      mTokenOpen(false),
+      mStoring(false)
+{
+    mArgv[0] = command;
+    CommandTokenizer::Tokenize(command, strlen(command), *this);
+    mArgv[mArgc] = nullptr;
+}
+
+int CommandArgv::GetArgc() const
+{
+    return mArgc;
+}
+
+char** CommandArgv::GetArgv()
+{
+    return mArgv;
+}
+
+int CommandArgv::tokenCount() const
+{
+    return mTokenCount;
+}
+
+void CommandArgv::dataAppend(const char ch)
+{
+    if(!mTokenOpen)
+    {
+        mTokenOpen = true;
+        //the first token is the command name, it is only passed as part of argv[0]
+        mStoring = mTokenCount && mArgc < _countof(mArgv) - 1 && mSize + 1 < sizeof(mBuffer);
+        if(mStoring)
+            mArgv[mArgc++] = mBuffer + mSize;
+    }
+    //always keep room for the terminator
+    if(mStoring && mSize + 1 < sizeof(mBuffer))
+        mBuffer[mSize++] = ch;
+}
+
+void CommandArgv::dataFinish()
+{
+    if(!mTokenOpen)
+        return;
+    if(mStoring)
+        mBuffer[mSize++] = '\0';
+    mTokenOpen = false;
+    mTokenCount++;
+}
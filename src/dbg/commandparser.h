@@ -15,16 +15,38 @@ private:
     String _data;
     std::vector<String> _tokens;
 
-    enum ParseState
-    {
-        Default,
-        Escaped,
-        Text,
-        TextEscaped
-    };
+    int tokenCount() const;
+    void dataFinish();
+    void dataAppend(const char ch);
+
+    friend class CommandTokenizer;
+};
+
+/**
+\brief Allocation-free command tokenizer. The storage is part of the object (so put it on the stack),
+       which makes it re-entrant and private to the executing thread. Tokens follow the same rules as ::Command.
+*/
+class CommandArgv
+{
+public:
+    explicit CommandArgv(char* command);
+    int GetArgc() const;
+    char** GetArgv();
 
+private:
+    char mBuffer[deflen * 2];
+    char* mArgv[deflen / 2 + 2];
+    int mArgc;
+    size_t mSize;
+    int mTokenCount;
+    bool mTokenOpen;
+    bool mStoring;
+
+    int tokenCount() const;
     void dataFinish();
     void dataAppend(const char ch);
+
+    friend class CommandTokenizer;
 };
 
 #endif // _COMMANDPARSER_H
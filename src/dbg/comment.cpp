@@ -78,6 +78,21 @@ void CommentCacheLoad(JSON Root)
     comments.CacheLoad(Root, false, "auto"); //legacy support
 }
 
+void CommentCacheSave(DbFileWriter & Writer)
+{
+    comments.CacheSave(Writer);
+}
+
+void CommentCacheLoad(const DbFileReader & Reader)
+{
+    comments.CacheLoad(Reader);
+}
+
+duint CommentCacheGeneration()
+{
+    return comments.GetGeneration();
+}
+
 bool CommentEnum(COMMENTSINFO* List, size_t* Size)
 {
     return comments.Enum(List, Size);
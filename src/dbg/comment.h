@@ -3,6 +3,7 @@
 
 #include "_global.h"
 #include "addrinfo.h"
+#include "dbfile.h"
 
 struct COMMENTSINFO : AddrInfo
 {
@@ -15,6 +16,9 @@ bool CommentDelete(duint Address);
 void CommentDelRange(duint Start, duint End, bool Manual);
 void CommentCacheSave(JSON Root);
 void CommentCacheLoad(JSON Root);
+void CommentCacheSave(DbFileWriter & Writer);
+void CommentCacheLoad(const DbFileReader & Reader);
+duint CommentCacheGeneration();
 bool CommentEnum(COMMENTSINFO* List, size_t* Size);
 void CommentClear();
 void CommentGetList(std::vector<COMMENTSINFO> & list);
@@ -4,6 +4,153 @@
 */
 
 #include "console.h"
+#include "threading.h"
+
+/*
+Asynchronous log pipeline: producers (any thread calling dprintf) copy their message into a bounded
+multi-producer single-consumer ring of fixed size slots without taking a lock. A flusher thread drains
+the ring every LogFlushInterval ms (or earlier when the ring fills up) and hands the GUI one message
+per batch. Settings (section "Log"):
+- DisableAsync:  send every message to the GUI synchronously (old behaviour)
+- DropOnFull:    drop messages when the ring is full instead of waiting for the flusher (back-pressure)
+- FlushInterval: maximum time in ms between two batches
+- File:          tee the log to this file
+- FileOnly:      only write to the file, do not send anything to the GUI
+*/
+
+#define LOG_SLOT_SIZE 240
+#define LOG_SLOT_COUNT 4096 //must be a power of two
+#define LOG_SLOT_MASK (LOG_SLOT_COUNT - 1)
+#define LOG_BUFFER_LIMIT (1024 * 1024) //buffered output is sent early when it grows beyond this
+
+struct LogSlot
+{
+    volatile LONG sequence; //position this slot is free for, position + 1 when it holds data
+    unsigned int size;
+    char data[LOG_SLOT_SIZE];
+};
+
+static LogSlot logSlots[LOG_SLOT_COUNT];
+static volatile LONG logHead = 0; //next position to reserve (producers)
+static LONG logTail = 0; //next position to read (consumer, protected by LockConsole)
+static volatile LONG logProducers = 0; //threads that saw bAsyncLog and may still touch the ring or hLogEvent
+static volatile LONG logDropped = 0;
+static duint logDroppedTotal = 0;
+
+static HANDLE hLogEvent = nullptr;
+static HANDLE hLogThread = nullptr;
+static bool volatile bAsyncLog = false;
+static bool volatile bStopLogThread = false;
+static bool volatile bLogDropOnFull = false;
+static DWORD volatile logFlushInterval = 50;
+static FILE* logFile = nullptr;
+static bool bLogFileOnly = false;
+
+static bool volatile bBufferLog = false;
+static String logBuffer;
+
+//caller must hold LockConsole
+static void logoutput(const char* text)
+{
+    if(logFile)
+        fputs(text, logFile);
+    if(!logFile || !bLogFileOnly)
+        GuiAddLogMessage(text);
+}
+
+static bool logpush(const char* text, size_t len)
+{
+    ULONG count = ULONG((len + LOG_SLOT_SIZE - 1) / LOG_SLOT_SIZE);
+    if(!count)
+        return true;
+    if(count > LOG_SLOT_COUNT / 2) //too big for the ring
+        return false;
+    while(true)
+    {
+        ULONG pos = ULONG(logHead);
+        bool available = true;
+        for(ULONG i = 0; i < count; i++)
+        {
+            if(ULONG(logSlots[(pos + i) & LOG_SLOT_MASK].sequence) != pos + i)
+            {
+                available = false;
+                break;
+            }
+        }
+        if(available)
+        {
+            if(ULONG(InterlockedCompareExchange(&logHead, LONG(pos + count), LONG(pos))) != pos) //another producer was faster
+                continue;
+            for(ULONG i = 0; i < count; i++)
+            {
+                auto & slot = logSlots[(pos + i) & LOG_SLOT_MASK];
+                size_t offset = i * LOG_SLOT_SIZE;
+                slot.size = (unsigned int)min(len - offset, size_t(LOG_SLOT_SIZE));
+                memcpy(slot.data, text + offset, slot.size);
+                InterlockedExchange(&slot.sequence, LONG(pos + i + 1)); //publish
+            }
+            if(pos + count - ULONG(logTail) >= LOG_SLOT_COUNT / 2) //wake the flusher early when the ring fills up
+                SetEvent(hLogEvent);
+            return true;
+        }
+        if(ULONG(logHead) != pos) //another producer reserved the slots, try again
+            continue;
+        //the ring is full
+        if(!bAsyncLog) //the flusher is stopping, write it synchronously
+            return false;
+        SetEvent(hLogEvent);
+        if(bLogDropOnFull)
+        {
+            InterlockedIncrement(&logDropped);
+            return true;
+        }
+        Sleep(1);
+    }
+}
+
+//caller must hold LockConsole
+static void logdrain(String & output)
+{
+    while(true)
+    {
+        auto & slot = logSlots[ULONG(logTail) & LOG_SLOT_MASK];
+        if(ULONG(slot.sequence) != ULONG(logTail) + 1) //empty or not published yet
+            break;
+        output.append(slot.data, slot.size);
+        InterlockedExchange(&slot.sequence, LONG(ULONG(logTail) + LOG_SLOT_COUNT)); //free for the next round
+        logTail = LONG(ULONG(logTail) + 1);
+    }
+}
+
+//drain the ring into the buffer and send it (while buffering only when forced or past LOG_BUFFER_LIMIT)
+static void logflush(bool force)
+{
+    EXCLUSIVE_ACQUIRE(LockConsole);
+    logdrain(logBuffer);
+    LONG dropped = InterlockedExchange(&logDropped, 0);
+    if(dropped)
+    {
+        logDroppedTotal += dropped;
+        logBuffer.append(StringUtils::sprintf("%d log message(s) dropped (%" fext "u total)\n", dropped, logDroppedTotal));
+    }
+    if(logBuffer.empty() || (bBufferLog && !force && logBuffer.size() < LOG_BUFFER_LIMIT))
+        return;
+    logoutput(logBuffer.c_str());
+    logBuffer.clear();
+    if(logFile)
+        fflush(logFile);
+}
+
+static DWORD WINAPI logFlushThread(void* param)
+{
+    while(!bStopLogThread)
+    {
+        WaitForSingleObject(hLogEvent, logFlushInterval);
+        logflush(false);
+    }
+    logflush(false);
+    return 0;
+}
 
 /**
 \brief Print a line with text, terminated with a newline to the console.
@@ -39,7 +186,124 @@ void dprintf(const char* Format, ...)
 void dprintf_args(const char* Format, va_list Args)
 {
     char buffer[16384];
-    vsnprintf_s(buffer, _TRUNCATE, Format, Args);
+    int len = vsnprintf_s(buffer, _TRUNCATE, Format, Args);
+    if(len < 0)
+        len = int(strlen(buffer));
+
+    InterlockedIncrement(&logProducers);
+    bool pushed = bAsyncLog && logpush(buffer, size_t(len));
+    InterlockedDecrement(&logProducers);
+    if(pushed)
+        return;
 
-    GuiAddLogMessage(buffer);
+    EXCLUSIVE_ACQUIRE(LockConsole);
+    logdrain(logBuffer); //messages still in the ring go first
+    if(bBufferLog || !logBuffer.empty())
+    {
+        logBuffer.append(buffer, size_t(len));
+        if(!bBufferLog || logBuffer.size() >= LOG_BUFFER_LIMIT)
+        {
+            logoutput(logBuffer.c_str());
+            logBuffer.clear();
+        }
+    }
+    else
+        logoutput(buffer);
+}
+
+/**
+\brief Start or stop buffering log output. While buffering, messages are collected and only sent to the GUI by dflushlog()
+       or when more than LOG_BUFFER_LIMIT bytes are buffered. The asynchronous flusher collects into the same buffer.
+\param Enable true to start buffering, false to flush the buffer and stop buffering.
+*/
+void dbufferlog(bool Enable)
+{
+    if(Enable)
+    {
+        bBufferLog = true;
+        return;
+    }
+    bBufferLog = false;
+    dflushlog();
+}
+
+/**
+\brief Send all buffered log output to the GUI in one message.
+*/
+void dflushlog()
+{
+    logflush(true);
+}
+
+//stop the flusher thread, the log file stays open
+static void logstopthread()
+{
+    if(!hLogThread)
+        return;
+    bAsyncLog = false; //new messages go directly to the GUI
+    MemoryBarrier(); //pairs with the InterlockedIncrement of logProducers in dprintf_args
+    bStopLogThread = true;
+    SetEvent(hLogEvent);
+    WaitForSingleObject(hLogThread, INFINITE);
+    CloseHandle(hLogThread);
+    hLogThread = nullptr;
+    while(logProducers) //producers that saw bAsyncLog too late may still push and signal the event
+        Sleep(1);
+    CloseHandle(hLogEvent);
+    hLogEvent = nullptr;
+    dflushlog(); //their messages are in the ring
+}
+
+/**
+\brief (Re)load the log settings. Called on startup and every time the settings are updated.
+*/
+void dlogconfigure()
+{
+    duint setting;
+    bLogDropOnFull = settingboolget("Log", "DropOnFull");
+    logFlushInterval = BridgeSettingGetUint("Log", "FlushInterval", &setting) && setting ? DWORD(setting) : 50;
+    char logFileName[MAX_SETTING_SIZE] = "";
+    bool hasLogFile = BridgeSettingGet("Log", "File", logFileName) && *logFileName;
+    {
+        EXCLUSIVE_ACQUIRE(LockConsole);
+        if(logFile)
+        {
+            fclose(logFile);
+            logFile = nullptr;
+        }
+        if(hasLogFile)
+            logFile = _wfopen(StringUtils::Utf8ToUtf16(logFileName).c_str(), L"ab");
+        bLogFileOnly = settingboolget("Log", "FileOnly");
+    }
+    bool async = !settingboolget("Log", "DisableAsync");
+    if(async && !hLogThread)
+    {
+        static bool initialized = false;
+        if(!initialized)
+        {
+            for(LONG i = 0; i < LOG_SLOT_COUNT; i++)
+                logSlots[i].sequence = i;
+            initialized = true;
+        }
+        hLogEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+        bStopLogThread = false;
+        hLogThread = CreateThread(nullptr, 0, logFlushThread, nullptr, 0, nullptr);
+        bAsyncLog = true;
+    }
+    else if(!async && hLogThread)
+        logstopthread();
+}
+
+/**
+\brief Stop the asynchronous log pipeline and close the log file, everything that was logged so far is sent to the GUI.
+*/
+void dlogstop()
+{
+    logstopthread();
+    EXCLUSIVE_ACQUIRE(LockConsole);
+    if(logFile)
+    {
+        fclose(logFile);
+        logFile = nullptr;
+    }
 }
@@ -6,5 +6,9 @@
 void dputs(const char* Text);
 void dprintf(const char* Format, ...);
 void dprintf_args(const char* Format, va_list Args);
+void dbufferlog(bool Enable);
+void dflushlog();
+void dlogconfigure();
+void dlogstop();
 
 #endif // _CONSOLE_H
\ No newline at end of file
@@ -4,6 +4,7 @@
 @brief Implements runtime database saving and loading.
 */
 
+#include "lz4\lz4.h"
 #include "lz4\lz4file.h"
 #include "console.h"
 #include "breakpoint.h"
@@ -19,6 +20,7 @@
 #include "filehelper.h"
 #include "xrefs.h"
 #include "TraceRecord.h"
+#include "dbfile.h"
 
 /**
 \brief Directory where program databases are stored (usually in \db). UTF-8 encoding.
@@ -30,12 +32,145 @@ char dbbasepath[deflen];
 */
 char dbpath[deflen];
 
-void DbSave(DbLoadSaveType saveType)
+/**
+\brief The database of this session was already backed up (the backup is the database as it was before the session).
+*/
+static bool dbBackedUp = false;
+
+/**
+\brief Subsystem that tracks modifications, its chunk is only serialized again when its generation changed.
+*/
+struct DbCachedSection
 {
-    EXCLUSIVE_ACQUIRE(LockDatabase);
+    const char* name;
+    duint(*generation)();
+    void(*save)(DbFileWriter & writer);
+};
 
-    dprintf("Saving database...");
-    DWORD ticks = GetTickCount();
+static const DbCachedSection dbCachedSections[] =
+{
+    { "commandLine", CmdLineCacheGeneration, CmdLineCacheSave }, //must be first, it is also saved on its own
+    { "comments", CommentCacheGeneration, CommentCacheSave },
+    { "labels", LabelCacheGeneration, LabelCacheSave },
+    { "bookmarks", BookmarkCacheGeneration, BookmarkCacheSave },
+    { "functions", FunctionCacheGeneration, FunctionCacheSave },
+    { "xrefs", XrefCacheGeneration, XrefCacheSave },
+    { "loops", LoopCacheGeneration, LoopCacheSave },
+    { "breakpoints", BpCacheGeneration, BpCacheSave },
+};
+
+#define DB_CACHED_SECTIONS (sizeof(dbCachedSections) / sizeof(dbCachedSections[0]))
+
+// Range of dbCachedSections that belongs to a load or save type
+static void dbSectionRange(DbLoadSaveType type, size_t & first, size_t & end)
+{
+    first = type == DbLoadSaveType::DebugData ? 1 : 0;
+    end = type == DbLoadSaveType::CommandLine ? 1 : DB_CACHED_SECTIONS;
+}
+
+struct DbChunkCache
+{
+    duint generation; //0 when nothing is cached
+    bool compress;
+    std::vector<unsigned char> data; //serialized blocks
+};
+
+// Protected by LockDatabase
+static DbChunkCache dbChunkCache[DB_CACHED_SECTIONS];
+static duint dbSavedGenerations[DB_CACHED_SECTIONS]; //generations in the current program database
+static duint dbSavedTraceGeneration;
+static String dbSavedNotes;
+
+static HANDLE hDbAutosaveThread = nullptr;
+static HANDLE hDbAutosaveStop = nullptr;
+
+static void dbSaveCachedSection(DbFileWriter & writer, size_t index, bool compress)
+{
+    const auto & section = dbCachedSections[index];
+    auto & cache = dbChunkCache[index];
+    // Read the generation before serializing, a modification in between only causes another serialization
+    duint generation = section.generation();
+    if(cache.generation != generation || cache.compress != compress)
+    {
+        DbFileWriter chunkWriter(compress);
+        chunkWriter.OpenMemory();
+        section.save(chunkWriter);
+        chunkWriter.Close();
+        chunkWriter.TakeMemory(cache.data);
+        cache.generation = generation;
+        cache.compress = compress;
+    }
+    writer.PutChunkData(cache.data);
+}
+
+static bool dbIsDirty(const char* notes)
+{
+    for(size_t i = 0; i < DB_CACHED_SECTIONS; i++)
+        if(dbCachedSections[i].generation() != dbSavedGenerations[i])
+            return true;
+    if(TraceRecord.getGeneration() != dbSavedTraceGeneration)
+        return true;
+    return dbSavedNotes != (notes ? notes : "");
+}
+
+static bool dbSaveBinary(const String & dbfile, DbLoadSaveType saveType, bool compress, const char* notes)
+{
+    // Write to a temporary file so a failed save never leaves a truncated database behind
+    String tempfile = dbfile + ".tmp";
+    DbFileWriter writer(compress);
+    if(!writer.Open(tempfile))
+        return false;
+
+    size_t first, end;
+    dbSectionRange(saveType, first, end);
+    duint generations[DB_CACHED_SECTIONS];
+    for(size_t i = first; i < end; i++)
+    {
+        dbSaveCachedSection(writer, i, compress);
+        generations[i] = dbChunkCache[i].generation;
+    }
+
+    duint traceGeneration = 0;
+    if(saveType == DbLoadSaveType::DebugData || saveType == DbLoadSaveType::All)
+    {
+        traceGeneration = TraceRecord.getGeneration();
+        TraceRecord.saveToDb(writer, dbfile);
+
+        //save notes
+        if(notes)
+        {
+            writer.BeginChunk("notes");
+            writer.BeginRecord();
+            writer.PutString("text", notes);
+            writer.EndRecord();
+            writer.EndChunk();
+        }
+    }
+
+    bool empty = writer.IsEmpty();
+    bool success = writer.Close();
+    auto wdbpath = StringUtils::Utf8ToUtf16(dbfile);
+    auto wtemppath = StringUtils::Utf8ToUtf16(tempfile);
+    if(success && !empty)
+        success = !!MoveFileExW(wtemppath.c_str(), wdbpath.c_str(), MOVEFILE_REPLACE_EXISTING);
+    else if(success) //remove database when nothing is in there
+        DeleteFileW(wdbpath.c_str());
+    DeleteFileW(wtemppath.c_str());
+    if(success && dbfile == dbpath)
+    {
+        for(size_t i = first; i < end; i++)
+            dbSavedGenerations[i] = generations[i];
+        if(saveType != DbLoadSaveType::CommandLine)
+        {
+            dbSavedTraceGeneration = traceGeneration;
+            dbSavedNotes = notes ? notes : "";
+        }
+    }
+    return success;
+}
+
+static bool dbSaveJson(const String & dbfile, DbLoadSaveType saveType, bool compress)
+{
     JSON root = json_object();
 
     // Save only command line
@@ -52,7 +187,7 @@ void DbSave(DbLoadSaveType saveType)
         FunctionCacheSave(root);
         LoopCacheSave(root);
         XrefCacheSave(root);
-        TraceRecord.saveToDb(root);
+        TraceRecord.saveToDb(root, dbfile);
         BpCacheSave(root);
 
         //save notes
@@ -65,8 +200,7 @@ void DbSave(DbLoadSaveType saveType)
         }
     }
 
-    auto wdbpath = StringUtils::Utf8ToUtf16(dbpath);
-    CopyFileW(wdbpath.c_str(), (wdbpath + L".bak").c_str(), FALSE); //make a backup
+    auto wdbpath = StringUtils::Utf8ToUtf16(dbfile);
     if(json_object_size(root))
     {
         char* jsonText = json_dumps(root, JSON_INDENT(4));
@@ -74,79 +208,180 @@ void DbSave(DbLoadSaveType saveType)
         if(jsonText)
         {
             // Dump JSON to disk (overwrite any old files)
-            if(!FileHelper::WriteAllText(dbpath, jsonText))
+            if(!FileHelper::WriteAllText(dbfile, jsonText))
             {
-                dputs("\nFailed to write database file!");
                 json_free(jsonText);
                 json_decref(root);
-                return;
+                return false;
             }
 
             json_free(jsonText);
         }
 
-        if(!settingboolget("Engine", "DisableDatabaseCompression"))
+        if(compress)
             LZ4_compress_fileW(wdbpath.c_str(), wdbpath.c_str());
     }
     else //remove database when nothing is in there
         DeleteFileW(wdbpath.c_str());
 
-    dprintf("%ums\n", GetTickCount() - ticks);
     json_decref(root); //free root
+    return true;
 }
 
-void DbLoad(DbLoadSaveType loadType)
+/**
+\brief Saves the program database.
+\param saveType What to save.
+\param dbfile The file to save to, nullptr for the current program database.
+\param json Save in the (uncompressed when dbfile is set) JSON format instead of the binary format.
+*/
+void DbSave(DbLoadSaveType saveType, const char* dbfile, bool json)
 {
     EXCLUSIVE_ACQUIRE(LockDatabase);
 
-    // If the file doesn't exist, there is no DB to load
-    if(!FileExists(dbpath))
-        return;
+    dprintf("Saving database...");
+    DWORD ticks = GetTickCount();
 
-    if(loadType == DbLoadSaveType::CommandLine)
-        dputs("Loading commandline...");
+    String file = dbfile ? dbfile : dbpath;
+    bool compress = !dbfile && !settingboolget("Engine", "DisableDatabaseCompression");
+    if(!dbfile && !dbBackedUp) //autosave saves often, back up once per session
+    {
+        auto wdbpath = StringUtils::Utf8ToUtf16(dbpath);
+        CopyFileW(wdbpath.c_str(), (wdbpath + L".bak").c_str(), FALSE); //make a backup
+        dbBackedUp = true;
+    }
+    bool success;
+    if(json)
+        success = dbSaveJson(file, saveType, compress);
     else
-        dprintf("Loading database...");
-    DWORD ticks = GetTickCount();
+    {
+        char* notes = nullptr;
+        if(saveType != DbLoadSaveType::CommandLine)
+            GuiGetDebuggeeNotes(&notes);
+        success = dbSaveBinary(file, saveType, compress, notes);
+        if(notes)
+            BridgeFree(notes);
+    }
+    if(!success)
+    {
+        dputs("\nFailed to write database file!");
+        return;
+    }
 
-    // Multi-byte (UTF8) file path converted to UTF16
-    WString databasePathW = StringUtils::Utf8ToUtf16(dbpath);
+    dprintf("%ums\n", GetTickCount() - ticks);
+}
 
-    // Decompress the file if compression was enabled
-    bool useCompression = !settingboolget("Engine", "DisableDatabaseCompression");
-    LZ4_STATUS lzmaStatus = LZ4_INVALID_ARCHIVE;
+static void dbLoadBinary(const String & dbfile, DbLoadSaveType loadType)
+{
+    DbFileReader reader;
+    if(!reader.Open(dbfile))
     {
-        lzmaStatus = LZ4_decompress_fileW(databasePathW.c_str(), databasePathW.c_str());
+        dputs("\nInvalid database file!");
+        return;
+    }
 
-        // Check return code
-        if(useCompression && lzmaStatus != LZ4_SUCCESS && lzmaStatus != LZ4_INVALID_ARCHIVE)
-        {
-            dputs("\nInvalid database file!");
-            return;
-        }
+    // Load only command line
+    if(loadType == DbLoadSaveType::CommandLine || loadType == DbLoadSaveType::All)
+    {
+        CmdLineCacheLoad(reader);
     }
 
-    // Read the database file
-    String databaseText;
+    if(loadType == DbLoadSaveType::DebugData || loadType == DbLoadSaveType::All)
+    {
+        // Finally load all structures
+        CommentCacheLoad(reader);
+        LabelCacheLoad(reader);
+        BookmarkCacheLoad(reader);
+        FunctionCacheLoad(reader);
+        LoopCacheLoad(reader);
+        XrefCacheLoad(reader);
+        TraceRecord.loadFromDb(reader, dbfile);
+        BpCacheLoad(reader);
 
-    if(!FileHelper::ReadAllText(dbpath, databaseText))
+        // Load notes
+        String notes;
+        reader.EnumRecords("notes", [&notes](const DbRecord & record)
+        {
+            const char* text;
+            if(record.GetString("text", text))
+                notes = text;
+            return false;
+        });
+        GuiSetDebuggeeNotes(notes.c_str());
+        if(dbfile == dbpath)
+            dbSavedNotes = notes;
+    }
+}
+
+/**
+\brief Parses a JSON database, which is either plain text or an LZ4_compress_file archive
+       (32-bit uncompressed size followed by one LZ4 block). The file is mapped and
+       decompressed in memory, it is never modified.
+\return The root object, nullptr on failure.
+*/
+static JSON dbParseJson(const String & dbfile)
+{
+    Handle hFile = CreateFileW(StringUtils::Utf8ToUtf16(dbfile).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+    if(!hFile)
     {
         dputs("\nFailed to read database file!");
-        return;
+        return nullptr;
     }
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(hFile, &fileSize) || !fileSize.QuadPart || fileSize.QuadPart > 0x7FFFFFFF)
+    {
+        dputs("\nInvalid database file!");
+        return nullptr;
+    }
+    Handle hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const char* view = hMapping ? (const char*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if(!view)
+    {
+        dputs("\nFailed to read database file!");
+        return nullptr;
+    }
+    size_t size = size_t(fileSize.QuadPart);
+
+    // Plain text databases start with the root object and are parsed straight from the view
+    size_t start = 0;
+    while(start < size && isspace((unsigned char)view[start]))
+        start++;
+    std::vector<char> text;
+    bool valid = true;
+    if(start == size || view[start] != '{')
+    {
+        // LZ4 can expand at most 255 times, so larger sizes mean this is no archive
+        int uncompressedSize = 0;
+        if(size > sizeof(uncompressedSize))
+            memcpy(&uncompressedSize, view, sizeof(uncompressedSize));
+        int compressedSize = int(size - sizeof(uncompressedSize));
+        valid = uncompressedSize > 0 && uncompressedSize / 255 <= compressedSize;
+        if(valid)
+        {
+            text.resize(uncompressedSize);
+            valid = LZ4_decompress_safe(view + sizeof(uncompressedSize), text.data(), compressedSize, uncompressedSize) == uncompressedSize;
+        }
+    }
+    JSON root = nullptr;
+    if(valid)
+        root = text.empty() ? json_loadb(view, size, 0, nullptr) : json_loadb(text.data(), text.size(), 0, nullptr);
+    UnmapViewOfFile(view);
 
-    // Restore the old, compressed file
-    if(lzmaStatus != LZ4_INVALID_ARCHIVE && useCompression)
-        LZ4_compress_fileW(databasePathW.c_str(), databasePathW.c_str());
+    if(!valid)
+    {
+        dputs("\nInvalid database file!");
+        return nullptr;
+    }
+    if(!root)
+        dputs("\nInvalid database file (JSON)!");
+    return root;
+}
 
+static void dbLoadJson(const String & dbfile, DbLoadSaveType loadType)
+{
     // Deserialize JSON and validate
-    JSON root = json_loads(databaseText.c_str(), 0, 0);
-
+    JSON root = dbParseJson(dbfile);
     if(!root)
-    {
-        dputs("\nInvalid database file (JSON)!");
         return;
-    }
 
     // Load only command line
     if(loadType == DbLoadSaveType::CommandLine || loadType == DbLoadSaveType::All)
@@ -163,25 +398,126 @@ void DbLoad(DbLoadSaveType loadType)
         FunctionCacheLoad(root);
         LoopCacheLoad(root);
         XrefCacheLoad(root);
-        TraceRecord.loadFromDb(root);
+        TraceRecord.loadFromDb(root, dbfile);
         BpCacheLoad(root);
 
 
         // Load notes
         const char* text = json_string_value(json_object_get(root, "notes"));
         GuiSetDebuggeeNotes(text);
+        if(dbfile == dbpath)
+            dbSavedNotes = text ? text : "";
     }
 
     // Free root
     json_decref(root);
+}
+
+/**
+\brief Loads the program database, the format (binary or legacy JSON) is detected from the file.
+\param loadType What to load.
+\param dbfile The file to load from, nullptr for the current program database.
+*/
+void DbLoad(DbLoadSaveType loadType, const char* dbfile)
+{
+    EXCLUSIVE_ACQUIRE(LockDatabase);
+
+    String file = dbfile ? dbfile : dbpath;
+
+    // If the file doesn't exist, there is no DB to load
+    if(!FileExists(file.c_str()))
+        return;
+
+    if(loadType == DbLoadSaveType::CommandLine)
+        dputs("Loading commandline...");
+    else
+        dprintf("Loading database...");
+    DWORD ticks = GetTickCount();
+
+    if(DbFileReader::IsDbFile(file))
+        dbLoadBinary(file, loadType);
+    else
+        dbLoadJson(file, loadType);
+
+    // What was just loaded does not have to be autosaved
+    if(!dbfile)
+    {
+        size_t first, end;
+        dbSectionRange(loadType, first, end);
+        for(size_t i = first; i < end; i++)
+            dbSavedGenerations[i] = dbCachedSections[i].generation();
+        if(loadType != DbLoadSaveType::CommandLine)
+            dbSavedTraceGeneration = TraceRecord.getGeneration();
+    }
 
     if(loadType != DbLoadSaveType::CommandLine)
         dprintf("%ums\n", GetTickCount() - ticks);
 }
 
+static DWORD WINAPI dbAutosaveThread(void* param)
+{
+    DWORD interval = DWORD(duint(param));
+    while(WaitForSingleObject(hDbAutosaveStop, interval) == WAIT_TIMEOUT)
+    {
+        // The notes come from the GUI thread, get them before taking the lock
+        char* notes = nullptr;
+        GuiGetDebuggeeNotes(&notes);
+        {
+            EXCLUSIVE_ACQUIRE(LockDatabase);
+            if(*dbpath && dbIsDirty(notes) && !dbSaveBinary(dbpath, DbLoadSaveType::All, !settingboolget("Engine", "DisableDatabaseCompression"), notes))
+                dputs("Failed to autosave the database!");
+        }
+        if(notes)
+            BridgeFree(notes);
+    }
+    return 0;
+}
+
+/**
+\brief Starts saving the modified program database in the background every Engine\DatabaseAutosaveInterval
+       seconds (disabled when 0). Only the modified sections are serialized again, on the autosave thread.
+*/
+void DbAutosaveStart()
+{
+    DbAutosaveStop();
+    duint interval = 0;
+    if(!BridgeSettingGetUint("Engine", "DatabaseAutosaveInterval", &interval) || !interval)
+        return;
+    interval = min(interval, duint(24 * 60 * 60));
+    hDbAutosaveStop = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    hDbAutosaveThread = CreateThread(nullptr, 0, dbAutosaveThread, (void*)(interval * 1000), 0, nullptr);
+}
+
+void DbAutosaveStop()
+{
+    if(hDbAutosaveThread)
+    {
+        SetEvent(hDbAutosaveStop);
+        WaitForSingleObject(hDbAutosaveThread, INFINITE);
+        CloseHandle(hDbAutosaveThread);
+        hDbAutosaveThread = nullptr;
+    }
+    if(hDbAutosaveStop)
+    {
+        CloseHandle(hDbAutosaveStop);
+        hDbAutosaveStop = nullptr;
+    }
+}
+
 void DbClose()
 {
+    DbAutosaveStop();
     DbSave(DbLoadSaveType::All);
+    {
+        // Drop the serialized chunks of this debuggee
+        EXCLUSIVE_ACQUIRE(LockDatabase);
+        dbBackedUp = false;
+        for(auto & cache : dbChunkCache)
+        {
+            cache.generation = 0;
+            std::vector<unsigned char>().swap(cache.data);
+        }
+    }
     CommentClear();
     LabelClear();
     BookmarkClear();
@@ -193,6 +529,15 @@ void DbClose()
     GuiSetDebuggeeNotes("");
 }
 
+/**
+\brief Gets the path of the database file of the debuggee (empty when no database path is set).
+*/
+String DbGetPath()
+{
+    SHARED_ACQUIRE(LockDatabase);
+    return dbpath;
+}
+
 void DbSetPath(const char* Directory, const char* ModulePath)
 {
     EXCLUSIVE_ACQUIRE(LockDatabase);
@@ -10,9 +10,12 @@ enum class DbLoadSaveType
     All
 };
 
-void DbSave(DbLoadSaveType saveType);
-void DbLoad(DbLoadSaveType loadType);
+void DbSave(DbLoadSaveType saveType, const char* dbfile = nullptr, bool json = false);
+void DbLoad(DbLoadSaveType loadType, const char* dbfile = nullptr);
 void DbClose();
+void DbAutosaveStart();
+void DbAutosaveStop();
 void DbSetPath(const char* Directory, const char* ModulePath);
+String DbGetPath();
 
 #endif // _DATABASE_H
\ No newline at end of file
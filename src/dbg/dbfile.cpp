@@ -0,0 +1,457 @@
+/**
+@file dbfile.cpp
+
+@brief Implements the sectioned binary program database file.
+*/
+
+#include "dbfile.h"
+#include "lz4\lz4.h"
+
+// Records are collected up to this size before a block is compressed and written
+static const size_t DbFileBlockSize = 1024 * 1024;
+
+DbFileWriter::DbFileWriter(bool compress)
+    : mMemory(false),
+      mCompress(compress),
+      mFailed(false),
+      mRecordCount(0),
+      mRecordStart(0),
+      mBlockCount(0)
+{
+    memset(mChunk, 0, sizeof(mChunk));
+}
+
+DbFileWriter::~DbFileWriter()
+{
+    Close();
+}
+
+bool DbFileWriter::Open(const String & fileName)
+{
+    mFile = CreateFileW(StringUtils::Utf8ToUtf16(fileName).c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(!mFile)
+        return false;
+    mMemory = false;
+    mFailed = false;
+    mBlockCount = 0;
+    DbFileHeader header;
+    memcpy(header.magic, DB_FILE_MAGIC, sizeof(header.magic));
+    header.version = DB_FILE_VERSION;
+    writeOutput(&header, sizeof(header));
+    return !mFailed;
+}
+
+/**
+\brief Writes the blocks to memory instead of a file (without file header), so a chunk can be
+       serialized once and copied into several files with PutChunkData.
+*/
+void DbFileWriter::OpenMemory()
+{
+    mMemory = true;
+    mFailed = false;
+    mBlockCount = 0;
+    mOutput.clear();
+}
+
+/**
+\brief Flushes the pending block and closes the file.
+\return false if any write failed since Open.
+*/
+bool DbFileWriter::Close()
+{
+    if(mMemory)
+    {
+        flushBlock();
+        mMemory = false;
+        return !mFailed;
+    }
+    if(!mFile)
+        return false;
+    flushBlock();
+    mFile.Close();
+    return !mFailed;
+}
+
+/**
+\brief Moves the blocks written since OpenMemory into data, call after Close.
+*/
+void DbFileWriter::TakeMemory(std::vector<unsigned char> & data)
+{
+    data.swap(mOutput);
+    mOutput.clear();
+}
+
+/**
+\brief Appends blocks that were written by a memory writer.
+*/
+void DbFileWriter::PutChunkData(const std::vector<unsigned char> & data)
+{
+    flushBlock();
+    if(data.empty())
+        return;
+    writeOutput(data.data(), data.size());
+    mBlockCount++;
+}
+
+bool DbFileWriter::IsEmpty() const
+{
+    return !mBlockCount && !mRecordCount;
+}
+
+void DbFileWriter::BeginChunk(const char* name)
+{
+    flushBlock();
+    strncpy_s(mChunk, name, _TRUNCATE);
+}
+
+void DbFileWriter::EndChunk()
+{
+    flushBlock();
+}
+
+void DbFileWriter::BeginRecord()
+{
+    mRecordStart = mBlock.size();
+    mBlock.resize(mRecordStart + sizeof(unsigned int));
+}
+
+void DbFileWriter::EndRecord()
+{
+    unsigned int size = (unsigned int)(mBlock.size() - mRecordStart - sizeof(unsigned int));
+    memcpy(mBlock.data() + mRecordStart, &size, sizeof(size));
+    mRecordCount++;
+    if(mBlock.size() >= DbFileBlockSize)
+        flushBlock();
+}
+
+void DbFileWriter::CancelRecord()
+{
+    mBlock.resize(mRecordStart);
+}
+
+void DbFileWriter::PutHex(const char* key, duint value)
+{
+    unsigned long long data = value;
+    putField(DbFieldHex, key, &data, sizeof(data));
+}
+
+void DbFileWriter::PutInt(const char* key, long long value)
+{
+    putField(DbFieldInt, key, &value, sizeof(value));
+}
+
+void DbFileWriter::PutBool(const char* key, bool value)
+{
+    unsigned char data = value ? 1 : 0;
+    putField(DbFieldBool, key, &data, sizeof(data));
+}
+
+void DbFileWriter::PutString(const char* key, const char* value)
+{
+    if(!value)
+        value = "";
+    putField(DbFieldString, key, value, strlen(value) + 1);
+}
+
+void DbFileWriter::PutBlob(const char* key, const void* data, size_t size)
+{
+    putField(DbFieldBlob, key, data, size);
+}
+
+void DbFileWriter::putField(DbFieldType type, const char* key, const void* data, size_t size)
+{
+    size_t keyLength = min(strlen(key), size_t(0xFF));
+    bool prefixed = type == DbFieldString || type == DbFieldBlob;
+    size_t offset = mBlock.size();
+    mBlock.resize(offset + 2 + keyLength + (prefixed ? sizeof(unsigned int) : 0) + size);
+    unsigned char* ptr = mBlock.data() + offset;
+    *ptr++ = type;
+    *ptr++ = (unsigned char)keyLength;
+    memcpy(ptr, key, keyLength);
+    ptr += keyLength;
+    if(prefixed)
+    {
+        unsigned int length = (unsigned int)size;
+        memcpy(ptr, &length, sizeof(length));
+        ptr += sizeof(length);
+    }
+    if(size)
+        memcpy(ptr, data, size);
+}
+
+void DbFileWriter::flushBlock()
+{
+    if(!mRecordCount)
+    {
+        mBlock.clear();
+        return;
+    }
+    DbFileBlock block;
+    memcpy(block.chunk, mChunk, sizeof(block.chunk));
+    block.recordCount = mRecordCount;
+    block.rawSize = (unsigned int)mBlock.size();
+    block.storedSize = block.rawSize;
+    const void* data = mBlock.data();
+    if(mCompress)
+    {
+        mCompressed.resize(LZ4_compressBound(int(mBlock.size())));
+        int compressedSize = LZ4_compress((const char*)mBlock.data(), mCompressed.data(), int(mBlock.size()));
+        if(compressedSize > 0 && (unsigned int)compressedSize < block.rawSize)
+        {
+            block.storedSize = compressedSize;
+            data = mCompressed.data();
+        }
+    }
+    writeOutput(&block, sizeof(block));
+    writeOutput(data, block.storedSize);
+    mBlock.clear();
+    mRecordCount = 0;
+    mBlockCount++;
+}
+
+void DbFileWriter::writeOutput(const void* data, size_t size)
+{
+    if(mMemory)
+    {
+        mOutput.insert(mOutput.end(), (const unsigned char*)data, (const unsigned char*)data + size);
+        return;
+    }
+    DWORD written = 0;
+    if(mFailed || !WriteFile(mFile, data, DWORD(size), &written, nullptr) || written != size)
+        mFailed = true;
+}
+
+DbRecord::DbRecord(const unsigned char* data, size_t size)
+    : mData(data),
+      mSize(size)
+{
+}
+
+bool DbRecord::GetHex(const char* key, duint & value) const
+{
+    const unsigned char* data;
+    size_t size;
+    if(!findField(DbFieldHex, key, data, size))
+        return false;
+    unsigned long long hex;
+    memcpy(&hex, data, sizeof(hex));
+    value = duint(hex);
+    return true;
+}
+
+bool DbRecord::GetInt(const char* key, long long & value) const
+{
+    const unsigned char* data;
+    size_t size;
+    if(!findField(DbFieldInt, key, data, size))
+        return false;
+    memcpy(&value, data, sizeof(value));
+    return true;
+}
+
+bool DbRecord::GetBool(const char* key, bool & value) const
+{
+    const unsigned char* data;
+    size_t size;
+    if(!findField(DbFieldBool, key, data, size))
+        return false;
+    value = *data != 0;
+    return true;
+}
+
+/**
+\brief Gets a string field. The returned pointer points into the record, copy it before the record callback returns.
+*/
+bool DbRecord::GetString(const char* key, const char* & value) const
+{
+    const unsigned char* data;
+    size_t size;
+    if(!findField(DbFieldString, key, data, size) || !size || data[size - 1] != '\0')
+        return false;
+    value = (const char*)data;
+    return true;
+}
+
+bool DbRecord::GetBlob(const char* key, const void* & data, size_t & size) const
+{
+    const unsigned char* value;
+    if(!findField(DbFieldBlob, key, value, size))
+        return false;
+    data = value;
+    return true;
+}
+
+bool DbRecord::findField(DbFieldType type, const char* key, const unsigned char* & value, size_t & size) const
+{
+    size_t keyLength = strlen(key);
+    const unsigned char* ptr = mData;
+    const unsigned char* end = mData + mSize;
+    while(size_t(end - ptr) >= 2)
+    {
+        DbFieldType fieldType = DbFieldType(ptr[0]);
+        size_t fieldKeyLength = ptr[1];
+        const unsigned char* fieldKey = ptr + 2;
+        ptr += 2 + fieldKeyLength;
+        if(ptr > end)
+            return false;
+        size_t fieldSize;
+        switch(fieldType)
+        {
+        case DbFieldHex:
+        case DbFieldInt:
+            fieldSize = sizeof(unsigned long long);
+            break;
+        case DbFieldBool:
+            fieldSize = sizeof(unsigned char);
+            break;
+        case DbFieldString:
+        case DbFieldBlob:
+        {
+            unsigned int length;
+            if(size_t(end - ptr) < sizeof(length))
+                return false;
+            memcpy(&length, ptr, sizeof(length));
+            ptr += sizeof(length);
+            fieldSize = length;
+        }
+        break;
+        default:
+            return false;
+        }
+        if(size_t(end - ptr) < fieldSize)
+            return false;
+        if(fieldType == type && fieldKeyLength == keyLength && memcmp(fieldKey, key, keyLength) == 0)
+        {
+            value = ptr;
+            size = fieldSize;
+            return true;
+        }
+        ptr += fieldSize;
+    }
+    return false;
+}
+
+DbFileReader::DbFileReader()
+    : mView(nullptr)
+{
+}
+
+DbFileReader::~DbFileReader()
+{
+    Close();
+}
+
+bool DbFileReader::IsDbFile(const String & fileName)
+{
+    Handle hFile = CreateFileW(StringUtils::Utf8ToUtf16(fileName).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+    if(!hFile)
+        return false;
+    DbFileHeader header;
+    DWORD read = 0;
+    return ReadFile(hFile, &header, sizeof(header), &read, nullptr) && read == sizeof(header) && memcmp(header.magic, DB_FILE_MAGIC, sizeof(header.magic)) == 0;
+}
+
+/**
+\brief Maps the file and indexes its blocks. Uncompressed blocks are read straight from the view.
+*/
+bool DbFileReader::Open(const String & fileName)
+{
+    Close();
+    Handle hFile = CreateFileW(StringUtils::Utf8ToUtf16(fileName).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+    if(!hFile)
+        return false;
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart < LONGLONG(sizeof(DbFileHeader)) || fileSize.QuadPart > 0x7FFFFFFF)
+        return false;
+    Handle hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(!hMapping)
+        return false;
+    mView = (const unsigned char*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    if(!mView)
+        return false;
+
+    const unsigned char* ptr = mView;
+    const unsigned char* end = mView + size_t(fileSize.QuadPart);
+    DbFileHeader header;
+    memcpy(&header, ptr, sizeof(header));
+    ptr += sizeof(header);
+    if(memcmp(header.magic, DB_FILE_MAGIC, sizeof(header.magic)) != 0 || header.version != DB_FILE_VERSION)
+    {
+        Close();
+        return false;
+    }
+    while(ptr != end)
+    {
+        Block block;
+        if(size_t(end - ptr) < sizeof(block.header))
+        {
+            Close();
+            return false;
+        }
+        memcpy(&block.header, ptr, sizeof(block.header));
+        block.header.chunk[DB_CHUNK_NAME_SIZE - 1] = '\0';
+        ptr += sizeof(block.header);
+        if(size_t(end - ptr) < block.header.storedSize || block.header.storedSize > block.header.rawSize)
+        {
+            Close();
+            return false;
+        }
+        block.data = ptr;
+        ptr += block.header.storedSize;
+        mBlocks.push_back(block);
+    }
+    return true;
+}
+
+void DbFileReader::Close()
+{
+    if(mView)
+        UnmapViewOfFile(mView);
+    mView = nullptr;
+    mBlocks.clear();
+}
+
+bool DbFileReader::HasChunk(const char* name) const
+{
+    for(const auto & block : mBlocks)
+        if(strcmp(block.header.chunk, name) == 0)
+            return true;
+    return false;
+}
+
+/**
+\brief Calls cbRecord for every record in the chunk, stops when it returns false.
+\return false if the chunk is corrupted.
+*/
+bool DbFileReader::EnumRecords(const char* name, const CBRECORD & cbRecord) const
+{
+    for(const auto & block : mBlocks)
+    {
+        if(strcmp(block.header.chunk, name) != 0)
+            continue;
+        const unsigned char* data = block.data;
+        if(block.header.storedSize != block.header.rawSize)
+        {
+            mDecompressed.resize(block.header.rawSize);
+            if(LZ4_decompress_safe((const char*)block.data, (char*)mDecompressed.data(), int(block.header.storedSize), int(block.header.rawSize)) != int(block.header.rawSize))
+                return false;
+            data = mDecompressed.data();
+        }
+        const unsigned char* ptr = data;
+        const unsigned char* end = data + block.header.rawSize;
+        for(unsigned int i = 0; i < block.header.recordCount; i++)
+        {
+            unsigned int size;
+            if(size_t(end - ptr) < sizeof(size))
+                return false;
+            memcpy(&size, ptr, sizeof(size));
+            ptr += sizeof(size);
+            if(size_t(end - ptr) < size)
+                return false;
+            if(!cbRecord(DbRecord(ptr, size)))
+                return true;
+            ptr += size;
+        }
+    }
+    return true;
+}
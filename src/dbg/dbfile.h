@@ -0,0 +1,143 @@
+#ifndef _DBFILE_H
+#define _DBFILE_H
+
+#include "_global.h"
+#include "handle.h"
+
+/*
+Binary program database layout:
+
+    DbFileHeader
+    DbFileBlock, block data
+    DbFileBlock, block data
+    ...
+
+Every subsystem writes one named chunk, which is stored as one or more blocks of at
+most DbFileBlockSize bytes of records. Blocks are LZ4 compressed when that makes them
+smaller. A record is a 32-bit length followed by its fields, a field is a type byte,
+a key (length byte + characters) and a value:
+
+    DbFieldHex/DbFieldInt: 64-bit value
+    DbFieldBool: 8-bit value
+    DbFieldString: 32-bit length (including the terminator) + characters + '\0'
+    DbFieldBlob: 32-bit length + data
+*/
+
+#define DB_FILE_MAGIC "x64dbgdb"
+#define DB_FILE_VERSION 1
+#define DB_CHUNK_NAME_SIZE 16
+
+#pragma pack(push, 1)
+struct DbFileHeader
+{
+    char magic[8];
+    unsigned int version;
+};
+
+struct DbFileBlock
+{
+    char chunk[DB_CHUNK_NAME_SIZE];
+    unsigned int recordCount;
+    unsigned int rawSize;
+    unsigned int storedSize; //equal to rawSize when the block is not compressed
+};
+#pragma pack(pop)
+
+enum DbFieldType : unsigned char
+{
+    DbFieldHex = 1,
+    DbFieldInt,
+    DbFieldBool,
+    DbFieldString,
+    DbFieldBlob
+};
+
+class DbFileWriter
+{
+public:
+    explicit DbFileWriter(bool compress);
+    ~DbFileWriter();
+
+    bool Open(const String & fileName);
+    void OpenMemory();
+    bool Close();
+    bool IsEmpty() const;
+    void TakeMemory(std::vector<unsigned char> & data);
+    void PutChunkData(const std::vector<unsigned char> & data);
+
+    void BeginChunk(const char* name);
+    void EndChunk();
+    void BeginRecord();
+    void EndRecord();
+    void CancelRecord();
+
+    void PutHex(const char* key, duint value);
+    void PutInt(const char* key, long long value);
+    void PutBool(const char* key, bool value);
+    void PutString(const char* key, const char* value);
+    void PutBlob(const char* key, const void* data, size_t size);
+
+private:
+    void putField(DbFieldType type, const char* key, const void* data, size_t size);
+    void flushBlock();
+    void writeOutput(const void* data, size_t size);
+
+    Handle mFile;
+    bool mMemory;
+    std::vector<unsigned char> mOutput;
+    bool mCompress;
+    bool mFailed;
+    char mChunk[DB_CHUNK_NAME_SIZE];
+    std::vector<unsigned char> mBlock;
+    std::vector<char> mCompressed;
+    unsigned int mRecordCount;
+    size_t mRecordStart;
+    size_t mBlockCount;
+};
+
+class DbRecord
+{
+public:
+    DbRecord(const unsigned char* data, size_t size);
+
+    bool GetHex(const char* key, duint & value) const;
+    bool GetInt(const char* key, long long & value) const;
+    bool GetBool(const char* key, bool & value) const;
+    bool GetString(const char* key, const char* & value) const;
+    bool GetBlob(const char* key, const void* & data, size_t & size) const;
+
+private:
+    bool findField(DbFieldType type, const char* key, const unsigned char* & value, size_t & size) const;
+
+    const unsigned char* mData;
+    size_t mSize;
+};
+
+class DbFileReader
+{
+public:
+    typedef std::function<bool(const DbRecord & record)> CBRECORD;
+
+    DbFileReader();
+    ~DbFileReader();
+
+    static bool IsDbFile(const String & fileName);
+
+    bool Open(const String & fileName);
+    void Close();
+    bool HasChunk(const char* name) const;
+    bool EnumRecords(const char* name, const CBRECORD & cbRecord) const;
+
+private:
+    struct Block
+    {
+        DbFileBlock header;
+        const unsigned char* data;
+    };
+
+    const unsigned char* mView;
+    std::vector<Block> mBlocks;
+    mutable std::vector<unsigned char> mDecompressed;
+};
+
+#endif //_DBFILE_H
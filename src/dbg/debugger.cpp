@@ -24,6 +24,8 @@
 #include "stackinfo.h"
 #include "stringformat.h"
 #include "TraceRecord.h"
+#include "latestworker.h"
+#include "settinghandle.h"
 
 static PROCESS_INFORMATION g_pi = {0, 0, 0, 0};
 static char szBaseFileName[MAX_PATH] = "";
@@ -47,7 +49,21 @@ static bool bStopMemMapThread = false;
 static HANDLE hTimeWastedCounterThread = 0;
 static bool bStopTimeWastedCounterThread = false;
 static String lastDebugText;
+static std::unordered_map<String, StringFormatTemplate> logTemplates; //breakpoint log text -> compiled template
+static String logBuffer;
 static duint timeWastedDebugging = 0;
+// The event settings are read on every debug event
+static SettingHandle settingEventTlsCallbacks("Events", "TlsCallbacks");
+static SettingHandle settingEventEntryBreakpoint("Events", "EntryBreakpoint");
+static SettingHandle settingEventThreadEntry("Events", "ThreadEntry");
+static SettingHandle settingEventThreadStart("Events", "ThreadStart");
+static SettingHandle settingEventThreadEnd("Events", "ThreadEnd");
+static SettingHandle settingEventAttachBreakpoint("Events", "AttachBreakpoint");
+static SettingHandle settingEventSystemBreakpoint("Events", "SystemBreakpoint");
+static SettingHandle settingEventDllEntry("Events", "DllEntry");
+static SettingHandle settingEventDllLoad("Events", "DllLoad");
+static SettingHandle settingEventDllUnload("Events", "DllUnload");
+static SettingHandle settingEventDebugStrings("Events", "DebugStrings");
 char szFileName[MAX_PATH] = "";
 char szSymbolCachePath[MAX_PATH] = "";
 char sqlitedb[deflen] = "";
@@ -57,6 +73,11 @@ HANDLE hProcessToken;
 bool bUndecorateSymbolNames = true;
 bool bEnableSourceDebugging = true;
 
+static void updateCallStackAndSEHChain(unsigned int generation);
+
+// Updates the call stack and SEH chain off the debug thread, a newer stop supersedes older ones
+static LatestRequestWorker stackWorker(updateCallStackAndSEHChain);
+
 static DWORD WINAPI memMapThread(void* ptr)
 {
     while(!bStopMemMapThread)
@@ -121,6 +142,7 @@ void dbgstop()
     bStopTimeWastedCounterThread = true;
     WaitForThreadTermination(hMemMapThread);
     WaitForThreadTermination(hTimeWastedCounterThread);
+    stackWorker.Stop();
 }
 
 duint dbgdebuggedbase()
@@ -211,18 +233,20 @@ bool dbgcmddel(const char* name)
     return true;
 }
 
-DWORD WINAPI updateCallStackThread(void* ptr)
+static void updateCallStackAndSEHChain(unsigned int generation)
 {
+    // The GUI walks the call stack when it gets the message, only the SEH walk below can be cancelled
     GuiUpdateCallStack();
-    return 0;
-}
-
-DWORD WINAPI updateSEHChainThread(void* ptr)
-{
+    if(stackWorker.IsStale(generation))
+        return;
     GuiUpdateSEHChain();
-    stackupdateseh();
+    auto cancelled = [generation]()
+    {
+        return stackWorker.IsStale(generation);
+    };
+    if(!stackupdateseh(cancelled))
+        return;
     GuiUpdateDumpView();
-    return 0;
 }
 
 void DebugUpdateGui(duint disasm_addr, bool stack)
@@ -248,8 +272,7 @@ void DebugUpdateGui(duint disasm_addr, bool stack)
     if(csp != cacheCsp)
     {
         cacheCsp = csp;
-        CloseHandle(CreateThread(0, 0, updateCallStackThread, 0, 0, 0));
-        CloseHandle(CreateThread(0, 0, updateSEHChainThread, 0, 0, 0));
+        stackWorker.Request();
     }
     char modname[MAX_MODULE_SIZE] = "";
     char modtext[MAX_MODULE_SIZE * 2] = "";
@@ -260,6 +283,7 @@ void DebugUpdateGui(duint disasm_addr, bool stack)
     char title[1024] = "";
     sprintf(title, "File: %s - PID: %X - %sThread: %X", szBaseFileName, fdProcessInfo->dwProcessId, modtext, ThreadGetId(hActiveThread));
     GuiUpdateWindowTitle(title);
+    ThreadInvalidateSnapshot();
     GuiUpdateAllViews();
     GuiFocusView(GUI_DISASSEMBLY);
 }
@@ -510,19 +534,32 @@ static void cbGenericBreakpoint(BP_TYPE bptype, void* ExceptionAddress = nullptr
         pauseInfo.reserved = nullptr;
         plugincbcall(CB_PAUSEDEBUG, &pauseInfo);
     }
-    PLUG_CB_BREAKPOINT bpInfo;
-    BRIDGEBP bridgebp;
-    memset(&bridgebp, 0, sizeof(bridgebp));
-    bpInfo.breakpoint = &bridgebp;
-    BpToBridge(&bp, &bridgebp);
-    plugincbcall(CB_BREAKPOINT, &bpInfo);
+    if(pluginhascallbacks(CB_BREAKPOINT))
+    {
+        PLUG_CB_BREAKPOINT bpInfo;
+        BRIDGEBP bridgebp;
+        memset(&bridgebp, 0, sizeof(bridgebp));
+        bpInfo.breakpoint = &bridgebp;
+        BpToBridge(&bp, &bridgebp);
+        plugincbcall(CB_BREAKPOINT, &bpInfo);
+    }
 
     // Trace record
     _dbg_dbgtraceexecute(CIP);
 
     if(*bp.logText && logCondition)  //log
     {
-        dprintf("%s\n", stringformatinline(bp.logText).c_str());
+        //only accessed from the debug loop thread
+        auto found = logTemplates.find(bp.logText);
+        if(found == logTemplates.end())
+        {
+            if(logTemplates.size() >= 1024)
+                logTemplates.clear();
+            found = logTemplates.insert(std::make_pair(String(bp.logText), StringFormatTemplate(bp.logText))).first;
+        }
+        logBuffer.clear();
+        found->second.Format(logBuffer);
+        dprintf("%s\n", logBuffer.c_str());
     }
     if(*bp.commandText && commandCondition)  //command
     {
@@ -791,6 +828,7 @@ static void cbCreateProcess(CREATE_PROCESS_DEBUG_INFO* CreateProcessInfo)
 
     // Init program database
     DbLoad(DbLoadSaveType::DebugData);
+    DbAutosaveStart();
 
     SafeSymSetOptions(SYMOPT_DEBUG | SYMOPT_LOAD_LINES | SYMOPT_ALLOW_ABSOLUTE_SYMBOLS | SYMOPT_FAVOR_COMPRESSED | SYMOPT_IGNORE_NT_SYMPATH);
     GuiSymbolLogClear();
@@ -805,6 +843,7 @@ static void cbCreateProcess(CREATE_PROCESS_DEBUG_INFO* CreateProcessInfo)
     modInfo.SizeOfStruct = sizeof(modInfo);
     if(SafeSymGetModuleInfoW64(fdProcessInfo->hProcess, (DWORD64)base, &modInfo))
         ModLoad((duint)base, modInfo.ImageSize, StringUtils::Utf16ToUtf8(modInfo.ImageName).c_str());
+    TraceRecord.mapModule((duint)base);
 
     char modname[256] = "";
     if(ModNameFromAddr((duint)base, modname, true))
@@ -817,7 +856,7 @@ static void cbCreateProcess(CREATE_PROCESS_DEBUG_INFO* CreateProcessInfo)
         pDebuggedBase = pCreateProcessBase; //debugged base = executable
         char command[256] = "";
 
-        if(settingboolget("Events", "TlsCallbacks"))
+        if(settingEventTlsCallbacks.GetBool())
         {
             DWORD NumberOfCallBacks = 0;
             TLSGrabCallBackDataW(StringUtils::Utf8ToUtf16(DebugFileName).c_str(), 0, &NumberOfCallBacks);
@@ -848,7 +887,7 @@ static void cbCreateProcess(CREATE_PROCESS_DEBUG_INFO* CreateProcessInfo)
             }
         }
 
-        if(settingboolget("Events", "EntryBreakpoint"))
+        if(settingEventEntryBreakpoint.GetBool())
         {
             sprintf(command, "bp " fhex ",\"entry breakpoint\",ss", (duint)CreateProcessInfo->lpStartAddress);
             cmddirectexec(command);
@@ -914,7 +953,7 @@ static void cbCreateThread(CREATE_THREAD_DEBUG_INFO* CreateThread)
     DWORD dwThreadId = ((DEBUG_EVENT*)GetDebugData())->dwThreadId;
     hActiveThread = ThreadGetHandle(dwThreadId);
 
-    if(settingboolget("Events", "ThreadEntry"))
+    if(settingEventThreadEntry.GetBool())
     {
         char command[256] = "";
         sprintf(command, "bp " fhex ",\"Thread %X\",ss", (duint)CreateThread->lpStartAddress, dwThreadId);
@@ -928,7 +967,7 @@ static void cbCreateThread(CREATE_THREAD_DEBUG_INFO* CreateThread)
 
     dprintf("Thread %X created, Entry: " fhex "\n", dwThreadId, CreateThread->lpStartAddress);
 
-    if(settingboolget("Events", "ThreadStart"))
+    if(settingEventThreadStart.GetBool())
     {
         //update memory map
         MemUpdateMap();
@@ -958,7 +997,7 @@ static void cbExitThread(EXIT_THREAD_DEBUG_INFO* ExitThread)
     ThreadExit(dwThreadId);
     dprintf("Thread %X exit\n", dwThreadId);
 
-    if(settingboolget("Events", "ThreadEnd"))
+    if(settingEventThreadEnd.GetBool())
     {
         //update GUI
         GuiSetDebugState(paused);
@@ -995,7 +1034,7 @@ static void cbSystemBreakpoint(void* ExceptionData)
     callbackInfo.reserved = 0;
     plugincbcall(CB_SYSTEMBREAKPOINT, &callbackInfo);
 
-    if(bIsAttached ? settingboolget("Events", "AttachBreakpoint") : settingboolget("Events", "SystemBreakpoint"))
+    if(bIsAttached ? settingEventAttachBreakpoint.GetBool() : settingEventSystemBreakpoint.GetBool())
     {
         //lock
         GuiSetDebugState(paused);
@@ -1023,6 +1062,7 @@ static void cbLoadDll(LOAD_DLL_DEBUG_INFO* LoadDll)
     modInfo.SizeOfStruct = sizeof(modInfo);
     if(SafeSymGetModuleInfoW64(fdProcessInfo->hProcess, (DWORD64)base, &modInfo))
         ModLoad((duint)base, modInfo.ImageSize, StringUtils::Utf16ToUtf8(modInfo.ImageName).c_str());
+    TraceRecord.mapModule((duint)base);
 
     // Update memory map
     MemUpdateMapAsync();
@@ -1039,7 +1079,7 @@ static void cbLoadDll(LOAD_DLL_DEBUG_INFO* LoadDll)
     {
         bIsDebuggingThis = true;
         pDebuggedBase = (duint)base;
-        if(settingboolget("Events", "EntryBreakpoint"))
+        if(settingEventEntryBreakpoint.GetBool())
         {
             bAlreadySetEntry = true;
             sprintf(command, "bp " fhex ",\"entry breakpoint\",ss", pDebuggedBase + pDebuggedEntry);
@@ -1048,7 +1088,7 @@ static void cbLoadDll(LOAD_DLL_DEBUG_INFO* LoadDll)
     }
     GuiUpdateBreakpointsView();
 
-    if(settingboolget("Events", "TlsCallbacks"))
+    if(settingEventTlsCallbacks.GetBool())
     {
         DWORD NumberOfCallBacks = 0;
         TLSGrabCallBackDataW(StringUtils::Utf8ToUtf16(DLLDebugFileName).c_str(), 0, &NumberOfCallBacks);
@@ -1082,7 +1122,7 @@ static void cbLoadDll(LOAD_DLL_DEBUG_INFO* LoadDll)
         }
     }
 
-    if((bBreakOnNextDll || settingboolget("Events", "DllEntry")) && !bAlreadySetEntry)
+    if((bBreakOnNextDll || settingEventDllEntry.GetBool()) && !bAlreadySetEntry)
     {
         duint oep = GetPE32DataW(StringUtils::Utf8ToUtf16(DLLDebugFileName).c_str(), 0, UE_OEP);
         if(oep)
@@ -1095,39 +1135,42 @@ static void cbLoadDll(LOAD_DLL_DEBUG_INFO* LoadDll)
 
     dprintf("DLL Loaded: " fhex " %s\n", base, DLLDebugFileName);
 
-    //plugin callback
-    PLUG_CB_LOADDLL callbackInfo;
-    callbackInfo.LoadDll = LoadDll;
-    IMAGEHLP_MODULE64 modInfoUtf8;
-    memset(&modInfoUtf8, 0, sizeof(modInfoUtf8));
-    modInfoUtf8.SizeOfStruct = sizeof(modInfoUtf8);
-    modInfoUtf8.BaseOfImage = modInfo.BaseOfImage;
-    modInfoUtf8.ImageSize = modInfo.ImageSize;
-    modInfoUtf8.TimeDateStamp = modInfo.TimeDateStamp;
-    modInfoUtf8.CheckSum = modInfo.CheckSum;
-    modInfoUtf8.NumSyms = modInfo.NumSyms;
-    modInfoUtf8.SymType = modInfo.SymType;
-    strcpy_s(modInfoUtf8.ModuleName, StringUtils::Utf16ToUtf8(modInfo.ModuleName).c_str());
-    strcpy_s(modInfoUtf8.ImageName, StringUtils::Utf16ToUtf8(modInfo.ImageName).c_str());
-    strcpy_s(modInfoUtf8.LoadedImageName, StringUtils::Utf16ToUtf8(modInfo.LoadedImageName).c_str());
-    strcpy_s(modInfoUtf8.LoadedPdbName, StringUtils::Utf16ToUtf8(modInfo.LoadedPdbName).c_str());
-    modInfoUtf8.CVSig = modInfo.CVSig;
-    strcpy_s(modInfoUtf8.CVData, StringUtils::Utf16ToUtf8(modInfo.CVData).c_str());
-    modInfoUtf8.PdbSig = modInfo.PdbSig;
-    modInfoUtf8.PdbSig70 = modInfo.PdbSig70;
-    modInfoUtf8.PdbAge = modInfo.PdbAge;
-    modInfoUtf8.PdbUnmatched = modInfo.PdbUnmatched;
-    modInfoUtf8.DbgUnmatched = modInfo.DbgUnmatched;
-    modInfoUtf8.LineNumbers = modInfo.LineNumbers;
-    modInfoUtf8.GlobalSymbols = modInfo.GlobalSymbols;
-    modInfoUtf8.TypeInfo = modInfo.TypeInfo;
-    modInfoUtf8.SourceIndexed = modInfo.SourceIndexed;
-    modInfoUtf8.Publics = modInfo.Publics;
-    callbackInfo.modInfo = &modInfoUtf8;
-    callbackInfo.modname = modname;
-    plugincbcall(CB_LOADDLL, &callbackInfo);
-
-    if(bBreakOnNextDll || settingboolget("Events", "DllLoad"))
+    //plugin callback, converting the module information is skipped when nobody listens
+    if(pluginhascallbacks(CB_LOADDLL))
+    {
+        PLUG_CB_LOADDLL callbackInfo;
+        callbackInfo.LoadDll = LoadDll;
+        IMAGEHLP_MODULE64 modInfoUtf8;
+        memset(&modInfoUtf8, 0, sizeof(modInfoUtf8));
+        modInfoUtf8.SizeOfStruct = sizeof(modInfoUtf8);
+        modInfoUtf8.BaseOfImage = modInfo.BaseOfImage;
+        modInfoUtf8.ImageSize = modInfo.ImageSize;
+        modInfoUtf8.TimeDateStamp = modInfo.TimeDateStamp;
+        modInfoUtf8.CheckSum = modInfo.CheckSum;
+        modInfoUtf8.NumSyms = modInfo.NumSyms;
+        modInfoUtf8.SymType = modInfo.SymType;
+        strcpy_s(modInfoUtf8.ModuleName, StringUtils::Utf16ToUtf8(modInfo.ModuleName).c_str());
+        strcpy_s(modInfoUtf8.ImageName, StringUtils::Utf16ToUtf8(modInfo.ImageName).c_str());
+        strcpy_s(modInfoUtf8.LoadedImageName, StringUtils::Utf16ToUtf8(modInfo.LoadedImageName).c_str());
+        strcpy_s(modInfoUtf8.LoadedPdbName, StringUtils::Utf16ToUtf8(modInfo.LoadedPdbName).c_str());
+        modInfoUtf8.CVSig = modInfo.CVSig;
+        strcpy_s(modInfoUtf8.CVData, StringUtils::Utf16ToUtf8(modInfo.CVData).c_str());
+        modInfoUtf8.PdbSig = modInfo.PdbSig;
+        modInfoUtf8.PdbSig70 = modInfo.PdbSig70;
+        modInfoUtf8.PdbAge = modInfo.PdbAge;
+        modInfoUtf8.PdbUnmatched = modInfo.PdbUnmatched;
+        modInfoUtf8.DbgUnmatched = modInfo.DbgUnmatched;
+        modInfoUtf8.LineNumbers = modInfo.LineNumbers;
+        modInfoUtf8.GlobalSymbols = modInfo.GlobalSymbols;
+        modInfoUtf8.TypeInfo = modInfo.TypeInfo;
+        modInfoUtf8.SourceIndexed = modInfo.SourceIndexed;
+        modInfoUtf8.Publics = modInfo.Publics;
+        callbackInfo.modInfo = &modInfoUtf8;
+        callbackInfo.modname = modname;
+        plugincbcall(CB_LOADDLL, &callbackInfo);
+    }
+
+    if(bBreakOnNextDll || settingEventDllLoad.GetBool())
     {
         bBreakOnNextDll = false;
         //update GUI
@@ -1158,7 +1201,7 @@ static void cbUnloadDll(UNLOAD_DLL_DEBUG_INFO* UnloadDll)
     SafeSymUnloadModule64(fdProcessInfo->hProcess, (DWORD64)base);
     dprintf("DLL Unloaded: " fhex " %s\n", base, modname);
 
-    if(bBreakOnNextDll || settingboolget("Events", "DllUnload"))
+    if(bBreakOnNextDll || settingEventDllUnload.GetBool())
     {
         bBreakOnNextDll = false;
         //update GUI
@@ -1173,6 +1216,7 @@ static void cbUnloadDll(UNLOAD_DLL_DEBUG_INFO* UnloadDll)
         wait(WAITID_RUN);
     }
 
+    TraceRecord.unmapModule((duint)base);
     ModUnload((duint)base);
 
     //update memory map
@@ -1204,7 +1248,7 @@ static void cbOutputDebugString(OUTPUT_DEBUG_STRING_INFO* DebugString)
         }
     }
 
-    if(settingboolget("Events", "DebugStrings"))
+    if(settingEventDebugStrings.GetBool())
     {
         //update GUI
         GuiSetDebugState(paused);
@@ -1315,9 +1359,15 @@ static void cbException(EXCEPTION_DEBUG_INFO* ExceptionData)
 
 static void cbDebugEvent(DEBUG_EVENT* DebugEvent)
 {
-    PLUG_CB_DEBUGEVENT debugEventInfo;
-    debugEventInfo.DebugEvent = DebugEvent;
-    plugincbcall(CB_DEBUGEVENT, &debugEventInfo);
+    // Thread details (CIP, last error, ...) are fetched again when they are needed after an event
+    ThreadInvalidateSnapshot();
+
+    if(pluginhascallbacks(CB_DEBUGEVENT))
+    {
+        PLUG_CB_DEBUGEVENT debugEventInfo;
+        debugEventInfo.DebugEvent = DebugEvent;
+        plugincbcall(CB_DEBUGEVENT, &debugEventInfo);
+    }
 }
 
 bool cbDeleteAllBreakpoints(const BREAKPOINT* bp)
@@ -1953,6 +2003,7 @@ static void debugLoopFunction(void* lpParameter, bool attach)
     ModClear();
     ThreadClear();
     TraceRecord.clear();
+    logTemplates.clear();
     GuiSetDebugState(stopped);
     GuiUpdateAllViews();
     dputs("Debugging stopped!");
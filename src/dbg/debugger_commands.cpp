@@ -1625,7 +1625,7 @@ CMDRESULT cbDebugSuspendthread(int argc, char* argv[])
         return STATUS_ERROR;
     }
     //suspend thread
-    if(SuspendThread(ThreadGetHandle((DWORD)threadid)) == -1)
+    if(ThreadSuspend((DWORD)threadid) == -1)
     {
         dputs("Error suspending thread");
         return STATUS_ERROR;
@@ -1647,7 +1647,7 @@ CMDRESULT cbDebugResumethread(int argc, char* argv[])
         return STATUS_ERROR;
     }
     //resume thread
-    if(ResumeThread(ThreadGetHandle((DWORD)threadid)) == -1)
+    if(ThreadResume((DWORD)threadid) == -1)
     {
         dputs("Error resuming thread");
         return STATUS_ERROR;
@@ -2262,7 +2262,7 @@ CMDRESULT cbDebugLoadLib(int argc, char* argv[])
     auto ok = SetBPX((duint)ASMAddr + counter, UE_SINGLESHOOT | UE_BREAKPOINT_TYPE_INT3, (void*)cbDebugLoadLibBPX);
 
     ThreadSuspendAll();
-    ResumeThread(LoadLibThread);
+    ThreadResume((DWORD)LoadLibThreadID);
 
     unlock(WAITID_RUN);
 
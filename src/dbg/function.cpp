@@ -146,6 +146,21 @@ void FunctionCacheLoad(JSON Root)
     functions.CacheLoad(Root, false, "auto"); //legacy support
 }
 
+void FunctionCacheSave(DbFileWriter & Writer)
+{
+    functions.CacheSave(Writer);
+}
+
+void FunctionCacheLoad(const DbFileReader & Reader)
+{
+    functions.CacheLoad(Reader);
+}
+
+duint FunctionCacheGeneration()
+{
+    return functions.GetGeneration();
+}
+
 bool FunctionEnum(FUNCTIONSINFO* List, size_t* Size)
 {
     return functions.Enum(List, Size);
@@ -2,6 +2,7 @@
 #define _FUNCTION_H
 
 #include "addrinfo.h"
+#include "dbfile.h"
 
 struct FUNCTIONSINFO
 {
@@ -19,6 +20,9 @@ bool FunctionDelete(duint Address);
 void FunctionDelRange(duint Start, duint End, bool DeleteManual = false);
 void FunctionCacheSave(JSON Root);
 void FunctionCacheLoad(JSON Root);
+void FunctionCacheSave(DbFileWriter & Writer);
+void FunctionCacheLoad(const DbFileReader & Reader);
+duint FunctionCacheGeneration();
 bool FunctionEnum(FUNCTIONSINFO* List, size_t* Size);
 void FunctionClear();
 void FunctionGetList(std::vector<FUNCTIONSINFO> & list);
@@ -1,6 +1,7 @@
 #include "handles.h"
 #include "undocumented.h"
 #include "error.h"
+#include "threading.h"
 
 typedef struct _OBJECT_NAME_INFORMATION
 {
@@ -80,29 +81,90 @@ typedef NTSTATUS(NTAPI* ZWQUERYOBJECT)(
     OUT PULONG ReturnLength OPTIONAL
 );
 
+// Big enough for any object name (UNICODE_STRING lengths are 16-bit) or type information
+#define HANDLE_SCRATCH_SIZE (sizeof(OBJECT_TYPE_INFORMATION) + 0x10000 + sizeof(WCHAR))
+// Name queries that take longer than this are assumed to hang (synchronous pipes)
+#define HANDLE_NAME_TIMEOUT 500
+#define HANDLE_NAME_MAX_WORKERS 4
+
+// The system handle table only grows by a bit between calls, so the buffer is kept (and its size remembered)
+static std::vector<unsigned char> handleInformation;
+// ObjectTypeIndex -> type name, the type indices do not change until a reboot
+static std::unordered_map<unsigned char, String> handleTypeNames;
+
+static ZWQUERYOBJECT getZwQueryObject()
+{
+    static auto ZwQueryObject = ZWQUERYOBJECT(GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "ZwQueryObject"));
+    return ZwQueryObject;
+}
+
+/**
+\brief Queries the UNICODE_STRING at the start of an object information class into dest, without allocating memory.
+*/
+static bool queryObjectString(HANDLE hObject, LONG infoClass, void* scratch, char* dest, size_t destSize)
+{
+    auto ZwQueryObject = getZwQueryObject();
+    if(!ZwQueryObject || !destSize)
+        return false;
+    *dest = '\0';
+    if(ZwQueryObject(hObject, infoClass, scratch, ULONG(HANDLE_SCRATCH_SIZE), nullptr) != STATUS_SUCCESS)
+        return false;
+    const UNICODE_STRING & str = *(UNICODE_STRING*)scratch;
+    int length = str.Length / sizeof(WCHAR);
+    if(!length || !str.Buffer)
+        return true;
+    int size = WideCharToMultiByte(CP_UTF8, 0, str.Buffer, length, dest, int(destSize - 1), nullptr, nullptr);
+    if(!size) //too long, every character takes at most three bytes
+        size = WideCharToMultiByte(CP_UTF8, 0, str.Buffer, min(length, int(destSize - 1) / 3), dest, int(destSize - 1), nullptr, nullptr);
+    dest[size] = '\0';
+    return true;
+}
+
+/**
+\brief Gets the type name of a handle, the name is cached by ObjectTypeIndex. Call with LockHandles held.
+*/
+static const String* getTypeName(HANDLE hLocalHandle, unsigned char typeNumber, void* scratch)
+{
+    auto found = handleTypeNames.find(typeNumber);
+    if(found != handleTypeNames.end())
+        return &found->second;
+    char typeName[MAX_STRING_SIZE];
+    if(!queryObjectString(hLocalHandle, ObjectTypeInformation, scratch, typeName, sizeof(typeName)))
+        return nullptr;
+    return &handleTypeNames.insert(std::make_pair(typeNumber, String(typeName))).first->second;
+}
+
 bool HandlesEnum(duint pid, std::vector<HANDLEINFO> & handles)
 {
     static auto ZwQuerySystemInformation = ZWQUERYSYSTEMINFORMATION(GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "ZwQuerySystemInformation"));
     if(!ZwQuerySystemInformation)
         return 0;
-    Memory<PSYSTEM_HANDLE_INFORMATION> HandleInformation(16 * 1024, "_dbg_enumhandles");
+    EXCLUSIVE_ACQUIRE(LockHandles);
+    if(handleInformation.empty())
+        handleInformation.resize(16 * 1024);
     NTSTATUS ErrorCode = ERROR_SUCCESS;
     for(;;)
     {
-        ErrorCode = ZwQuerySystemInformation(SystemHandleInformation, HandleInformation(), ULONG(HandleInformation.size()), nullptr);
+        ULONG ReturnLength = 0;
+        ErrorCode = ZwQuerySystemInformation(SystemHandleInformation, handleInformation.data(), ULONG(handleInformation.size()), &ReturnLength);
         if(ErrorCode != STATUS_INFO_LENGTH_MISMATCH)
             break;
-        HandleInformation.realloc(HandleInformation.size() * 2, "_dbg_enumhandles");
+        // Leave room for the handles that are created before the next query
+        if(ReturnLength > handleInformation.size())
+            handleInformation.resize(ReturnLength + ReturnLength / 8);
+        else
+            handleInformation.resize(handleInformation.size() * 2);
     }
     if(ErrorCode != STATUS_SUCCESS)
         return false;
 
-    handles.reserve(HandleInformation()->NumberOfHandles);
+    auto HandleInformation = PSYSTEM_HANDLE_INFORMATION(handleInformation.data());
+    handles.reserve(HandleInformation->NumberOfHandles);
 
     HANDLEINFO info;
-    for(ULONG i = 0; i < HandleInformation()->NumberOfHandles; i++)
+    for(ULONG i = 0; i < HandleInformation->NumberOfHandles; i++)
     {
-        const auto & handle = HandleInformation()->Handles[i];
+        const auto & handle = HandleInformation->Handles[i];
         if(handle.UniqueProcessId != pid)
             continue;
         info.Handle = handle.HandleValue;
@@ -115,30 +177,196 @@ bool HandlesEnum(duint pid, std::vector<HANDLEINFO> & handles)
 
 bool HandlesGetName(HANDLE hProcess, HANDLE remoteHandle, String & name, String & typeName)
 {
-    static auto ZwQueryObject = ZWQUERYOBJECT(GetProcAddress(GetModuleHandleW(L"ntdll.dll"), "ZwQueryObject"));
-    if(!ZwQueryObject)
+    if(!getZwQueryObject())
         return false;
     HANDLE hLocalHandle;
     if(DuplicateHandle(hProcess, remoteHandle, GetCurrentProcess(), &hLocalHandle, 0, FALSE, 0))
     {
-        ULONG ReturnSize = 0;
-        if(ZwQueryObject(hLocalHandle, ObjectTypeInformation, nullptr, 0, &ReturnSize) == STATUS_INFO_LENGTH_MISMATCH)
+        std::vector<unsigned char> scratch(HANDLE_SCRATCH_SIZE);
+        std::vector<char> buffer(MAX_STRING_SIZE);
+        if(queryObjectString(hLocalHandle, ObjectTypeInformation, scratch.data(), buffer.data(), buffer.size()))
+            typeName = buffer.data();
+        if(queryObjectString(hLocalHandle, ObjectNameInformation, scratch.data(), buffer.data(), buffer.size()))
+            name = buffer.data();
+        CloseHandle(hLocalHandle);
+    }
+    else
+        name = ErrorCodeToName(GetLastError());
+    return true;
+}
+
+struct HandleNameQuery
+{
+    HANDLE hProcess;
+    std::vector<HANDLEDETAILS>* handles;
+    volatile LONG next; //next index to resolve
+};
+
+struct HandleNameWorker
+{
+    HandleNameQuery* query;
+    HANDLE hThread;
+    volatile LONG current; //index that is being resolved, -1 when there is none
+    volatile DWORD started; //tick count when current was taken
+    std::vector<unsigned char> scratch;
+};
+
+// Workers can be terminated when a query hangs, so they must not allocate or take locks
+static DWORD WINAPI handleNameWorkerThread(void* ptr)
+{
+    auto worker = (HandleNameWorker*)ptr;
+    auto & handles = *worker->query->handles;
+    for(;;)
+    {
+        LONG index = InterlockedIncrement(&worker->query->next) - 1;
+        if(index >= LONG(handles.size()))
+            break;
+        worker->started = GetTickCount();
+        InterlockedExchange(&worker->current, index);
+        auto & handle = handles[index];
+        HANDLE hLocalHandle;
+        if(DuplicateHandle(worker->query->hProcess, HANDLE(handle.Handle), GetCurrentProcess(), &hLocalHandle, 0, FALSE, 0))
+        {
+            queryObjectString(hLocalHandle, ObjectNameInformation, worker->scratch.data(), handle.Name, sizeof(handle.Name));
+            CloseHandle(hLocalHandle);
+        }
+        else
         {
-            Memory<OBJECT_TYPE_INFORMATION*> objectTypeInfo(ReturnSize + sizeof(WCHAR) * 16, "_dbg_gethandlename:objectTypeInfo");
-            if(ZwQueryObject(hLocalHandle, ObjectTypeInformation, objectTypeInfo(), ReturnSize, nullptr) == STATUS_SUCCESS)
-                typeName = StringUtils::Utf16ToUtf8(objectTypeInfo()->TypeName.Buffer);
+            // ErrorCodeToName only looks up a static table, so this is safe in a worker
+            auto error = ErrorCodeToName(GetLastError());
+            if(error)
+                strcpy_s(handle.Name, error);
         }
+        InterlockedExchange(&worker->current, -1);
+    }
+    return 0;
+}
+
+static bool startNameWorker(HandleNameWorker & worker)
+{
+    worker.current = -1;
+    worker.hThread = CreateThread(nullptr, 0, handleNameWorkerThread, &worker, 0, nullptr);
+    return worker.hThread != nullptr;
+}
+
+/**
+\brief Resolves the names of all handles on worker threads. A worker that is stuck on one handle for longer
+than HANDLE_NAME_TIMEOUT is terminated (the name stays empty) and replaced by a new one.
+*/
+static void resolveHandleNames(HANDLE hProcess, std::vector<HANDLEDETAILS> & handles, bool parallel)
+{
+    HandleNameQuery query;
+    query.hProcess = hProcess;
+    query.handles = &handles;
+    query.next = 0;
+
+    int workerCount = 1;
+    if(parallel)
+    {
+        SYSTEM_INFO systemInfo;
+        GetSystemInfo(&systemInfo);
+        workerCount = max(1, min(HANDLE_NAME_MAX_WORKERS, int(systemInfo.dwNumberOfProcessors)));
+    }
+    HandleNameWorker workers[HANDLE_NAME_MAX_WORKERS];
+    HANDLE threads[HANDLE_NAME_MAX_WORKERS];
+    int running = 0;
+    for(int i = 0; i < workerCount; i++)
+    {
+        auto & worker = workers[running];
+        worker.query = &query;
+        worker.scratch.resize(HANDLE_SCRATCH_SIZE);
+        if(startNameWorker(worker))
+            running++;
+    }
+    if(!running) //no threads, resolve without the timeout guard
+    {
+        workers[0].current = -1;
+        handleNameWorkerThread(&workers[0]);
+        return;
+    }
 
-        if(ZwQueryObject(hLocalHandle, ObjectNameInformation, nullptr, 0, &ReturnSize) == STATUS_INFO_LENGTH_MISMATCH)
+    for(;;)
+    {
+        int waiting = 0;
+        for(int i = 0; i < running; i++)
+            if(workers[i].hThread)
+                threads[waiting++] = workers[i].hThread;
+        if(!waiting || WaitForMultipleObjects(waiting, threads, TRUE, HANDLE_NAME_TIMEOUT / 4) != WAIT_TIMEOUT)
+            break;
+        DWORD now = GetTickCount();
+        for(int i = 0; i < running; i++)
         {
-            Memory<OBJECT_NAME_INFORMATION*> objectNameInfo(ReturnSize + sizeof(WCHAR) * 16, "_dbg_gethandlename:objectNameInfo");
-            if(ZwQueryObject(hLocalHandle, ObjectNameInformation, objectNameInfo(), ReturnSize, nullptr) == STATUS_SUCCESS)
-                name = StringUtils::Utf16ToUtf8(objectNameInfo()->Name.Buffer);
+            auto & worker = workers[i];
+            LONG current = worker.current;
+            // The worker can take a handle after now was sampled, so the difference is signed
+            if(!worker.hThread || current < 0 || LONG(now - worker.started) < LONG(HANDLE_NAME_TIMEOUT))
+                continue;
+            // Make sure the worker did not move on to the next handle in the meantime
+            SuspendThread(worker.hThread);
+            if(worker.current != current)
+            {
+                ResumeThread(worker.hThread);
+                continue;
+            }
+            // The duplicated handle of the hanging query is leaked, closing it could hang as well
+            TerminateThread(worker.hThread, 0);
+            WaitForSingleObject(worker.hThread, INFINITE);
+            CloseHandle(worker.hThread);
+            handles[current].Name[0] = '\0';
+            // If no new thread can be started the remaining handles are picked up by the other workers
+            if(!startNameWorker(worker))
+                worker.hThread = nullptr;
         }
+    }
+    for(int i = 0; i < running; i++)
+        if(workers[i].hThread)
+            CloseHandle(workers[i].hThread);
+}
 
-        CloseHandle(hLocalHandle);
+/**
+\brief Enumerates the handles of a process with their type names and names resolved.
+\param pid The process id.
+\param hProcess Handle to the process (needs PROCESS_DUP_HANDLE).
+\param [out] handles The handles.
+\param parallel Resolve the names on multiple threads.
+*/
+bool HandlesEnumDetails(duint pid, HANDLE hProcess, std::vector<HANDLEDETAILS> & handles, bool parallel)
+{
+    std::vector<HANDLEINFO> handleInfo;
+    if(!HandlesEnum(pid, handleInfo))
+        return false;
+    handles.resize(handleInfo.size());
+    {
+        EXCLUSIVE_ACQUIRE(LockHandles);
+        std::vector<unsigned char> scratch;
+        for(size_t i = 0; i < handleInfo.size(); i++)
+        {
+            const auto & info = handleInfo[i];
+            auto & handle = handles[i];
+            handle.Handle = info.Handle;
+            handle.TypeNumber = info.TypeNumber;
+            handle.GrantedAccess = info.GrantedAccess;
+            handle.TypeName[0] = '\0';
+            handle.Name[0] = '\0';
+            auto found = handleTypeNames.find(info.TypeNumber);
+            if(found != handleTypeNames.end())
+            {
+                strcpy_s(handle.TypeName, found->second.c_str());
+                continue;
+            }
+            // Only the first handle of an unknown type is queried
+            HANDLE hLocalHandle;
+            if(!DuplicateHandle(hProcess, HANDLE(info.Handle), GetCurrentProcess(), &hLocalHandle, 0, FALSE, 0))
+                continue;
+            if(scratch.empty())
+                scratch.resize(HANDLE_SCRATCH_SIZE);
+            auto typeName = getTypeName(hLocalHandle, info.TypeNumber, scratch.data());
+            if(typeName)
+                strcpy_s(handle.TypeName, typeName->c_str());
+            CloseHandle(hLocalHandle);
+        }
     }
-    else
-        name = ErrorCodeToName(GetLastError());
+    if(!handles.empty())
+        resolveHandleNames(hProcess, handles, parallel);
     return true;
 }
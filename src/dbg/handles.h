@@ -4,4 +4,5 @@
 #include "_dbgfunctions.h"
 
 bool HandlesEnum(duint pid, std::vector<HANDLEINFO> & handlesList);
-bool HandlesGetName(HANDLE hProcess, HANDLE remoteHandle, String & name, String & typeName);
\ No newline at end of file
+bool HandlesGetName(HANDLE hProcess, HANDLE remoteHandle, String & name, String & typeName);
+bool HandlesEnumDetails(duint pid, HANDLE hProcess, std::vector<HANDLEDETAILS> & handles, bool parallel);
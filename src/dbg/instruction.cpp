@@ -37,6 +37,10 @@
 #include "error.h"
 #include "recursiveanalysis.h"
 #include "xrefsanalysis.h"
+#include "TraceRecord.h"
+#include "latestworker.h"
+#include "stackinfo.h"
+#include "msgqueue.h"
 
 static bool bRefinit = false;
 static int maxFindResults = 5000;
@@ -424,14 +428,25 @@ CMDRESULT cbInstrBookmarkDel(int argc, char* argv[])
 
 CMDRESULT cbInstrLoaddb(int argc, char* argv[])
 {
-    DbLoad(DbLoadSaveType::All);
+    DbLoad(DbLoadSaveType::All, argc > 1 ? argv[1] : nullptr);
     GuiUpdateAllViews();
     return STATUS_CONTINUE;
 }
 
 CMDRESULT cbInstrSavedb(int argc, char* argv[])
 {
-    DbSave(DbLoadSaveType::All);
+    DbSave(DbLoadSaveType::All, argc > 1 ? argv[1] : nullptr);
+    return STATUS_CONTINUE;
+}
+
+CMDRESULT cbInstrExportdb(int argc, char* argv[])
+{
+    if(argc < 2)
+    {
+        dputs("not enough arguments!");
+        return STATUS_ERROR;
+    }
+    DbSave(DbLoadSaveType::All, argv[1], true);
     return STATUS_CONTINUE;
 }
 
@@ -2581,3 +2596,303 @@ CMDRESULT cbInstrEnableGuiUpdate(int argc, char* argv[])
     return STATUS_CONTINUE;
 }
 
+
+CMDRESULT cbInstrCommandBenchmark(int argc, char* argv[])
+{
+    if(argc < 3)
+    {
+        dputs("not enough arguments!");
+        return STATUS_ERROR;
+    }
+    duint count;
+    if(!valfromstring(argv[1], &count, false))
+        return STATUS_ERROR;
+    String command = argv[2];
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+    for(duint i = 0; i < count; i++)
+    {
+        if(cmddirectexec("%s", command.c_str()) == STATUS_ERROR)
+        {
+            dprintf("command failed after %" fext "u iteration(s)\n", i);
+            return STATUS_ERROR;
+        }
+    }
+    QueryPerformanceCounter(&end);
+    double seconds = double(end.QuadPart - start.QuadPart) / double(frequency.QuadPart);
+    dprintf("%" fext "u command(s) in %.3fs (%.0f commands/s)\n", count, seconds, seconds > 0 ? double(count) / seconds : 0.0);
+    return STATUS_CONTINUE;
+}
+
+CMDRESULT cbInstrGuiBenchmark(int argc, char* argv[])
+{
+    duint count = 1000;
+    if(argc > 1 && !valfromstring(argv[1], &count, false))
+        return STATUS_ERROR;
+    if(!count)
+        return STATUS_ERROR;
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+    for(duint i = 0; i < count; i++)
+    {
+        SELECTIONDATA selection;
+        if(!GuiSelectionGet(GUI_DISASSEMBLY, &selection)) //synchronous debugger -> GUI round trip
+        {
+            dputs("GuiSelectionGet failed!");
+            return STATUS_ERROR;
+        }
+    }
+    QueryPerformanceCounter(&end);
+    double seconds = double(end.QuadPart - start.QuadPart) / double(frequency.QuadPart);
+    dprintf("%" fext "u round trip(s) in %.3fs (%.1fus per round trip)\n", count, seconds, seconds * 1000000.0 / double(count));
+    return STATUS_CONTINUE;
+}
+
+CMDRESULT cbInstrStackWorkerBenchmark(int argc, char* argv[])
+{
+    duint count = 10000;
+    if(argc > 1 && !valfromstring(argv[1], &count, false))
+        return STATUS_ERROR;
+    if(!count)
+        return STATUS_ERROR;
+
+    // Each stop runs a simulated walk (256 frames of busy work, checking for a newer stop between frames)
+    // followed by the real SEH walk, which drops its result when a newer stop arrived in the meantime
+    volatile LONG started = 0;
+    volatile LONG cancelled = 0;
+    volatile LONG sehDropped = 0;
+    volatile LONG published = 0;
+    volatile LONG outOfOrder = 0;
+    volatile LONG lastPublished = 0;
+    LatestRequestWorker* worker = nullptr;
+    LatestRequestWorker stressWorker([&](unsigned int generation)
+    {
+        auto isStale = [&]()
+        {
+            return worker->IsStale(generation);
+        };
+        InterlockedIncrement(&started);
+        bool stale = false;
+        for(int frame = 0; frame < 256 && !stale; frame++)
+        {
+            for(volatile int i = 0; i < 200; i++);
+            stale = isStale();
+        }
+        if(stale)
+            InterlockedIncrement(&cancelled);
+        else if(!stackupdateseh(isStale))
+            InterlockedIncrement(&sehDropped);
+        else
+        {
+            if(LONG(generation) < lastPublished)
+                InterlockedIncrement(&outOfOrder);
+            InterlockedExchange(&lastPublished, LONG(generation));
+            InterlockedIncrement(&published);
+        }
+    });
+    worker = &stressWorker;
+
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+    unsigned int last = 0;
+    for(duint i = 0; i < count; i++)
+    {
+        last = stressWorker.Request();
+        if(i % 64 == 0)
+            Sleep(0); //let the worker pick up some of the stops
+    }
+    // The newest stop must always be walked to completion
+    for(DWORD waited = 0; lastPublished != LONG(last) && waited < 10000; waited++)
+        Sleep(1);
+    QueryPerformanceCounter(&end);
+    stressWorker.Stop();
+
+    double seconds = double(end.QuadPart - start.QuadPart) / double(frequency.QuadPart);
+    // Stops that arrive during a walk must be coalesced, so far fewer walks than stops are started
+    bool coalesced = duint(started) <= count / 4 + 1;
+    bool ok = coalesced && !outOfOrder && lastPublished == LONG(last);
+    dprintf("%" fext "u stop(s) in %.3fs: %d walk(s) started%s, %d cancelled, %d stale SEH result(s) dropped, %d published, %d out of order, newest stop %s\n",
+            count, seconds, started, coalesced ? "" : " (NOT coalesced)", cancelled, sehDropped, published, outOfOrder, lastPublished == LONG(last) ? "published" : "NOT published");
+    dputs(ok ? "stack worker benchmark passed" : "stack worker benchmark FAILED");
+    return ok ? STATUS_CONTINUE : STATUS_ERROR;
+}
+
+CMDRESULT cbInstrTraceCoverage(int argc, char* argv[])
+{
+    if(argc < 2 || _stricmp(argv[1], "export"))
+    {
+        dputs("usage: tracecoverage export[, output path without extension]");
+        return STATUS_ERROR;
+    }
+    String path;
+    if(argc > 2)
+        path = argv[2];
+    else
+    {
+        // Next to the database, the debuggee directory may not be writable
+        path = DbGetPath();
+        auto extension = path.find_last_of('.');
+        auto fileStart = path.find_last_of('\\');
+        if(extension == String::npos || (fileStart != String::npos && extension < fileStart))
+        {
+            dputs("no database path, specify an output path!");
+            return STATUS_ERROR;
+        }
+        path.resize(extension);
+    }
+    if(!TraceRecord.exportCoverage(path + ".drcov", path + ".csv"))
+        return STATUS_ERROR;
+    return STATUS_CONTINUE;
+}
+
+CMDRESULT cbInstrPaintBenchmark(int argc, char* argv[])
+{
+    duint count = 1000;
+    if(argc > 1 && !valfromstring(argv[1], &count, false))
+        return STATUS_ERROR;
+    if(!count || count > 0x7FFFFFFF)
+        return STATUS_ERROR;
+    GuiPaintBenchmark(int(count)); //the GUI reports the timing
+    return STATUS_CONTINUE;
+}
+
+// The semantics of the previous command queue: unbounded, locked, one kernel wakeup per message
+struct LockedMessageQueue
+{
+    CRITICAL_SECTION cs;
+    std::deque<MESSAGE> msgs;
+    HANDLE hAvailable;
+};
+
+struct MsgQueueBenchmarkProducer
+{
+    MESSAGE_STACK* stack; //nullptr to use the locked queue
+    LockedMessageQueue* locked;
+    duint first;
+    duint count;
+};
+
+static DWORD WINAPI msgQueueBenchmarkProducer(void* ptr)
+{
+    auto producer = (MsgQueueBenchmarkProducer*)ptr;
+    for(duint i = 0; i < producer->count; i++)
+    {
+        duint value = producer->first + i;
+        if(producer->stack)
+        {
+            MsgSend(producer->stack, 0, value, 0);
+        }
+        else
+        {
+            MESSAGE msg;
+            msg.msg = 0;
+            msg.param1 = value;
+            msg.param2 = 0;
+            EnterCriticalSection(&producer->locked->cs);
+            producer->locked->msgs.push_back(msg);
+            LeaveCriticalSection(&producer->locked->cs);
+            ReleaseSemaphore(producer->locked->hAvailable, 1, nullptr);
+        }
+    }
+    return 0;
+}
+
+static bool msgQueueBenchmarkRun(bool ring, duint count, int producers, double & seconds)
+{
+    MESSAGE_STACK* stack = nullptr;
+    LockedMessageQueue locked;
+    if(ring)
+    {
+        stack = MsgAllocStack();
+        if(!stack)
+            return false;
+    }
+    else
+    {
+        InitializeCriticalSection(&locked.cs);
+        locked.hAvailable = CreateSemaphoreW(nullptr, 0, LONG_MAX, nullptr);
+    }
+
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+
+    std::vector<MsgQueueBenchmarkProducer> producerInfo(producers);
+    std::vector<HANDLE> threads;
+    duint first = 1;
+    for(int i = 0; i < producers; i++)
+    {
+        auto & producer = producerInfo[i];
+        producer.stack = stack;
+        producer.locked = &locked;
+        producer.first = first;
+        producer.count = count / producers + (duint(i) < count % producers ? 1 : 0);
+        first += producer.count;
+        threads.push_back(CreateThread(nullptr, 0, msgQueueBenchmarkProducer, &producer, 0, nullptr));
+    }
+
+    // Every value from 1 to count is sent exactly once
+    unsigned long long sum = 0;
+    duint received = 0;
+    MESSAGE batch[32];
+    while(received < count)
+    {
+        if(ring)
+        {
+            int batchCount = MsgWaitBatch(stack, batch, _countof(batch));
+            for(int i = 0; i < batchCount; i++)
+                sum += batch[i].param1;
+            received += batchCount;
+        }
+        else
+        {
+            WaitForSingleObject(locked.hAvailable, INFINITE);
+            EnterCriticalSection(&locked.cs);
+            sum += locked.msgs.front().param1;
+            locked.msgs.pop_front();
+            LeaveCriticalSection(&locked.cs);
+            received++;
+        }
+    }
+
+    QueryPerformanceCounter(&end);
+    seconds = double(end.QuadPart - start.QuadPart) / double(frequency.QuadPart);
+
+    for(auto hThread : threads)
+    {
+        WaitForSingleObject(hThread, INFINITE);
+        CloseHandle(hThread);
+    }
+    if(ring)
+        MsgFreeStack(stack);
+    else
+    {
+        CloseHandle(locked.hAvailable);
+        DeleteCriticalSection(&locked.cs);
+    }
+    return sum == (unsigned long long)count * (count + 1) / 2;
+}
+
+CMDRESULT cbInstrMsgQueueBenchmark(int argc, char* argv[])
+{
+    duint count = 1000000;
+    duint producers = 4;
+    if(argc > 1 && !valfromstring(argv[1], &count, false))
+        return STATUS_ERROR;
+    if(argc > 2 && !valfromstring(argv[2], &producers, false))
+        return STATUS_ERROR;
+    if(!count || !producers || producers > 64)
+        return STATUS_ERROR;
+
+    double lockedSeconds, ringSeconds;
+    bool lockedOk = msgQueueBenchmarkRun(false, count, int(producers), lockedSeconds);
+    bool ringOk = msgQueueBenchmarkRun(true, count, int(producers), ringSeconds);
+    dprintf("locked queue: %" fext "u message(s) from %" fext "u producer(s) in %.3fs (%.0f messages/s)%s\n",
+            count, producers, lockedSeconds, lockedSeconds > 0 ? double(count) / lockedSeconds : 0.0, lockedOk ? "" : ", messages LOST");
+    dprintf("message ring: %" fext "u message(s) from %" fext "u producer(s) in %.3fs (%.0f messages/s)%s\n",
+            count, producers, ringSeconds, ringSeconds > 0 ? double(count) / ringSeconds : 0.0, ringOk ? "" : ", messages LOST");
+    return lockedOk && ringOk ? STATUS_CONTINUE : STATUS_ERROR;
+}
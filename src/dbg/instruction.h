@@ -18,6 +18,7 @@ CMDRESULT cbInstrBookmarkSet(int argc, char* argv[]);
 CMDRESULT cbInstrBookmarkDel(int argc, char* argv[]);
 CMDRESULT cbInstrLoaddb(int argc, char* argv[]);
 CMDRESULT cbInstrSavedb(int argc, char* argv[]);
+CMDRESULT cbInstrExportdb(int argc, char* argv[]);
 CMDRESULT cbInstrAssemble(int argc, char* argv[]);
 CMDRESULT cbInstrFunctionAdd(int argc, char* argv[]);
 CMDRESULT cbInstrFunctionDel(int argc, char* argv[]);
@@ -92,5 +93,11 @@ CMDRESULT cbInstrBriefcheck(int argc, char* argv[]);
 
 CMDRESULT cbInstrDisableGuiUpdate(int argc, char* argv[]);
 CMDRESULT cbInstrEnableGuiUpdate(int argc, char* argv[]);
+CMDRESULT cbInstrCommandBenchmark(int argc, char* argv[]);
+CMDRESULT cbInstrGuiBenchmark(int argc, char* argv[]);
+CMDRESULT cbInstrStackWorkerBenchmark(int argc, char* argv[]);
+CMDRESULT cbInstrPaintBenchmark(int argc, char* argv[]);
+CMDRESULT cbInstrTraceCoverage(int argc, char* argv[]);
+CMDRESULT cbInstrMsgQueueBenchmark(int argc, char* argv[]);
 
 #endif // _INSTRUCTION_H
@@ -22,6 +22,48 @@ struct Labels : AddrInfoHashMap<LockLabels, LABELSINFO, LabelSerializer>
     {
         return "labels";
     }
+
+    bool GetByText(const char* text, LABELSINFO & value)
+    {
+        SHARED_ACQUIRE(LockLabels);
+        auto found = mTextIndex.find(text);
+        if(found == mTextIndex.end())
+            return false;
+        auto & map = GetDataUnsafe();
+        auto label = map.find(found->second);
+        if(label == map.end())
+            return false;
+        value = label->second;
+        return true;
+    }
+
+protected:
+    void onInsert(const duint & key, const LABELSINFO & value) override
+    {
+        mTextIndex.insert({ value.text, key });
+    }
+
+    void onRemove(const duint & key, const LABELSINFO & value) override
+    {
+        auto range = mTextIndex.equal_range(value.text);
+        for(auto itr = range.first; itr != range.second; ++itr)
+        {
+            if(itr->second == key)
+            {
+                mTextIndex.erase(itr);
+                break;
+            }
+        }
+    }
+
+    void onClear() override
+    {
+        mTextIndex.clear();
+    }
+
+private:
+    //label text -> key, labels are not required to be unique
+    std::unordered_multimap<String, duint> mTextIndex;
 };
 
 static Labels labels;
@@ -47,14 +89,14 @@ bool LabelSet(duint Address, const char* Text, bool Manual)
 
 bool LabelFromString(const char* Text, duint* Address)
 {
-    return labels.GetWhere([&](const LABELSINFO & value)
-    {
-        if(strcmp(value.text, Text))
-            return false;
-        if(Address)
-            *Address = value.addr + ModBaseFromName(value.mod);
-        return true;
-    });
+    if(!Text)
+        return false;
+    LABELSINFO label;
+    if(!labels.GetByText(Text, label))
+        return false;
+    if(Address)
+        *Address = label.addr + ModBaseFromName(label.mod);
+    return true;
 }
 
 bool LabelGet(duint Address, char* Text)
@@ -88,6 +130,21 @@ void LabelCacheLoad(JSON Root)
     labels.CacheLoad(Root, false, "auto"); //legacy support
 }
 
+void LabelCacheSave(DbFileWriter & Writer)
+{
+    labels.CacheSave(Writer);
+}
+
+void LabelCacheLoad(const DbFileReader & Reader)
+{
+    labels.CacheLoad(Reader);
+}
+
+duint LabelCacheGeneration()
+{
+    return labels.GetGeneration();
+}
+
 bool LabelEnum(LABELSINFO* List, size_t* Size)
 {
     return labels.Enum(List, Size);
@@ -3,6 +3,7 @@
 
 #include "_global.h"
 #include "addrinfo.h"
+#include "dbfile.h"
 
 struct LABELSINFO : AddrInfo
 {
@@ -16,6 +17,9 @@ bool LabelDelete(duint Address);
 void LabelDelRange(duint Start, duint End, bool Manual);
 void LabelCacheSave(JSON root);
 void LabelCacheLoad(JSON root);
+void LabelCacheSave(DbFileWriter & Writer);
+void LabelCacheLoad(const DbFileReader & Reader);
+duint LabelCacheGeneration();
 bool LabelEnum(LABELSINFO* List, size_t* Size);
 void LabelClear();
 void LabelGetList(std::vector<LABELSINFO> & list);
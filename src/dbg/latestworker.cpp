@@ -0,0 +1,94 @@
+/**
+@file latestworker.cpp
+
+@brief Implements a worker thread that only runs the most recent request.
+*/
+
+#include "latestworker.h"
+
+LatestRequestWorker::LatestRequestWorker(const CBWORK & cbWork)
+    : mWork(cbWork),
+      mThread(nullptr),
+      mEvent(nullptr),
+      mGeneration(0),
+      mStop(false)
+{
+    InitializeCriticalSection(&mStartLock);
+}
+
+LatestRequestWorker::~LatestRequestWorker()
+{
+    Stop();
+    DeleteCriticalSection(&mStartLock);
+}
+
+/**
+\brief Queues a run of the work callback, superseding any request that has not finished yet.
+\return The generation of this request.
+*/
+unsigned int LatestRequestWorker::Request()
+{
+    unsigned int generation = (unsigned int)InterlockedIncrement(&mGeneration);
+    if(!mThread)
+    {
+        // The thread is started on the first request
+        EnterCriticalSection(&mStartLock);
+        if(!mThread && !mStop)
+        {
+            mEvent = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+            mThread = CreateThread(nullptr, 0, workerThread, this, 0, nullptr);
+        }
+        LeaveCriticalSection(&mStartLock);
+    }
+    if(mEvent)
+        SetEvent(mEvent);
+    return generation;
+}
+
+bool LatestRequestWorker::IsStale(unsigned int generation) const
+{
+    return mStop || (unsigned int)mGeneration != generation;
+}
+
+unsigned int LatestRequestWorker::Generation() const
+{
+    return (unsigned int)mGeneration;
+}
+
+/**
+\brief Stops the worker thread after the current run (which sees itself as stale) returns.
+*/
+void LatestRequestWorker::Stop()
+{
+    EnterCriticalSection(&mStartLock);
+    mStop = true;
+    if(mThread)
+    {
+        SetEvent(mEvent);
+        WaitForSingleObject(mThread, INFINITE);
+        CloseHandle(mThread);
+        CloseHandle(mEvent);
+        mThread = nullptr;
+        mEvent = nullptr;
+    }
+    LeaveCriticalSection(&mStartLock);
+}
+
+DWORD WINAPI LatestRequestWorker::workerThread(void* ptr)
+{
+    auto worker = (LatestRequestWorker*)ptr;
+    unsigned int handled = 0;
+    while(true)
+    {
+        WaitForSingleObject(worker->mEvent, INFINITE);
+        if(worker->mStop)
+            break;
+        // Run once for the newest generation, the requests in between are dropped
+        unsigned int generation = (unsigned int)worker->mGeneration;
+        if(generation == handled)
+            continue;
+        handled = generation;
+        worker->mWork(generation);
+    }
+    return 0;
+}
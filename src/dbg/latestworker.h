@@ -0,0 +1,38 @@
+#ifndef _LATESTWORKER_H
+#define _LATESTWORKER_H
+
+#include "_global.h"
+
+/**
+\brief A long-lived worker thread with a single-slot mailbox: only the latest request is run.
+
+Every Request() bumps a generation counter and wakes the worker. Requests that arrive
+while the worker is busy are coalesced, the worker then runs once more for the newest
+generation. The work callback receives its generation and should poll IsStale() to
+abandon work (and drop results) that a newer request has superseded.
+*/
+class LatestRequestWorker
+{
+public:
+    typedef std::function<void(unsigned int generation)> CBWORK;
+
+    explicit LatestRequestWorker(const CBWORK & cbWork);
+    ~LatestRequestWorker();
+
+    unsigned int Request();
+    bool IsStale(unsigned int generation) const;
+    unsigned int Generation() const;
+    void Stop();
+
+private:
+    static DWORD WINAPI workerThread(void* ptr);
+
+    CBWORK mWork;
+    CRITICAL_SECTION mStartLock;
+    HANDLE mThread;
+    HANDLE mEvent;
+    volatile LONG mGeneration;
+    volatile bool mStop;
+};
+
+#endif //_LATESTWORKER_H
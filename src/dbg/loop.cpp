@@ -4,6 +4,7 @@
 #include "module.h"
 
 std::map<DepthModuleRange, LOOPSINFO, DepthModuleRangeCompare> loops;
+static volatile LONG loopsGeneration = 1;
 
 bool LoopAdd(duint Start, duint End, bool Manual)
 {
@@ -47,6 +48,7 @@ bool LoopAdd(duint Start, duint End, bool Manual)
 
     // Insert into list
     loops.insert(std::make_pair(DepthModuleRange(finalDepth, ModuleRange(ModHashFromAddr(moduleBase), Range(loopInfo.start, loopInfo.end))), loopInfo));
+    InterlockedIncrement(&loopsGeneration);
     return true;
 }
 
@@ -214,6 +216,7 @@ void LoopCacheLoad(JSON Root)
 
     // Remove existing entries
     loops.clear();
+    InterlockedIncrement(&loopsGeneration);
 
     const JSON jsonLoops = json_object_get(Root, "loops");
     const JSON jsonAutoLoops = json_object_get(Root, "autoloops");
@@ -227,6 +230,71 @@ void LoopCacheLoad(JSON Root)
         AddLoops(jsonAutoLoops, false);
 }
 
+void LoopCacheSave(DbFileWriter & Writer)
+{
+    EXCLUSIVE_ACQUIRE(LockLoops);
+
+    // User-set and auto-set loops go to separate chunks, like in the JSON database
+    for(int manual = 1; manual >= 0; manual--)
+    {
+        Writer.BeginChunk(manual ? "loops" : "autoloops");
+        for(auto & itr : loops)
+        {
+            const LOOPSINFO & currentLoop = itr.second;
+            if(currentLoop.manual != (manual != 0))
+                continue;
+            Writer.BeginRecord();
+            Writer.PutString("module", currentLoop.mod);
+            Writer.PutHex("start", currentLoop.start);
+            Writer.PutHex("end", currentLoop.end);
+            Writer.PutInt("depth", currentLoop.depth);
+            Writer.PutHex("parent", currentLoop.parent);
+            Writer.EndRecord();
+        }
+        Writer.EndChunk();
+    }
+}
+
+void LoopCacheLoad(const DbFileReader & Reader)
+{
+    EXCLUSIVE_ACQUIRE(LockLoops);
+
+    // Remove existing entries
+    loops.clear();
+    InterlockedIncrement(&loopsGeneration);
+
+    for(int manual = 1; manual >= 0; manual--)
+    {
+        Reader.EnumRecords(manual ? "loops" : "autoloops", [manual](const DbRecord & record)
+        {
+            LOOPSINFO loopInfo;
+            memset(&loopInfo, 0, sizeof(LOOPSINFO));
+
+            const char* mod;
+            if(record.GetString("module", mod) && strlen(mod) < MAX_MODULE_SIZE)
+                strcpy_s(loopInfo.mod, mod);
+
+            long long depth = 0;
+            record.GetHex("start", loopInfo.start);
+            record.GetHex("end", loopInfo.end);
+            record.GetInt("depth", depth);
+            record.GetHex("parent", loopInfo.parent);
+            loopInfo.depth = int(depth);
+            loopInfo.manual = manual != 0;
+
+            // Sanity check: Make sure the loop starts before it ends
+            if(loopInfo.end >= loopInfo.start)
+                loops.insert(std::make_pair(DepthModuleRange(loopInfo.depth, ModuleRange(ModHashFromName(loopInfo.mod), Range(loopInfo.start, loopInfo.end))), loopInfo));
+            return true;
+        });
+    }
+}
+
+duint LoopCacheGeneration()
+{
+    return duint(loopsGeneration);
+}
+
 bool LoopEnum(LOOPSINFO* List, size_t* Size)
 {
     // If list or size is not requested, fail
@@ -261,4 +329,5 @@ void LoopClear()
 {
     EXCLUSIVE_ACQUIRE(LockLoops);
     loops.clear();
+    InterlockedIncrement(&loopsGeneration);
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define _LOOP_H
 
 #include "addrinfo.h"
+#include "dbfile.h"
 
 struct LOOPSINFO
 {
@@ -19,6 +20,9 @@ bool LoopOverlaps(int Depth, duint Start, duint End, int* FinalDepth);
 bool LoopDelete(int Depth, duint Address);
 void LoopCacheSave(JSON Root);
 void LoopCacheLoad(JSON Root);
+void LoopCacheSave(DbFileWriter & Writer);
+void LoopCacheLoad(const DbFileReader & Reader);
+duint LoopCacheGeneration();
 bool LoopEnum(LOOPSINFO* List, size_t* Size);
 void LoopClear();
 
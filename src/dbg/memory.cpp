@@ -21,6 +21,70 @@ std::map<Range, MEMPAGE, RangeCompare> memoryPages;
 bool bListAllPages = false;
 DWORD memMapThreadCounter = 0;
 
+// Every region carries the generation of the map update that inserted or last changed it,
+// removed regions are remembered for a while so viewers can fetch just the differences.
+static duint memoryMapGeneration = 0;
+static std::unordered_map<duint, duint> memoryPageGenerations; //region base -> generation
+static std::deque<std::pair<duint, duint>> memoryRemovedPages; //(region base, generation), oldest first
+static duint memoryRemovedFloor = 0; //removals up to this generation were forgotten
+static const size_t MaxRemovedPages = 65536;
+
+static bool memPageEqual(const MEMPAGE & a, const MEMPAGE & b)
+{
+    return a.mbi.BaseAddress == b.mbi.BaseAddress &&
+           a.mbi.AllocationBase == b.mbi.AllocationBase &&
+           a.mbi.AllocationProtect == b.mbi.AllocationProtect &&
+           a.mbi.RegionSize == b.mbi.RegionSize &&
+           a.mbi.State == b.mbi.State &&
+           a.mbi.Protect == b.mbi.Protect &&
+           a.mbi.Type == b.mbi.Type &&
+           strcmp(a.info, b.info) == 0;
+}
+
+/**
+\brief Stamps the regions that differ between memoryPages and newPages. Requires LockMemoryPages.
+*/
+static void memUpdateGenerations(const std::map<Range, MEMPAGE, RangeCompare> & newPages)
+{
+    duint generation = memoryMapGeneration + 1;
+    bool changed = false;
+    auto oldItr = memoryPages.begin();
+    auto newItr = newPages.begin();
+    while(oldItr != memoryPages.end() || newItr != newPages.end())
+    {
+        if(newItr == newPages.end() || (oldItr != memoryPages.end() && oldItr->first.first < newItr->first.first))
+        {
+            memoryPageGenerations.erase(oldItr->first.first);
+            memoryRemovedPages.push_back(std::make_pair(oldItr->first.first, generation));
+            changed = true;
+            ++oldItr;
+        }
+        else if(oldItr == memoryPages.end() || newItr->first.first < oldItr->first.first)
+        {
+            memoryPageGenerations[newItr->first.first] = generation;
+            changed = true;
+            ++newItr;
+        }
+        else
+        {
+            if(!memPageEqual(oldItr->second, newItr->second))
+            {
+                memoryPageGenerations[newItr->first.first] = generation;
+                changed = true;
+            }
+            ++oldItr;
+            ++newItr;
+        }
+    }
+    while(memoryRemovedPages.size() > MaxRemovedPages)
+    {
+        memoryRemovedFloor = memoryRemovedPages.front().second;
+        memoryRemovedPages.pop_front();
+    }
+    if(changed)
+        memoryMapGeneration = generation;
+}
+
 void MemUpdateMap()
 {
     // First gather all possible pages in the memory range
@@ -169,8 +233,8 @@ void MemUpdateMap()
     }
 
     // Get a list of threads for information about Kernel/PEB/TEB/Stack ranges
-    THREADLIST threadList;
-    ThreadGetList(&threadList);
+    std::vector<THREADINFO> threadList;
+    ThreadGetList(threadList);
 
     for(auto & page : pageVector)
     {
@@ -185,15 +249,15 @@ void MemUpdateMap()
         }
 
         // Check in threads
-        for(int i = 0; i < threadList.count; i++)
+        for(auto & thread : threadList)
         {
-            DWORD threadId = threadList.list[i].BasicInfo.ThreadId;
+            DWORD threadId = thread.ThreadId;
 
             // Mark TEB
             //
             // TebBase:      Points to 32/64 TEB
             // TebBaseWow64: Points to 64 TEB in a 32bit process
-            duint tebBase = threadList.list[i].BasicInfo.ThreadLocalBase;
+            duint tebBase = thread.ThreadLocalBase;
             duint tebBaseWow64 = tebBase - (2 * PAGE_SIZE);
 
             if(pageBase == tebBase)
@@ -227,20 +291,19 @@ void MemUpdateMap()
         }
     }
 
-    // Only free thread data if it was allocated
-    if(threadList.list)
-        BridgeFree(threadList.list);
-
     // Convert the vector to a map
-    EXCLUSIVE_ACQUIRE(LockMemoryPages);
-    memoryPages.clear();
+    std::map<Range, MEMPAGE, RangeCompare> newPages;
 
     for(auto & page : pageVector)
     {
         duint start = (duint)page.mbi.BaseAddress;
         duint size = (duint)page.mbi.RegionSize;
-        memoryPages.insert(std::make_pair(std::make_pair(start, start + size - 1), page));
+        newPages.insert(std::make_pair(std::make_pair(start, start + size - 1), page));
     }
+
+    EXCLUSIVE_ACQUIRE(LockMemoryPages);
+    memUpdateGenerations(newPages);
+    memoryPages = std::move(newPages);
 }
 
 void MemUpdateMapAsync()
@@ -250,6 +313,61 @@ void MemUpdateMapAsync()
     InterlockedExchange((volatile LONG*)&memMapThreadCounter, 0);
 }
 
+/**
+\brief Gets the regions that were inserted, changed or removed after a generation of the memory map.
+\param SinceGeneration The generation the caller has, 0 to get the whole map.
+\param [out] Changes The changes, the page and removed arrays have to be freed with BridgeFree.
+*/
+bool MemGetMapChanges(duint SinceGeneration, MEMMAPCHANGES* Changes)
+{
+    if(!Changes)
+        return false;
+    memset(Changes, 0, sizeof(MEMMAPCHANGES));
+
+    SHARED_ACQUIRE(LockMemoryPages);
+
+    Changes->generation = memoryMapGeneration;
+    Changes->reset = !SinceGeneration || SinceGeneration < memoryRemovedFloor || SinceGeneration > memoryMapGeneration;
+    if(!Changes->reset && SinceGeneration == memoryMapGeneration)
+        return true;
+
+    std::vector<const MEMPAGE*> pages;
+    for(auto & itr : memoryPages)
+    {
+        if(!Changes->reset)
+        {
+            auto found = memoryPageGenerations.find(itr.first.first);
+            if(found != memoryPageGenerations.end() && found->second <= SinceGeneration)
+                continue;
+        }
+        pages.push_back(&itr.second);
+    }
+    if(!pages.empty())
+    {
+        Changes->pageCount = int(pages.size());
+        Changes->pages = (MEMPAGE*)BridgeAlloc(sizeof(MEMPAGE) * pages.size());
+        for(size_t i = 0; i < pages.size(); i++)
+            memcpy(&Changes->pages[i], pages[i], sizeof(MEMPAGE));
+    }
+
+    if(!Changes->reset)
+    {
+        // The removals are ordered by generation, only the tail is new to the caller
+        auto removedItr = memoryRemovedPages.end();
+        while(removedItr != memoryRemovedPages.begin() && (removedItr - 1)->second > SinceGeneration)
+            --removedItr;
+        size_t removedCount = memoryRemovedPages.end() - removedItr;
+        if(removedCount)
+        {
+            Changes->removedCount = int(removedCount);
+            Changes->removed = (duint*)BridgeAlloc(sizeof(duint) * removedCount);
+            for(size_t i = 0; i < removedCount; i++, ++removedItr)
+                Changes->removed[i] = removedItr->first;
+        }
+    }
+    return true;
+}
+
 duint MemFindBaseAddr(duint Address, duint* Size, bool Refresh)
 {
     // Update the memory map if needed
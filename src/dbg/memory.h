@@ -4,6 +4,7 @@
 #include "_global.h"
 #include "addrinfo.h"
 #include "patternfind.h"
+#include "_dbgfunctions.h"
 
 extern std::map<Range, MEMPAGE, RangeCompare> memoryPages;
 extern bool bListAllPages;
@@ -23,6 +24,7 @@ struct SimplePage
 
 void MemUpdateMap();
 void MemUpdateMapAsync();
+bool MemGetMapChanges(duint SinceGeneration, MEMMAPCHANGES* Changes);
 duint MemFindBaseAddr(duint Address, duint* Size, bool Refresh = false);
 bool MemRead(duint BaseAddress, void* Buffer, duint Size, duint* NumberOfBytesRead = nullptr, bool cache = false);
 bool MemReadUnsafe(duint BaseAddress, void* Buffer, duint Size, duint* NumberOfBytesRead = nullptr);
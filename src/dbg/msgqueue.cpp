@@ -1,48 +1,112 @@
 #include "msgqueue.h"
 
+/*
+The ring is a bounded queue with per-slot sequence numbers: a slot at position p is free
+for the producer of lap p when its sequence equals p, and holds a message for the consumer
+when it equals p + 1. Producers claim positions with a compare-exchange, so sending never
+takes a lock or allocates. The consumer only sleeps on the event after announcing it in
+'sleeping', producers pay for SetEvent only when the consumer is actually waiting.
+
+A full ring never drops a message and never blocks the sender (the consumer thread may be
+the sender): the message goes to the overflow queue instead. While the overflow queue is not
+empty every producer appends to it, and the consumer only reads it once the ring is empty,
+so the messages of one producer are still received in the order they were sent.
+*/
+
 // Allocate a message stack
 MESSAGE_STACK* MsgAllocStack()
 {
     auto stack = new MESSAGE_STACK;
 
-    stack->WaitingCalls = 0;
+    for(LONG i = 0; i < MAX_MESSAGES; i++)
+        stack->slots[i].sequence = i;
+    stack->enqueuePos = 0;
+    stack->dequeuePos = 0;
+    stack->sleeping = 0;
+    stack->hWake = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    stack->overflowCount = 0;
+    InitializeCriticalSection(&stack->overflowLock);
     stack->Destroy = false;
 
+    if(!stack->hWake)
+    {
+        DeleteCriticalSection(&stack->overflowLock);
+        delete stack;
+        return nullptr;
+    }
     return stack;
 }
 
-// Free a message stack
+// Free a message stack, the consumer must not be waiting on it anymore (see MsgAbort)
 void MsgFreeStack(MESSAGE_STACK* Stack)
 {
     ASSERT_NONNULL(Stack);
 
+    CloseHandle(Stack->hWake);
+    DeleteCriticalSection(&Stack->overflowLock);
+
+    // Delete allocated structure
+    delete Stack;
+}
+
+// Make every further call fail and wake the waiting consumer
+void MsgAbort(MESSAGE_STACK* Stack)
+{
+    ASSERT_NONNULL(Stack);
+
     // Update termination variable
     Stack->Destroy = true;
+    MemoryBarrier();
+    SetEvent(Stack->hWake);
+}
 
-    // Notify each thread
-    for(int i = 0; i < Stack->WaitingCalls + 1; i++) //TODO: found crash here on exit
+// Claim a free ring slot and publish the message in it (will return false when the ring is full)
+static bool ringPush(MESSAGE_STACK* Stack, const MESSAGE & Msg)
+{
+    // Claim a position
+    MESSAGE_SLOT* slot;
+    ULONG pos = ULONG(Stack->enqueuePos);
+    while(true)
     {
-        MESSAGE newMessage;
-        Stack->msgs.enqueue(newMessage);
+        slot = &Stack->slots[pos & (MAX_MESSAGES - 1)];
+        LONG diff = LONG(ULONG(slot->sequence) - pos);
+        if(diff == 0)
+        {
+            if(ULONG(InterlockedCompareExchange(&Stack->enqueuePos, LONG(pos + 1), LONG(pos))) == pos)
+                break;
+        }
+        else if(diff < 0) //the consumer did not free this slot yet
+            return false;
+        pos = ULONG(Stack->enqueuePos);
     }
 
-    // Delete allocated structure
-    delete Stack;
+    // Fill and publish the slot
+    slot->msg = Msg;
+    InterlockedExchange(&slot->sequence, LONG(pos + 1));
+    return true;
 }
 
-// Add a message to the stack
+// Add a message to the stack (will only return false when the stack is aborted)
 bool MsgSend(MESSAGE_STACK* Stack, int Msg, duint Param1, duint Param2)
 {
     if(Stack->Destroy)
         return false;
 
-    MESSAGE newMessage;
-    newMessage.msg = Msg;
-    newMessage.param1 = Param1;
-    newMessage.param2 = Param2;
+    MESSAGE msg;
+    msg.msg = Msg;
+    msg.param1 = Param1;
+    msg.param2 = Param2;
+    if(Stack->overflowCount || !ringPush(Stack, msg))
+    {
+        EnterCriticalSection(&Stack->overflowLock);
+        Stack->overflow.push_back(msg);
+        InterlockedIncrement(&Stack->overflowCount);
+        LeaveCriticalSection(&Stack->overflowLock);
+    }
 
-    // Asynchronous send
-    asend(Stack->msgs, newMessage);
+    // Wake the consumer if it is waiting
+    if(Stack->sleeping && InterlockedExchange(&Stack->sleeping, 0))
+        SetEvent(Stack->hWake);
     return true;
 }
 
@@ -52,18 +116,53 @@ bool MsgGet(MESSAGE_STACK* Stack, MESSAGE* Msg)
     if(Stack->Destroy)
         return false;
 
-    // Don't increment the wait count because this does not wait
-    return try_receive(Stack->msgs, *Msg);
+    ULONG pos = ULONG(Stack->dequeuePos);
+    MESSAGE_SLOT* slot = &Stack->slots[pos & (MAX_MESSAGES - 1)];
+    if(LONG(ULONG(slot->sequence) - (pos + 1)) < 0) //empty or the producer is still writing
+    {
+        if(!Stack->overflowCount)
+            return false;
+        EnterCriticalSection(&Stack->overflowLock);
+        *Msg = Stack->overflow.front();
+        Stack->overflow.pop_front();
+        InterlockedDecrement(&Stack->overflowCount);
+        LeaveCriticalSection(&Stack->overflowLock);
+        return true;
+    }
+    *Msg = slot->msg;
+    InterlockedExchange(&slot->sequence, LONG(pos + MAX_MESSAGES));
+    Stack->dequeuePos = LONG(pos + 1);
+    return true;
 }
 
-// Wait for a message on the specified stack
-void MsgWait(MESSAGE_STACK* Stack, MESSAGE* Msg)
+// Wait for at least one message and get up to MaxCount of them (will return 0 when the stack is aborted)
+int MsgWaitBatch(MESSAGE_STACK* Stack, MESSAGE* Msgs, int MaxCount)
 {
-    if(Stack->Destroy)
-        return;
+    if(MaxCount <= 0)
+        return 0;
+    int count = 0;
+    while(!Stack->Destroy)
+    {
+        while(count < MaxCount && MsgGet(Stack, &Msgs[count]))
+            count++;
+        if(count)
+            break;
 
-    // Increment/decrement wait count
-    InterlockedIncrement((volatile long*)&Stack->WaitingCalls);
-    *Msg = Stack->msgs.dequeue();
-    InterlockedDecrement((volatile long*)&Stack->WaitingCalls);
+        // Announce the wait, then check again so a message sent in between is not missed
+        InterlockedExchange(&Stack->sleeping, 1);
+        if(MsgGet(Stack, &Msgs[count]))
+        {
+            InterlockedExchange(&Stack->sleeping, 0);
+            count++;
+            continue;
+        }
+        WaitForSingleObject(Stack->hWake, INFINITE);
+    }
+    return count;
+}
+
+// Wait for a message on the specified stack (will return false when the stack is aborted)
+bool MsgWait(MESSAGE_STACK* Stack, MESSAGE* Msg)
+{
+    return MsgWaitBatch(Stack, Msg, 1) == 1;
 }
@@ -2,10 +2,8 @@
 #define _MSGQUEUE_H
 
 #include "_global.h"
-#include <windows.h>
-#include <agents.h>
 
-#define MAX_MESSAGES 256
+#define MAX_MESSAGES 1024 //must be a power of two
 
 // Message structure
 struct MESSAGE
@@ -15,21 +13,36 @@ struct MESSAGE
     duint param2;
 };
 
-// Message stack structure
+// Preallocated ring slot, the sequence tells whether it is free or holds a message for the current lap
+struct MESSAGE_SLOT
+{
+    volatile LONG sequence;
+    MESSAGE msg;
+};
+
+// Multi-producer single-consumer message ring, messages spill to a locked overflow queue when it is full
 class MESSAGE_STACK
 {
 public:
-    Concurrency::unbounded_buffer<MESSAGE> msgs;
+    MESSAGE_SLOT slots[MAX_MESSAGES];
+    volatile LONG enqueuePos;   // Next position a producer claims
+    LONG dequeuePos;            // Next position the consumer reads
+    volatile LONG sleeping;     // The consumer is (about to be) waiting on hWake
+    HANDLE hWake;               // Auto-reset event to wake the consumer
+    volatile LONG overflowCount; // Number of messages in the overflow queue
+    CRITICAL_SECTION overflowLock;
+    std::deque<MESSAGE> overflow; // Messages sent while the ring was full, read after the ring is empty
 
-    int WaitingCalls;   // Number of threads waiting
-    bool Destroy;       // Destroy stack as soon as possible
+    bool Destroy;               // Destroy stack as soon as possible
 };
 
 // Function definitions
 MESSAGE_STACK* MsgAllocStack();
 void MsgFreeStack(MESSAGE_STACK* Stack);
+void MsgAbort(MESSAGE_STACK* Stack);
 bool MsgSend(MESSAGE_STACK* Stack, int Msg, duint Param1, duint Param2);
 bool MsgGet(MESSAGE_STACK* Stack, MESSAGE* Msg);
-void MsgWait(MESSAGE_STACK* Stack, MESSAGE* Msg);
+bool MsgWait(MESSAGE_STACK* Stack, MESSAGE* Msg);
+int MsgWaitBatch(MESSAGE_STACK* Stack, MESSAGE* Msgs, int MaxCount);
 
 #endif // _MSGQUEUE_H
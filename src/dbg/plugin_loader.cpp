@@ -19,10 +19,33 @@ static std::vector<PLUG_DATA> pluginList;
 */
 static int curPluginHandle = 0;
 
+#define CB_COUNT (CB_WINEVENTGLOBAL + 1)
+
+typedef std::vector<PLUG_CALLBACK> PluginCallbackArray;
+
 /**
-\brief List of plugin callbacks.
+\brief Plugin callbacks per callback type. The arrays are immutable once published, changes
+replace the array (under LockPluginCallbackList) so plugincbcall can read them without a lock.
 */
-static std::vector<PLUG_CALLBACK> pluginCallbackList;
+static PluginCallbackArray* volatile pluginCallbackArrays[CB_COUNT];
+
+/**
+\brief Replaced callback arrays, a plugincbcall might still be walking them. Freed on unload.
+*/
+static std::vector<PluginCallbackArray*> pluginCallbackRetired;
+
+//call with LockPluginCallbackList held
+static void pluginCallbackPublish(CBTYPE cbType, PluginCallbackArray* callbacks)
+{
+    if(callbacks && callbacks->empty())
+    {
+        delete callbacks;
+        callbacks = nullptr;
+    }
+    auto previous = (PluginCallbackArray*)InterlockedExchangePointer((PVOID volatile*)&pluginCallbackArrays[cbType], callbacks);
+    if(previous)
+        pluginCallbackRetired.push_back(previous);
+}
 
 /**
 \brief List of plugin commands.
@@ -320,7 +343,11 @@ void pluginunload()
     }
     {
         EXCLUSIVE_ACQUIRE(LockPluginCallbackList);
-        pluginCallbackList.clear(); //remove all callbacks
+        for(int i = 0; i < CB_COUNT; i++) //remove all callbacks
+            pluginCallbackPublish(CBTYPE(i), nullptr);
+        for(auto callbacks : pluginCallbackRetired) //the plugins are stopped, nothing is calling them anymore
+            delete callbacks;
+        pluginCallbackRetired.clear();
     }
     {
         EXCLUSIVE_ACQUIRE(LockPluginMenuList);
@@ -342,13 +369,26 @@ void pluginunload()
 */
 void pluginregistercallback(int pluginHandle, CBTYPE cbType, CBPLUGIN cbPlugin)
 {
-    pluginunregistercallback(pluginHandle, cbType); //remove previous callback
+    if(cbType < 0 || cbType >= CB_COUNT)
+        return;
     PLUG_CALLBACK cbStruct;
     cbStruct.pluginHandle = pluginHandle;
     cbStruct.cbType = cbType;
     cbStruct.cbPlugin = cbPlugin;
     EXCLUSIVE_ACQUIRE(LockPluginCallbackList);
-    pluginCallbackList.push_back(cbStruct);
+    auto callbacks = new PluginCallbackArray();
+    if(pluginCallbackArrays[cbType])
+        *callbacks = *pluginCallbackArrays[cbType];
+    for(auto it = callbacks->begin(); it != callbacks->end(); ++it) //remove previous callback
+    {
+        if(it->pluginHandle == pluginHandle)
+        {
+            callbacks->erase(it);
+            break;
+        }
+    }
+    callbacks->push_back(cbStruct);
+    pluginCallbackPublish(cbType, callbacks);
 }
 
 /**
@@ -358,19 +398,33 @@ void pluginregistercallback(int pluginHandle, CBTYPE cbType, CBPLUGIN cbPlugin)
 */
 bool pluginunregistercallback(int pluginHandle, CBTYPE cbType)
 {
+    if(cbType < 0 || cbType >= CB_COUNT)
+        return false;
     EXCLUSIVE_ACQUIRE(LockPluginCallbackList);
-    for(auto it = pluginCallbackList.begin(); it != pluginCallbackList.end(); ++it)
+    const PluginCallbackArray* current = pluginCallbackArrays[cbType];
+    if(!current)
+        return false;
+    for(size_t i = 0; i < current->size(); i++)
     {
-        const auto & currentCallback = *it;
-        if(currentCallback.pluginHandle == pluginHandle && currentCallback.cbType == cbType)
+        if(current->at(i).pluginHandle == pluginHandle)
         {
-            pluginCallbackList.erase(it);
+            auto callbacks = new PluginCallbackArray(*current);
+            callbacks->erase(callbacks->begin() + i);
+            pluginCallbackPublish(cbType, callbacks);
             return true;
         }
     }
     return false;
 }
 
+/**
+\brief Checks if any plugin registered a callback of a certain type, use it to skip building the callback information.
+*/
+bool pluginhascallbacks(CBTYPE cbType)
+{
+    return cbType >= 0 && cbType < CB_COUNT && pluginCallbackArrays[cbType] != nullptr;
+}
+
 /**
 \brief Call all registered callbacks of a certain type.
 \param cbType The type of callbacks to call.
@@ -378,17 +432,16 @@ bool pluginunregistercallback(int pluginHandle, CBTYPE cbType)
 */
 void plugincbcall(CBTYPE cbType, void* callbackInfo)
 {
-    SHARED_ACQUIRE(LockPluginCallbackList);
-    auto callbackList = pluginCallbackList; //copy for thread-safety reasons
-    SHARED_RELEASE();
-    for(const auto & currentCallback : callbackList)
+    if(cbType < 0 || cbType >= CB_COUNT)
+        return;
+    const PluginCallbackArray* callbacks = pluginCallbackArrays[cbType];
+    if(!callbacks)
+        return;
+    for(const auto & currentCallback : *callbacks)
     {
-        if(currentCallback.cbType == cbType)
-        {
-            CBPLUGIN cbPlugin = currentCallback.cbPlugin;
-            if(!IsBadReadPtr((const void*)cbPlugin, sizeof(duint)))
-                cbPlugin(cbType, callbackInfo);
-        }
+        CBPLUGIN cbPlugin = currentCallback.cbPlugin;
+        if(!IsBadReadPtr((const void*)cbPlugin, sizeof(duint)))
+            cbPlugin(cbType, callbackInfo);
     }
 }
 
@@ -575,16 +628,14 @@ void pluginmenucall(int hEntry)
         {
             PLUG_CB_MENUENTRY menuEntryInfo;
             menuEntryInfo.hEntry = currentMenu.hEntryPlugin;
-            SectionLocker<LockPluginCallbackList, true> callbackLock; //shared lock
-            auto j = pluginCallbackList.begin();
-            while(j != pluginCallbackList.end())
+            const PluginCallbackArray* callbacks = pluginCallbackArrays[CB_MENUENTRY];
+            if(!callbacks)
+                return;
+            for(const auto & currentCallback : *callbacks)
             {
-                const auto currentCallback = *j;
-                ++j;
-                if(currentCallback.pluginHandle == currentMenu.pluginHandle && currentCallback.cbType == CB_MENUENTRY)
+                if(currentCallback.pluginHandle == currentMenu.pluginHandle)
                 {
                     menuLock.Unlock();
-                    callbackLock.Unlock();
                     currentCallback.cbPlugin(CB_MENUENTRY, &menuEntryInfo);
                     return;
                 }
@@ -2,6 +2,7 @@
 #include "threading.h"
 #include "module.h"
 #include "memory.h"
+#include "dbfile.h"
 
 template<class TValue>
 class JSONWrapper
@@ -14,24 +15,58 @@ public:
     void SetJson(JSON json)
     {
         mJson = json;
+        mWriter = nullptr;
+        mRecord = nullptr;
+    }
+
+    //binary database backend: Save writes fields of the current record, Load reads them from record
+    void SetRecord(DbFileWriter* writer)
+    {
+        mJson = nullptr;
+        mWriter = writer;
+        mRecord = nullptr;
+    }
+
+    void SetRecord(const DbRecord* record)
+    {
+        mJson = nullptr;
+        mWriter = nullptr;
+        mRecord = record;
     }
 
     virtual bool Save(const TValue & value) = 0;
     virtual bool Load(TValue & value) = 0;
 
 protected:
+    bool isBinary() const
+    {
+        return mWriter || mRecord;
+    }
+
     void setString(const char* key, const char* value)
     {
-        set(key, json_string(value));
+        if(mWriter)
+            mWriter->PutString(key, value);
+        else
+            set(key, json_string(value));
     }
 
     template<size_t TSize>
     bool getString(const char* key, char(&_Dest)[TSize]) const
     {
-        auto jsonValue = get(key);
-        if(!jsonValue)
-            return false;
-        auto str = json_string_value(jsonValue);
+        const char* str = nullptr;
+        if(mRecord)
+        {
+            if(!mRecord->GetString(key, str))
+                return false;
+        }
+        else
+        {
+            auto jsonValue = get(key);
+            if(!jsonValue)
+                return false;
+            str = json_string_value(jsonValue);
+        }
         if(str && strlen(str) < TSize)
         {
             strcpy_s(_Dest, str);
@@ -42,11 +77,16 @@ protected:
 
     void setHex(const char* key, duint value)
     {
-        set(key, json_hex(value));
+        if(mWriter)
+            mWriter->PutHex(key, value);
+        else
+            set(key, json_hex(value));
     }
 
     bool getHex(const char* key, duint & value) const
     {
+        if(mRecord)
+            return mRecord->GetHex(key, value);
         auto jsonValue = get(key);
         if(!jsonValue)
             return false;
@@ -56,11 +96,16 @@ protected:
 
     void setBool(const char* key, bool value)
     {
-        set(key, json_boolean(value));
+        if(mWriter)
+            mWriter->PutBool(key, value);
+        else
+            set(key, json_boolean(value));
     }
 
     bool getBool(const char* key, bool & value) const
     {
+        if(mRecord)
+            return mRecord->GetBool(key, value);
         auto jsonValue = get(key);
         if(!jsonValue)
             return false;
@@ -71,12 +116,23 @@ protected:
     template<typename T>
     void setInt(const char* key, T value)
     {
-        set(key, json_integer(value));
+        if(mWriter)
+            mWriter->PutInt(key, (long long)value);
+        else
+            set(key, json_integer(value));
     }
 
     template<typename T>
     bool getInt(const char* key, T & value)
     {
+        if(mRecord)
+        {
+            long long integer;
+            if(!mRecord->GetInt(key, integer))
+                return false;
+            value = T(integer);
+            return true;
+        }
         auto jsonValue = get(key);
         if(!jsonValue)
             return false;
@@ -95,7 +151,20 @@ protected:
         return json_object_get(mJson, key);
     }
 
+    //binary backend only, data points into the record on load
+    void setBlob(const char* key, const void* data, size_t size)
+    {
+        mWriter->PutBlob(key, data, size);
+    }
+
+    bool getBlob(const char* key, const void* & data, size_t & size) const
+    {
+        return mRecord->GetBlob(key, data, size);
+    }
+
     JSON mJson = nullptr;
+    DbFileWriter* mWriter = nullptr;
+    const DbRecord* mRecord = nullptr;
 };
 
 template<SectionLock TLock, class TKey, class TValue, class TMap, class TSerializer>
@@ -134,7 +203,13 @@ public:
     bool Delete(const TKey & key)
     {
         EXCLUSIVE_ACQUIRE(TLock);
-        return mMap.erase(key) > 0;
+        auto found = mMap.find(key);
+        if(found == mMap.end())
+            return false;
+        onRemove(found->first, found->second);
+        mMap.erase(found);
+        markDirty();
+        return true;
     }
 
     void DeleteWhere(TValuePred predicate)
@@ -143,7 +218,11 @@ public:
         for(auto itr = mMap.begin(); itr != mMap.end();)
         {
             if(predicate(itr->second))
+            {
+                onRemove(itr->first, itr->second);
                 itr = mMap.erase(itr);
+                markDirty();
+            }
             else
                 ++itr;
         }
@@ -163,6 +242,8 @@ public:
     {
         EXCLUSIVE_ACQUIRE(TLock);
         mMap.clear();
+        onClear();
+        markDirty();
     }
 
     void CacheSave(JSON root) const
@@ -204,6 +285,39 @@ public:
         }
     }
 
+    void CacheSave(DbFileWriter & writer) const
+    {
+        SHARED_ACQUIRE(TLock);
+        TSerializer serializer;
+        serializer.SetRecord(&writer);
+        writer.BeginChunk(jsonKey());
+        for(const auto & itr : mMap)
+        {
+            writer.BeginRecord();
+            if(serializer.Save(itr.second))
+                writer.EndRecord();
+            else
+                writer.CancelRecord();
+        }
+        writer.EndChunk();
+    }
+
+    void CacheLoad(const DbFileReader & reader, bool clear = true)
+    {
+        if(clear)
+            Clear();
+        EXCLUSIVE_ACQUIRE(TLock);
+        TSerializer deserializer;
+        reader.EnumRecords(jsonKey(), [&](const DbRecord & record)
+        {
+            deserializer.SetRecord(&record);
+            TValue value;
+            if(deserializer.Load(value))
+                addNoLock(value);
+            return true;
+        });
+    }
+
     void GetList(std::vector<TValue> & values) const
     {
         SHARED_ACQUIRE(TLock);
@@ -248,18 +362,59 @@ public:
         return mMap;
     }
 
+    //call with the exclusive lock held after modifying the map through GetDataUnsafe
+    void MarkDirty()
+    {
+        markDirty();
+    }
+
+    //changes on every modification, the database reuses the last serialized chunk while it stays the same
+    duint GetGeneration() const
+    {
+        return duint(mGeneration);
+    }
+
     virtual void AdjustValue(TValue & value) const = 0;
 
 protected:
     virtual const char* jsonKey() const = 0;
     virtual TKey makeKey(const TValue & value) const = 0;
 
+    //notifications for derived classes that keep secondary indices (called with the lock held)
+    virtual void onInsert(const TKey & key, const TValue & value)
+    {
+    }
+
+    virtual void onRemove(const TKey & key, const TValue & value)
+    {
+    }
+
+    virtual void onClear()
+    {
+    }
+
 private:
     TMap mMap;
+    volatile LONG mGeneration = 1;
+
+    void markDirty()
+    {
+        InterlockedIncrement(&mGeneration);
+    }
 
     bool addNoLock(const TValue & value)
     {
-        mMap[makeKey(value)] = value;
+        auto key = makeKey(value);
+        auto found = mMap.find(key);
+        if(found != mMap.end())
+        {
+            onRemove(found->first, found->second);
+            found->second = value;
+        }
+        else
+            mMap.insert({ key, value });
+        onInsert(key, value);
+        markDirty();
         return true;
     }
 
@@ -0,0 +1,49 @@
+#ifndef _SETTINGHANDLE_H
+#define _SETTINGHANDLE_H
+
+#include "_global.h"
+
+/**
+\brief A setting that is resolved on first use, after that reads do not look it up
+or parse it again. Safe to use as a global: construction only stores the names.
+*/
+class SettingHandle
+{
+public:
+    SettingHandle(const char* section, const char* key)
+        : mSection(section),
+          mKey(key),
+          mHandle(nullptr)
+    {
+    }
+
+    bool GetBool()
+    {
+        return BridgeSettingGetBoolHandle(resolve());
+    }
+
+    bool GetUint(duint & value)
+    {
+        return BridgeSettingGetUintHandle(resolve(), &value);
+    }
+
+    bool Get(char* value)
+    {
+        return BridgeSettingGetHandle(resolve(), value);
+    }
+
+private:
+    SETTINGHANDLE resolve()
+    {
+        //racing threads resolve to the same slot
+        if(!mHandle)
+            mHandle = BridgeSettingResolve(mSection, mKey);
+        return mHandle;
+    }
+
+    const char* mSection;
+    const char* mKey;
+    SETTINGHANDLE volatile mHandle;
+};
+
+#endif //_SETTINGHANDLE_H
@@ -10,9 +10,36 @@
 #include "x64_dbg.h"
 #include "debugger.h"
 #include "filehelper.h"
+#include "commandparser.h"
+#include "value.h"
+
+enum SCRIPTINTERNALCMD
+{
+    scriptinternalnone,
+    scriptinternalret,
+    scriptinternalinvalid,
+    scriptinternalpause,
+    scriptinternalnop
+};
+
+//compiled form of a script line, indexed like linemap
+struct SCRIPTPROGRAMLINE
+{
+    SCRIPTINTERNALCMD internal = scriptinternalnone;
+    int jumpline = 0; //linebranch: line of the destination label
+    bool resolved = false; //linecommand: the command was resolved at load time
+    COMMAND cmd; //valid when resolved
+    duint cmdgeneration = 0; //command registry generation cmd was resolved in
+    bool isvar = false;
+    String text; //trimmed command (argv[0])
+    std::vector<char> argdata; //pre-split arguments, each one zero terminated
+    std::vector<size_t> argoffsets;
+};
 
 static std::vector<LINEMAPENTRY> linemap;
 
+static std::vector<SCRIPTPROGRAMLINE> program;
+
 static std::vector<SCRIPTBP> scriptbplist;
 
 static std::vector<int> scriptstack;
@@ -23,6 +50,12 @@ static bool volatile bAbort = false;
 
 static bool volatile bIsRunning = false;
 
+static bool bIsBenchmark = false;
+
+static bool bFastMode = false;
+
+static DWORD fastModeInterval = 33; //ms between GUI refreshes in fast mode, 0 means only when the script stops
+
 static SCRIPTBRANCHTYPE scriptgetbranchtype(const char* text)
 {
     char newtext[MAX_SCRIPT_LINE_SIZE] = "";
@@ -73,6 +106,64 @@ static int scriptinternalstep(int fromIp) //internal step routine
     return fromIp;
 }
 
+static bool scriptisinternalcommand(const char* text, const char* cmd);
+
+static bool scriptcompilecommand(SCRIPTPROGRAMLINE & line)
+{
+    line.cmdgeneration = cmdgeneration();
+    line.resolved = false;
+    line.argdata.clear();
+    line.argoffsets.clear();
+    //these are the commands that specialformat() would rewrite at run time
+    auto len = line.text.length();
+    if(line.text.find('=') != String::npos || (len >= 2 && (line.text.compare(len - 2, 2, "++") == 0 || line.text.compare(len - 2, 2, "--") == 0)))
+        return false;
+    if(line.text.length() >= deflen)
+        return false;
+    if(!cmdfind(line.text.c_str(), &line.cmd) && !cmdget(line.text.c_str(), &line.cmd))
+        return false;
+    COMMAND var;
+    line.isvar = cmdfind("var", &var) && line.cmd.cbCommand == var.cbCommand;
+    char command[deflen] = "";
+    strcpy_s(command, line.text.c_str());
+    CommandArgv commandArgv(command);
+    auto argv = commandArgv.GetArgv();
+    for(int i = 1; i < commandArgv.GetArgc(); i++)
+    {
+        line.argoffsets.push_back(line.argdata.size());
+        line.argdata.insert(line.argdata.end(), argv[i], argv[i] + strlen(argv[i]) + 1);
+    }
+    line.resolved = true;
+    return true;
+}
+
+static void scriptcompile()
+{
+    std::vector<SCRIPTPROGRAMLINE>().swap(program);
+    program.resize(linemap.size());
+    for(size_t i = 0; i < linemap.size(); i++)
+    {
+        const auto & entry = linemap.at(i);
+        auto & line = program.at(i);
+        if(entry.type == linebranch)
+            line.jumpline = scriptlabelfind(entry.u.branch.branchlabel);
+        else if(entry.type == linecommand)
+        {
+            line.text = StringUtils::Trim(entry.u.command);
+            if(scriptisinternalcommand(entry.u.command, "ret"))
+                line.internal = scriptinternalret;
+            else if(scriptisinternalcommand(entry.u.command, "invalid"))
+                line.internal = scriptinternalinvalid;
+            else if(scriptisinternalcommand(entry.u.command, "pause"))
+                line.internal = scriptinternalpause;
+            else if(scriptisinternalcommand(entry.u.command, "nop"))
+                line.internal = scriptinternalnop;
+            else
+                scriptcompilecommand(line);
+        }
+    }
+}
+
 static bool scriptcreatelinemap(const char* filename)
 {
     String filedata;
@@ -248,6 +339,7 @@ static bool scriptcreatelinemap(const char* filename)
         strcpy_s(entry.u.command, "ret");
         linemap.push_back(entry);
     }
+    scriptcompile();
     return true;
 }
 
@@ -298,19 +390,23 @@ static bool scriptisinternalcommand(const char* text, const char* cmd)
     return false;
 }
 
-static CMDRESULT scriptinternalcmdexec(const char* cmd)
+static CMDRESULT scriptinternalret()
 {
-    if(scriptisinternalcommand(cmd, "ret")) //script finished
+    if(!scriptstack.size()) //nothing on the stack
     {
-        if(!scriptstack.size()) //nothing on the stack
-        {
+        if(!bIsBenchmark)
             GuiScriptMessage("Script finished!");
-            return STATUS_EXIT;
-        }
-        scriptIp = scriptstack.back(); //set scriptIp to the call address (scriptinternalstep will step over it)
-        scriptstack.pop_back(); //remove last stack entry
-        return STATUS_CONTINUE;
+        return STATUS_EXIT;
     }
+    scriptIp = scriptstack.back(); //set scriptIp to the call address (scriptinternalstep will step over it)
+    scriptstack.pop_back(); //remove last stack entry
+    return STATUS_CONTINUE;
+}
+
+static CMDRESULT scriptinternalcmdexec(const char* cmd)
+{
+    if(scriptisinternalcommand(cmd, "ret")) //script finished
+        return scriptinternalret();
     else if(scriptisinternalcommand(cmd, "invalid")) //invalid command for testing
         return STATUS_ERROR;
     else if(scriptisinternalcommand(cmd, "pause")) //pause the script
@@ -319,10 +415,10 @@ static CMDRESULT scriptinternalcmdexec(const char* cmd)
         return STATUS_CONTINUE;
     char command[deflen] = "";
     strcpy_s(command, StringUtils::Trim(cmd).c_str());
-    COMMAND* found = cmdfindmain(command);
-    if(!found) //invalid command
+    COMMAND found, var;
+    if(!cmdfindmain(command, &found)) //invalid command
         return STATUS_ERROR;
-    if(arraycontains(found->name, "var")) //var
+    if(cmdfind("var", &var) && found.cbCommand == var.cbCommand) //var
     {
         cmddirectexec(command);
         return STATUS_CONTINUE;
@@ -333,6 +429,44 @@ static CMDRESULT scriptinternalcmdexec(const char* cmd)
     return res;
 }
 
+static CMDRESULT scriptprogramexec(SCRIPTPROGRAMLINE & line)
+{
+    switch(line.internal)
+    {
+    case scriptinternalret:
+        return scriptinternalret();
+    case scriptinternalinvalid:
+        return STATUS_ERROR;
+    case scriptinternalpause:
+        return STATUS_PAUSE;
+    case scriptinternalnop:
+        return STATUS_CONTINUE;
+    default:
+        break;
+    }
+    if(line.cmdgeneration != cmdgeneration()) //commands were (un)registered since the script was compiled
+        scriptcompilecommand(line);
+    if(!line.resolved) //needs run time formatting
+        return scriptinternalcmdexec(line.text.c_str());
+    //the callbacks receive copies, the compiled line stays untouched
+    char command[deflen] = "";
+    char args[deflen * 2] = "";
+    char* argv[deflen / 2 + 2];
+    strcpy_s(command, line.text.c_str());
+    memcpy(args, line.argdata.data(), line.argdata.size());
+    int argc = 1;
+    argv[0] = command;
+    for(auto offset : line.argoffsets)
+        argv[argc++] = args + offset;
+    argv[argc] = nullptr;
+    CMDRESULT res = cmdexec(line.cmd, argc, argv);
+    if(line.isvar) //var
+        return STATUS_CONTINUE;
+    while(DbgIsDebugging() && dbgisrunning()) //while not locked (NOTE: possible deadlock)
+        Sleep(10);
+    return res;
+}
+
 static bool scriptinternalbranch(SCRIPTBRANCHTYPE type) //determine if we should jump
 {
     duint ezflag = 0;
@@ -380,10 +514,11 @@ static bool scriptinternalbranch(SCRIPTBRANCHTYPE type) //determine if we should
 static bool scriptinternalcmd()
 {
     bool bContinue = true;
-    LINEMAPENTRY cur = linemap.at(scriptIp - 1);
+    const LINEMAPENTRY & cur = linemap.at(scriptIp - 1);
+    auto & line = program.at(scriptIp - 1);
     if(cur.type == linecommand)
     {
-        switch(scriptinternalcmdexec(cur.u.command))
+        switch(scriptprogramexec(line))
         {
         case STATUS_CONTINUE:
             break;
@@ -408,30 +543,37 @@ static bool scriptinternalcmd()
         if(cur.u.branch.type == scriptcall) //calls have a special meaning
             scriptstack.push_back(scriptIp);
         if(scriptinternalbranch(cur.u.branch.type))
-            scriptIp = scriptlabelfind(cur.u.branch.branchlabel);
+            scriptIp = line.jumpline;
     }
     return bContinue;
 }
 
-static DWORD WINAPI scriptRunThread(void* arg)
+static void scriptfastrefresh(bool final, bool updateViews)
 {
-    int destline = (int)(duint)arg;
-    if(!destline || destline > (int)linemap.size()) //invalid line
-        destline = 0;
-    if(destline)
+    dflushlog();
+    GuiScriptSetIp(scriptIp);
+    if(!updateViews)
+        return;
+    if(GuiIsUpdateDisabled())
+        GuiUpdateEnable(false);
+    if(DbgIsDebugging() && !dbgisrunning())
     {
-        destline = scriptinternalstep(destline - 1); //no breakpoints on non-executable locations
-        if(!scriptinternalbpget(destline)) //no breakpoint set
-            scriptinternalbptoggle(destline);
+        DebugUpdateGui(GetContextDataEx(hActiveThread, UE_CIP), true);
+        GuiUpdateMemoryView();
     }
-    bAbort = false;
-    if(scriptIp)
-        scriptIp--;
-    scriptIp = scriptinternalstep(scriptIp);
+    if(!final)
+        GuiUpdateDisable();
+}
+
+static duint scriptrunloop(bool yield, bool fast = false, bool updateViews = false)
+{
+    duint executed = 0;
+    DWORD lastRefresh = GetTickCount();
     bool bContinue = true;
     while(bContinue && !bAbort) //run loop
     {
         bContinue = scriptinternalcmd();
+        executed++;
         if(scriptIp == scriptinternalstep(scriptIp)) //end of script
         {
             bContinue = false;
@@ -441,8 +583,49 @@ static DWORD WINAPI scriptRunThread(void* arg)
             scriptIp = scriptinternalstep(scriptIp); //this is the next ip
         if(scriptinternalbpget(scriptIp)) //breakpoint=stop run loop
             bContinue = false;
-        Sleep(1); //don't fry the processor
+        if(fast)
+        {
+            if(fastModeInterval && GetTickCount() - lastRefresh >= fastModeInterval)
+            {
+                scriptfastrefresh(false, updateViews);
+                lastRefresh = GetTickCount();
+                Sleep(1); //give the GUI some time to process the refresh
+            }
+        }
+        else if(yield)
+            Sleep(1); //don't fry the processor
     }
+    return executed;
+}
+
+static DWORD WINAPI scriptRunThread(void* arg)
+{
+    int destline = (int)(duint)arg;
+    if(!destline || destline > (int)linemap.size()) //invalid line
+        destline = 0;
+    if(destline)
+    {
+        destline = scriptinternalstep(destline - 1); //no breakpoints on non-executable locations
+        if(!scriptinternalbpget(destline)) //no breakpoint set
+            scriptinternalbptoggle(destline);
+    }
+    bAbort = false;
+    if(scriptIp)
+        scriptIp--;
+    scriptIp = scriptinternalstep(scriptIp);
+    if(bFastMode)
+    {
+        //coalesce all GUI traffic, views are refreshed at most every fastModeInterval ms
+        bool updateViews = !GuiIsUpdateDisabled(); //respect guiupdatedisable
+        if(updateViews)
+            GuiUpdateDisable();
+        dbufferlog(true);
+        scriptrunloop(false, true, updateViews);
+        dbufferlog(false);
+        scriptfastrefresh(true, updateViews);
+    }
+    else
+        scriptrunloop(true);
     bIsRunning = false; //not running anymore
     GuiScriptSetIp(scriptIp);
     return 0;
@@ -483,6 +666,12 @@ void scriptunload()
     bAbort = false;
 }
 
+void scriptsetfastmode(bool enable, DWORD refreshInterval)
+{
+    bFastMode = enable;
+    fastModeInterval = refreshInterval;
+}
+
 void scriptrun(int destline)
 {
     if(DbgIsDebugging() && dbgisrunning())
@@ -643,3 +832,49 @@ CMDRESULT cbScriptMsgyn(int argc, char* argv[])
     varset("$RESULT", GuiScriptMsgyn(argv[1]), false);
     return STATUS_CONTINUE;
 }
+
+CMDRESULT cbScriptBench(int argc, char* argv[])
+{
+    if(bIsRunning)
+    {
+        dputs("a script is already running!");
+        return STATUS_ERROR;
+    }
+    if(linemap.empty())
+    {
+        dputs("no script loaded!");
+        return STATUS_ERROR;
+    }
+    bIsRunning = true;
+    bAbort = false;
+    std::vector<int>().swap(scriptstack);
+    scriptIp = scriptinternalstep(0);
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+    bIsBenchmark = true;
+    duint executed = scriptrunloop(false);
+    bIsBenchmark = false;
+    QueryPerformanceCounter(&end);
+    bIsRunning = false;
+    GuiScriptSetIp(scriptIp);
+    double seconds = double(end.QuadPart - start.QuadPart) / double(frequency.QuadPart);
+    dprintf("%" fext "u line(s) in %.3fs (%.0f lines/s)\n", executed, seconds, seconds > 0 ? double(executed) / seconds : 0.0);
+    return STATUS_CONTINUE;
+}
+
+CMDRESULT cbScriptFastMode(int argc, char* argv[])
+{
+    duint enable = 1;
+    duint interval = 33;
+    if(argc > 1 && !valfromstring(argv[1], &enable, false))
+        return STATUS_ERROR;
+    if(argc > 2 && !valfromstring(argv[2], &interval, false))
+        return STATUS_ERROR;
+    scriptsetfastmode(enable != 0, DWORD(interval));
+    if(enable)
+        dprintf("script fast mode enabled (GUI refresh %s)\n", interval ? StringUtils::sprintf("every %ums", DWORD(interval)).c_str() : "on stop only");
+    else
+        dputs("script fast mode disabled");
+    return STATUS_CONTINUE;
+}
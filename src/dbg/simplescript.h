@@ -27,6 +27,7 @@ struct LINEMAPENTRY
 void scriptload(const char* filename);
 void scriptunload();
 void scriptrun(int destline);
+void scriptsetfastmode(bool enable, DWORD refreshInterval);
 void scriptstep();
 bool scriptbptoggle(int line);
 bool scriptbpget(int line);
@@ -41,5 +42,7 @@ bool scriptgetbranchinfo(int line, SCRIPTBRANCH* info);
 CMDRESULT cbScriptLoad(int argc, char* argv[]);
 CMDRESULT cbScriptMsg(int argc, char* argv[]);
 CMDRESULT cbScriptMsgyn(int argc, char* argv[]);
+CMDRESULT cbScriptBench(int argc, char* argv[]);
+CMDRESULT cbScriptFastMode(int argc, char* argv[]);
 
 #endif // _SIMPLESCRIPT_H
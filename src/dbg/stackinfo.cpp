@@ -17,7 +17,12 @@
 using SehMap = std::unordered_map<duint, STACK_COMMENT>;
 static SehMap SehCache;
 
-void stackupdateseh()
+/**
+\brief Rebuilds the SEH stack comments.
+\param cancelled Optional, when it returns true the new comments are dropped.
+\return false if the update was cancelled.
+*/
+bool stackupdateseh(const std::function<bool()> & cancelled)
 {
     SehMap newcache;
     std::vector<duint> SEHList;
@@ -35,70 +40,116 @@ void stackupdateseh()
             newcache.insert({ SEHList[i], comment });
         }
     }
+    if(cancelled && cancelled())
+        return false;
     EXCLUSIVE_ACQUIRE(LockSehCache);
     SehCache = std::move(newcache);
+    return true;
 }
 
-bool stackcommentget(duint addr, STACK_COMMENT* comment)
+/**
+\brief Label and module lookups of one stack comment request, the same values tend to repeat on the stack.
+*/
+struct StackLookupCache
 {
-    SHARED_ACQUIRE(LockSehCache);
-    const auto found = SehCache.find(addr);
-    if(found != SehCache.end())
+    std::unordered_map<duint, String> labels; //address -> label
+    std::unordered_map<duint, String> modules; //module base -> module name
+};
+
+static const char* stacklabelget(duint addr, StackLookupCache & cache)
+{
+    auto found = cache.labels.find(addr);
+    if(found == cache.labels.end())
     {
-        *comment = found->second;
-        return true;
+        ADDRINFO addrinfo;
+        addrinfo.flags = flaglabel;
+        String label;
+        if(_dbg_addrinfoget(addr, SEG_DEFAULT, &addrinfo))
+            label = addrinfo.label;
+        found = cache.labels.insert(std::make_pair(addr, label)).first;
     }
-    SHARED_RELEASE();
+    return found->second.c_str();
+}
 
-    duint data = 0;
-    memset(comment, 0, sizeof(STACK_COMMENT));
-    MemRead(addr, &data, sizeof(duint));
-    if(!MemIsValidReadPtr(data)) //the stack value is no pointer
-        return false;
+static const char* stackmodnameget(duint addr, StackLookupCache & cache)
+{
+    duint base = ModBaseFromAddr(addr);
+    if(!base)
+        return "";
+    auto found = cache.modules.find(base);
+    if(found == cache.modules.end())
+    {
+        char module[MAX_MODULE_SIZE] = "";
+        ModNameFromAddr(addr, module, false);
+        found = cache.modules.insert(std::make_pair(base, String(module))).first;
+    }
+    return found->second.c_str();
+}
+
+//module.label, module.address or address
+static void stackaddrtext(duint addr, char* text, size_t textSize, StackLookupCache & cache)
+{
+    const char* label = stacklabelget(addr, cache);
+    const char* module = stackmodnameget(addr, cache);
+    char address[32];
+    if(!*label)
+    {
+        sprintf_s(address, fhex, addr);
+        label = address;
+    }
+    if(*module)
+        sprintf_s(text, textSize, "%s.%s", module, label);
+    else
+        strcpy_s(text, textSize, label);
+}
 
+/**
+\brief Checks if a value is a return address by decoding the call instruction that should end right before it.
+\param data The value on the stack.
+\param [out] call The call instruction.
+*/
+static bool stackisreturnaddr(duint data, BASIC_INSTRUCTION_INFO & call)
+{
+    const duint maxCallSize = 16;
     duint size = 0;
     duint base = MemFindBaseAddr(data, &size);
-    duint readStart = data - 16 * 4;
-    if(readStart < base)
-        readStart = base;
-    unsigned char disasmData[256];
-    MemRead(readStart, disasmData, sizeof(disasmData));
-    duint prev = disasmback(disasmData, 0, sizeof(disasmData), data - readStart, 1);
-    duint previousInstr = readStart + prev;
+    if(!base || data - base < 2)
+        return false;
+    duint readStart = data - min(maxCallSize, data - base);
+    // disasmfast always decodes MAX_DISASM_BUFFER bytes, the tail after the value is zeroed
+    unsigned char disasmData[maxCallSize + MAX_DISASM_BUFFER];
+    duint readSize = data - readStart;
+    if(!MemRead(readStart, disasmData, readSize))
+        return false;
+    memset(disasmData + readSize, 0, sizeof(disasmData) - readSize);
+    // Up to 16 bytes (the longest instruction) are read, but the calls that are tried
+    // are 2 (call reg) to 10 bytes long, the common encodings go first
+    static const duint callSizes[] = { 5, 6, 2, 3, 7, 4, 8, 9, 10 };
+    for(auto callSize : callSizes)
+    {
+        if(callSize > readSize)
+            continue;
+        if(disasmfast(disasmData + readSize - callSize, data - callSize, &call) && call.call && duint(call.size) == callSize)
+            return true;
+    }
+    return false;
+}
+
+static bool stackcommentfromvalue(duint data, STACK_COMMENT* comment, StackLookupCache & cache)
+{
+    memset(comment, 0, sizeof(STACK_COMMENT));
+    if(!MemIsValidReadPtr(data)) //the stack value is no pointer
+        return false;
 
     BASIC_INSTRUCTION_INFO basicinfo;
-    bool valid = disasmfast(disasmData + prev, previousInstr, &basicinfo);
-    if(valid && basicinfo.call) //call
+    if(stackisreturnaddr(data, basicinfo)) //call
     {
-        char label[MAX_LABEL_SIZE] = "";
-        ADDRINFO addrinfo;
-        addrinfo.flags = flaglabel;
-        if(_dbg_addrinfoget(data, SEG_DEFAULT, &addrinfo))
-            strcpy_s(label, addrinfo.label);
-        char module[MAX_MODULE_SIZE] = "";
-        ModNameFromAddr(data, module, false);
         char returnToAddr[MAX_COMMENT_SIZE] = "";
-        if(*module)
-            sprintf(returnToAddr, "%s.", module);
-        if(!*label)
-            sprintf(label, fhex, data);
-        strcat(returnToAddr, label);
-
-        data = basicinfo.addr;
-        if(data)
+        stackaddrtext(data, returnToAddr, sizeof(returnToAddr), cache);
+        if(basicinfo.addr)
         {
-            *label = 0;
-            addrinfo.flags = flaglabel;
-            if(_dbg_addrinfoget(data, SEG_DEFAULT, &addrinfo))
-                strcpy_s(label, addrinfo.label);
-            *module = 0;
-            ModNameFromAddr(data, module, false);
             char returnFromAddr[MAX_COMMENT_SIZE] = "";
-            if(*module)
-                sprintf(returnFromAddr, "%s.", module);
-            if(!*label)
-                sprintf(label, fhex, data);
-            strcat_s(returnFromAddr, label);
+            stackaddrtext(basicinfo.addr, returnFromAddr, sizeof(returnFromAddr), cache);
             sprintf_s(comment->comment, "return to %s from %s", returnToAddr, returnFromAddr);
         }
         else
@@ -116,31 +167,100 @@ bool stackcommentget(duint addr, STACK_COMMENT* comment)
     }
 
     //label
-    char label[MAX_LABEL_SIZE] = "";
-    ADDRINFO addrinfo;
-    addrinfo.flags = flaglabel;
-    if(_dbg_addrinfoget(data, SEG_DEFAULT, &addrinfo))
-        strcpy_s(label, addrinfo.label);
-    char module[MAX_MODULE_SIZE] = "";
-    ModNameFromAddr(data, module, false);
+    const char* label = stacklabelget(data, cache);
+    const char* module = stackmodnameget(data, cache);
 
     if(*module) //module
     {
         if(*label) //+label
-            sprintf(comment->comment, "%s.%s", module, label);
+            sprintf_s(comment->comment, "%s.%s", module, label);
         else //module only
-            sprintf(comment->comment, "%s." fhex, module, data);
+            sprintf_s(comment->comment, "%s." fhex, module, data);
         return true;
     }
     else if(*label) //label only
     {
-        sprintf(comment->comment, "<%s>", label);
+        sprintf_s(comment->comment, "<%s>", label);
         return true;
     }
 
     return false;
 }
 
+bool stackcommentget(duint addr, STACK_COMMENT* comment)
+{
+    SHARED_ACQUIRE(LockSehCache);
+    const auto found = SehCache.find(addr);
+    if(found != SehCache.end())
+    {
+        *comment = found->second;
+        return true;
+    }
+    SHARED_RELEASE();
+
+    duint data = 0;
+    memset(comment, 0, sizeof(STACK_COMMENT));
+    MemRead(addr, &data, sizeof(duint));
+    StackLookupCache cache;
+    return stackcommentfromvalue(data, comment, cache);
+}
+
+/**
+\brief Annotates a window of stack slots at once: one read of the window, label and module lookups shared between the slots.
+\param addr Address of the first slot.
+\param count Number of slots.
+\param [out] annotations count annotations.
+\return false if nothing could be read.
+*/
+bool stackannotationsget(duint addr, duint count, STACK_ANNOTATION* annotations)
+{
+    if(!count || !annotations)
+        return false;
+    std::vector<duint> values(count);
+    std::vector<bool> readable(count, true);
+    if(!MemRead(addr, values.data(), count * sizeof(duint)))
+    {
+        // The window crosses the bounds of the stack, read the slots that are there
+        bool anyRead = false;
+        for(duint i = 0; i < count; i++)
+        {
+            readable[i] = MemRead(addr + i * sizeof(duint), &values[i], sizeof(duint));
+            anyRead |= readable[i];
+        }
+        if(!anyRead)
+            return false;
+    }
+
+    StackLookupCache cache;
+    SHARED_ACQUIRE(LockSehCache);
+    for(duint i = 0; i < count; i++)
+    {
+        auto & annotation = annotations[i];
+        duint slot = addr + i * sizeof(duint);
+        annotation.hasLabel = *stacklabelget(slot, cache) != '\0';
+        const auto found = SehCache.find(slot);
+        if(found != SehCache.end())
+        {
+            annotation.comment = found->second;
+            annotation.hasComment = true;
+        }
+        else
+            annotation.hasComment = false;
+    }
+    SHARED_RELEASE();
+    for(duint i = 0; i < count; i++)
+    {
+        auto & annotation = annotations[i];
+        if(annotation.hasComment)
+            continue;
+        if(readable[i])
+            annotation.hasComment = stackcommentfromvalue(values[i], &annotation.comment, cache);
+        else
+            memset(&annotation.comment, 0, sizeof(annotation.comment));
+    }
+    return true;
+}
+
 BOOL CALLBACK StackReadProcessMemoryProc64(HANDLE hProcess, DWORD64 lpBaseAddress, PVOID lpBuffer, DWORD nSize, LPDWORD lpNumberOfBytesRead)
 {
     // Fix for 64-bit sizes
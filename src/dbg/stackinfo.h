@@ -2,6 +2,7 @@
 #define _STACKINFO_H
 
 #include "_global.h"
+#include "_dbgfunctions.h"
 
 struct CALLSTACKENTRY
 {
@@ -17,8 +18,9 @@ struct CALLSTACK
     CALLSTACKENTRY* entries;
 };
 
-void stackupdateseh();
+bool stackupdateseh(const std::function<bool()> & cancelled = nullptr);
 bool stackcommentget(duint addr, STACK_COMMENT* comment);
+bool stackannotationsget(duint addr, duint count, STACK_ANNOTATION* annotations);
 void stackgetcallstack(duint csp, CALLSTACK* callstack);
 
 #endif //_STACKINFO_H
\ No newline at end of file
@@ -2,61 +2,63 @@
 #include "value.h"
 #include "symbolinfo.h"
 
-namespace ValueType
+static void appendValue(String & output, duint valuint, ValueType::ValueType type)
 {
-    enum ValueType
-    {
-        Unknown,
-        SignedDecimal,
-        UnsignedDecimal,
-        Hex,
-        Pointer,
-        String,
-        AddrInfo
-    };
-}
-
-static String printValue(FormatValueType value, ValueType::ValueType type)
-{
-    duint valuint = 0;
     char string[MAX_STRING_SIZE] = "";
-    String result = "???";
-    if(valfromstring(value, &valuint))
+    switch(type)
+    {
+    case ValueType::SignedDecimal:
+        sprintf_s(string, "%" fext "d", valuint);
+        output += string;
+        break;
+    case ValueType::UnsignedDecimal:
+        sprintf_s(string, "%" fext "u", valuint);
+        output += string;
+        break;
+    case ValueType::Hex:
+        sprintf_s(string, "%" fext "X", valuint);
+        output += string;
+        break;
+    case ValueType::Pointer:
+        sprintf_s(string, fhex, valuint);
+        output += string;
+        break;
+    case ValueType::String:
+        if(DbgGetStringAt(valuint, string))
+            output += string;
+        else
+            output += "???";
+        break;
+    case ValueType::AddrInfo:
     {
-        switch(type)
+        sprintf_s(string, fhex, valuint);
+        output += string;
+        if(DbgGetStringAt(valuint, string))
         {
-        case ValueType::Unknown:
-            break;
-        case ValueType::SignedDecimal:
-            result = StringUtils::sprintf("%" fext "d", valuint);
-            break;
-        case ValueType::UnsignedDecimal:
-            result = StringUtils::sprintf("%" fext "u", valuint);
-            break;
-        case ValueType::Hex:
-            result = StringUtils::sprintf("%" fext "X", valuint);
-            break;
-        case ValueType::Pointer:
-            result = StringUtils::sprintf(fhex, valuint);
-            break;
-        case ValueType::String:
-            if(DbgGetStringAt(valuint, string))
-                result = string;
-            break;
-        case ValueType::AddrInfo:
+            output += " ";
+            output += string;
+        }
+        else
         {
             auto symbolic = SymGetSymbolicName(valuint);
-            result = StringUtils::sprintf(fhex, valuint);
-            if(DbgGetStringAt(valuint, string))
-                result += " " + String(string);
-            else if(symbolic.length())
-                result += " " + symbolic;
+            if(symbolic.length())
+                output += " " + symbolic;
         }
+    }
+    break;
+    default:
+        output += "???";
         break;
-        default:
-            break;
-        }
     }
+}
+
+static String printValue(FormatValueType value, ValueType::ValueType type)
+{
+    duint valuint = 0;
+    if(!valfromstring(value, &valuint))
+        return "???";
+    String result;
+    appendValue(result, valuint, type);
     return result;
 }
 
@@ -164,58 +166,111 @@ String stringformat(String format, const FormatValueVector & values)
     return output;
 }
 
-static String handleFormatStringInline(const String & formatString)
+StringFormatTemplate::StringFormatTemplate(const String & format)
 {
-    auto type = ValueType::Unknown;
-    auto value = getArgExpressionType(formatString, type);
-    if(value && *value)
-        return printValue(value, type);
-    return "[Formatting Error]";
-}
-
-String stringformatinline(String format)
-{
-    StringUtils::ReplaceAll(format, "\\n", "\n");
-    int len = (int)format.length();
-    String output;
+    String text = format;
+    StringUtils::ReplaceAll(text, "\\n", "\n");
+    int len = (int)text.length();
+    String literal;
     String formatString;
     bool inFormatter = false;
     for(int i = 0; i < len; i++)
     {
         //handle escaped format sequences "{{" and "}}"
-        if(format[i] == '{' && (i + 1 < len && format[i + 1] == '{'))
+        if(text[i] == '{' && (i + 1 < len && text[i + 1] == '{'))
         {
-            output += "{";
+            literal += "{";
             i++;
             continue;
         }
-        if(format[i] == '}' && (i + 1 < len && format[i + 1] == '}'))
+        if(text[i] == '}' && (i + 1 < len && text[i + 1] == '}'))
         {
-            output += "}";
+            literal += "}";
             i++;
             continue;
         }
         //handle actual formatting
-        if(format[i] == '{' && !inFormatter)  //opening bracket
+        if(text[i] == '{' && !inFormatter)  //opening bracket
         {
             inFormatter = true;
             formatString.clear();
         }
-        else if(format[i] == '}' && inFormatter)  //closing bracket
+        else if(text[i] == '}' && inFormatter)  //closing bracket
         {
             inFormatter = false;
             if(formatString.length())
             {
-                output += handleFormatStringInline(formatString);
+                addLiteral(literal);
+                literal.clear();
+                addField(formatString);
                 formatString.clear();
             }
         }
         else if(inFormatter)  //inside brackets
-            formatString += format[i];
+            formatString += text[i];
         else //outside brackets
-            output += format[i];
+            literal += text[i];
     }
+    addLiteral(literal);
     if(inFormatter && formatString.size())
-        output += handleFormatStringInline(formatString);
+        addField(formatString);
+}
+
+void StringFormatTemplate::addLiteral(const String & text)
+{
+    if(text.empty())
+        return;
+    if(mSegments.empty() || mSegments.back().field != -1)
+    {
+        Segment segment;
+        segment.field = -1;
+        mSegments.push_back(segment);
+    }
+    mSegments.back().literal += text;
+}
+
+void StringFormatTemplate::addField(const String & formatString)
+{
+    auto type = ValueType::Unknown;
+    auto value = getArgExpressionType(formatString, type);
+    if(!value || !*value)
+    {
+        addLiteral("[Formatting Error]");
+        return;
+    }
+    if(mSegments.empty() || mSegments.back().field != -1)
+    {
+        Segment segment;
+        segment.field = -1;
+        mSegments.push_back(segment);
+    }
+    mSegments.back().field = int(mFields.size());
+    mFields.push_back(Field(type, value));
+}
+
+/**
+\brief Appends the formatted text to output. Only the fields are evaluated, so output can be reused between calls to avoid allocations.
+*/
+void StringFormatTemplate::Format(String & output) const
+{
+    auto signedcalc = valuesignedcalc();
+    for(const auto & segment : mSegments)
+    {
+        output += segment.literal;
+        if(segment.field == -1)
+            continue;
+        const auto & field = mFields[segment.field];
+        duint value;
+        if(field.expression.Calculate(value, signedcalc))
+            appendValue(output, value, field.type);
+        else
+            output += "???";
+    }
+}
+
+String stringformatinline(String format)
+{
+    String output;
+    StringFormatTemplate(format).Format(output);
     return output;
-}
\ No newline at end of file
+}
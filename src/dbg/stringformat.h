@@ -2,10 +2,58 @@
 #define _STRINGFORMAT_H
 
 #include "_global.h"
+#include "expressionparser.h"
 
 typedef const char* FormatValueType;
 typedef std::vector<FormatValueType> FormatValueVector;
 
+namespace ValueType
+{
+    enum ValueType
+    {
+        Unknown,
+        SignedDecimal,
+        UnsignedDecimal,
+        Hex,
+        Pointer,
+        String,
+        AddrInfo
+    };
+}
+
+/**
+\brief An inline format string (like a breakpoint log text) compiled into literal segments
+and pre-parsed expression fields, so formatting it only evaluates the fields.
+*/
+class StringFormatTemplate
+{
+public:
+    explicit StringFormatTemplate(const String & format);
+    void Format(String & output) const;
+
+private:
+    struct Segment
+    {
+        String literal; //text before the field
+        int field; //index in mFields, -1 if there is none
+    };
+
+    struct Field
+    {
+        ValueType::ValueType type;
+        ExpressionParser expression;
+
+        Field(ValueType::ValueType type, const String & expression)
+            : type(type), expression(expression) { }
+    };
+
+    void addLiteral(const String & text);
+    void addField(const String & formatString);
+
+    std::vector<Segment> mSegments;
+    std::vector<Field> mFields;
+};
+
 String stringformat(String format, const FormatValueVector & values);
 String stringformatinline(String format);
 
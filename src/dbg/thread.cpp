@@ -8,7 +8,50 @@
 #include "memory.h"
 #include "threading.h"
 
-static std::unordered_map<DWORD, THREADINFO> threadList;
+struct THREADSTATE
+{
+    THREADINFO BasicInfo;
+    int SuspendCount; //tracked by ThreadSuspend/ThreadResume, never probed
+    unsigned int Generation; //snapshot generation the details below were fetched in
+    duint ThreadCip;
+    THREADPRIORITY Priority;
+    DWORD LastError;
+};
+
+static std::unordered_map<DWORD, THREADSTATE> threadList;
+
+// Thread details are fetched at most once per snapshot generation, which changes on every debug event
+static unsigned int snapshotGeneration = 1;
+
+static int probeSuspendCount(HANDLE Thread)
+{
+    // Only used once per thread, while the debuggee is stopped for its creation event
+    int suspendCount = (int)SuspendThread(Thread);
+    if(suspendCount == -1)
+        return 0;
+    ResumeThread(Thread);
+    return suspendCount;
+}
+
+static void updateSnapshot(THREADSTATE & State)
+{
+    if(State.Generation == snapshotGeneration)
+        return;
+    State.ThreadCip = GetContextDataEx(State.BasicInfo.Handle, UE_CIP);
+    State.Priority = ThreadGetPriority(State.BasicInfo.Handle);
+    State.LastError = ThreadGetLastErrorTEB(State.BasicInfo.ThreadLocalBase);
+    State.Generation = snapshotGeneration;
+}
+
+static void getAllInfo(const THREADSTATE & State, THREADALLINFO & Info)
+{
+    memcpy(&Info.BasicInfo, &State.BasicInfo, sizeof(THREADINFO));
+    Info.ThreadCip = State.ThreadCip;
+    Info.SuspendCount = State.SuspendCount;
+    Info.Priority = State.Priority;
+    Info.WaitReason = ThreadGetWaitReason(State.BasicInfo.Handle);
+    Info.LastError = State.LastError;
+}
 
 void ThreadCreate(CREATE_THREAD_DEBUG_INFO* CreateThread)
 {
@@ -28,9 +71,14 @@ void ThreadCreate(CREATE_THREAD_DEBUG_INFO* CreateThread)
     if(curInfo.ThreadNumber <= 0)
         strcpy_s(curInfo.threadName, "Main Thread");
 
+    THREADSTATE state;
+    memset(&state, 0, sizeof(THREADSTATE));
+    state.BasicInfo = curInfo;
+    state.SuspendCount = probeSuspendCount(curInfo.Handle);
+
     // Modify global thread list
     EXCLUSIVE_ACQUIRE(LockThreads);
-    threadList.insert(std::make_pair(curInfo.ThreadId, curInfo));
+    threadList.insert(std::make_pair(curInfo.ThreadId, state));
     EXCLUSIVE_RELEASE();
 
     // Notify GUI
@@ -46,7 +94,7 @@ void ThreadExit(DWORD ThreadId)
 
     if(itr != threadList.end())
     {
-        CloseHandle(itr->second.Handle);
+        CloseHandle(itr->second.BasicInfo.Handle);
         threadList.erase(itr);
     }
 
@@ -60,7 +108,7 @@ void ThreadClear()
 
     // Close all handles first
     for(auto & itr : threadList)
-        CloseHandle(itr.second.Handle);
+        CloseHandle(itr.second.BasicInfo.Handle);
 
     // Empty the array
     threadList.clear();
@@ -79,7 +127,9 @@ int ThreadGetCount()
 void ThreadGetList(THREADLIST* List)
 {
     ASSERT_NONNULL(List);
-    SHARED_ACQUIRE(LockThreads);
+
+    // Stale snapshot entries are refreshed, so an exclusive lock is required
+    EXCLUSIVE_ACQUIRE(LockThreads);
 
     //
     // This function converts a C++ std::unordered_map to a C-style THREADLIST[].
@@ -99,23 +149,58 @@ void ThreadGetList(THREADLIST* List)
 
     for(auto & itr : threadList)
     {
-        HANDLE threadHandle = itr.second.Handle;
-
         // Get the debugger's active thread index
-        if(threadHandle == hActiveThread)
+        if(itr.second.BasicInfo.Handle == hActiveThread)
             List->CurrentThread = index;
 
-        memcpy(&List->list[index].BasicInfo, &itr.second, sizeof(THREADINFO));
-
-        List->list[index].ThreadCip = GetContextDataEx(threadHandle, UE_CIP);
-        List->list[index].SuspendCount = ThreadGetSuspendCount(threadHandle);
-        List->list[index].Priority = ThreadGetPriority(threadHandle);
-        List->list[index].WaitReason = ThreadGetWaitReason(threadHandle);
-        List->list[index].LastError = ThreadGetLastErrorTEB(itr.second.ThreadLocalBase);
+        updateSnapshot(itr.second);
+        getAllInfo(itr.second, List->list[index]);
         index++;
     }
 }
 
+/**
+\brief Gets the basic information of all threads, without touching the threads themselves.
+\param [out] List The basic thread information.
+\return The index of the active thread in List, -1 if it is not in the list.
+*/
+int ThreadGetList(std::vector<THREADINFO> & List)
+{
+    SHARED_ACQUIRE(LockThreads);
+
+    int currentThread = -1;
+    List.clear();
+    List.reserve(threadList.size());
+    for(auto & itr : threadList)
+    {
+        if(itr.second.BasicInfo.Handle == hActiveThread)
+            currentThread = int(List.size());
+        List.push_back(itr.second.BasicInfo);
+    }
+    return currentThread;
+}
+
+/**
+\brief Gets all information of a single thread, fetching its details only when they are stale.
+*/
+bool ThreadGetDetails(DWORD ThreadId, THREADALLINFO* Info)
+{
+    EXCLUSIVE_ACQUIRE(LockThreads);
+
+    auto found = threadList.find(ThreadId);
+    if(found == threadList.end())
+        return false;
+    updateSnapshot(found->second);
+    getAllInfo(found->second, *Info);
+    return true;
+}
+
+void ThreadInvalidateSnapshot()
+{
+    EXCLUSIVE_ACQUIRE(LockThreads);
+    snapshotGeneration++;
+}
+
 bool ThreadIsValid(DWORD ThreadId)
 {
     SHARED_ACQUIRE(LockThreads);
@@ -139,19 +224,48 @@ bool ThreadGetTeb(duint TEBAddress, TEB* Teb)
 
 int ThreadGetSuspendCount(HANDLE Thread)
 {
-    //
-    // Suspend a thread in order to get the previous suspension count
-    // WARNING: This function is very bad (threads should not be randomly interrupted)
-    //
-    int suspendCount = (int)SuspendThread(Thread);
+    SHARED_ACQUIRE(LockThreads);
 
-    if(suspendCount == -1)
-        return 0;
+    for(auto & entry : threadList)
+    {
+        if(entry.second.BasicInfo.Handle == Thread)
+            return entry.second.SuspendCount;
+    }
+    return 0;
+}
 
-    // Resume the thread's normal execution
-    ResumeThread(Thread);
+/**
+\brief Suspends a thread and updates the suspend count the debugger tracks for it.
+\return The previous suspend count, -1 on failure (like SuspendThread).
+*/
+int ThreadSuspend(DWORD ThreadId)
+{
+    EXCLUSIVE_ACQUIRE(LockThreads);
 
-    return suspendCount;
+    auto found = threadList.find(ThreadId);
+    if(found == threadList.end())
+        return -1;
+    int previous = (int)SuspendThread(found->second.BasicInfo.Handle);
+    if(previous != -1)
+        found->second.SuspendCount = previous + 1;
+    return previous;
+}
+
+/**
+\brief Resumes a thread and updates the suspend count the debugger tracks for it.
+\return The previous suspend count, -1 on failure (like ResumeThread).
+*/
+int ThreadResume(DWORD ThreadId)
+{
+    EXCLUSIVE_ACQUIRE(LockThreads);
+
+    auto found = threadList.find(ThreadId);
+    if(found == threadList.end())
+        return -1;
+    int previous = (int)ResumeThread(found->second.BasicInfo.Handle);
+    if(previous != -1)
+        found->second.SuspendCount = previous ? previous - 1 : 0;
+    return previous;
 }
 
 THREADPRIORITY ThreadGetPriority(HANDLE Thread)
@@ -182,7 +296,7 @@ DWORD ThreadGetLastError(DWORD ThreadId)
     SHARED_ACQUIRE(LockThreads);
 
     if(threadList.find(ThreadId) != threadList.end())
-        return ThreadGetLastErrorTEB(threadList[ThreadId].ThreadLocalBase);
+        return ThreadGetLastErrorTEB(threadList[ThreadId].BasicInfo.ThreadLocalBase);
 
     ASSERT_ALWAYS("Trying to get last error of a thread that doesn't exist!");
     return 0;
@@ -198,7 +312,7 @@ bool ThreadSetName(DWORD ThreadId, const char* Name)
         if(!Name)
             Name = "";
 
-        strcpy_s(threadList[ThreadId].threadName, Name);
+        strcpy_s(threadList[ThreadId].BasicInfo.threadName, Name);
         return true;
     }
 
@@ -210,7 +324,7 @@ HANDLE ThreadGetHandle(DWORD ThreadId)
     SHARED_ACQUIRE(LockThreads);
 
     if(threadList.find(ThreadId) != threadList.end())
-        return threadList[ThreadId].Handle;
+        return threadList[ThreadId].BasicInfo.Handle;
 
     ASSERT_ALWAYS("Trying to get handle of a thread that doesn't exist!");
     return nullptr;
@@ -223,7 +337,7 @@ DWORD ThreadGetId(HANDLE Thread)
     // Search for the ID in the local list
     for(auto & entry : threadList)
     {
-        if(entry.second.Handle == Thread)
+        if(entry.second.BasicInfo.Handle == Thread)
             return entry.first;
     }
 
@@ -235,14 +349,18 @@ DWORD ThreadGetId(HANDLE Thread)
 
 int ThreadSuspendAll()
 {
-    // SuspendThread does not modify any internal variables
-    SHARED_ACQUIRE(LockThreads);
+    // Modifies the tracked suspend counts, so an exclusive lock is required
+    EXCLUSIVE_ACQUIRE(LockThreads);
 
     int count = 0;
     for(auto & entry : threadList)
     {
-        if(SuspendThread(entry.second.Handle) != -1)
+        int previous = (int)SuspendThread(entry.second.BasicInfo.Handle);
+        if(previous != -1)
+        {
+            entry.second.SuspendCount = previous + 1;
             count++;
+        }
     }
 
     return count;
@@ -250,14 +368,18 @@ int ThreadSuspendAll()
 
 int ThreadResumeAll()
 {
-    // ResumeThread does not modify any internal variables
-    SHARED_ACQUIRE(LockThreads);
+    // Modifies the tracked suspend counts, so an exclusive lock is required
+    EXCLUSIVE_ACQUIRE(LockThreads);
 
     int count = 0;
     for(auto & entry : threadList)
     {
-        if(ResumeThread(entry.second.Handle) != -1)
+        int previous = (int)ResumeThread(entry.second.BasicInfo.Handle);
+        if(previous != -1)
+        {
+            entry.second.SuspendCount = previous ? previous - 1 : 0;
             count++;
+        }
     }
 
     return count;
@@ -267,5 +389,5 @@ ULONG_PTR ThreadGetLocalBase(DWORD ThreadId)
 {
     SHARED_ACQUIRE(LockThreads);
     auto found = threadList.find(ThreadId);
-    return found != threadList.end() ? found->second.ThreadLocalBase : 0;
+    return found != threadList.end() ? found->second.BasicInfo.ThreadLocalBase : 0;
 }
\ No newline at end of file
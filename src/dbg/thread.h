@@ -9,11 +9,16 @@ void ThreadExit(DWORD ThreadId);
 void ThreadClear();
 int ThreadGetCount();
 void ThreadGetList(THREADLIST* list);
+int ThreadGetList(std::vector<THREADINFO> & list);
+bool ThreadGetDetails(DWORD ThreadId, THREADALLINFO* Info);
+void ThreadInvalidateSnapshot();
 bool ThreadIsValid(DWORD ThreadId);
 bool ThreadSetName(DWORD ThreadId, const char* name);
 bool ThreadGetTib(duint TEBAddress, NT_TIB* Tib);
 bool ThreadGetTeb(duint TEBAddress, TEB* Teb);
 int ThreadGetSuspendCount(HANDLE Thread);
+int ThreadSuspend(DWORD ThreadId);
+int ThreadResume(DWORD ThreadId);
 THREADPRIORITY ThreadGetPriority(HANDLE Thread);
 THREADWAITREASON ThreadGetWaitReason(HANDLE Thread);
 DWORD ThreadGetLastErrorTEB(ULONG_PTR ThreadLocalBase);
@@ -59,6 +59,10 @@ enum SectionLock
     LockCrossReferences,
     LockDebugStartStop,
     LockArguments,
+    LockCommands,
+    LockConsole,
+    LockTraceRecordCounters,
+    LockHandles,
 
     // Number of elements in this enumeration. Must always be the last
     // index.
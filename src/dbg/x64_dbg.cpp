@@ -190,6 +190,7 @@ static void registercommands()
     dbgcmdnew("bookmarkc\1bookmarkdel", cbInstrBookmarkDel, true); //delete bookmark
     dbgcmdnew("savedb\1dbsave", cbInstrSavedb, true); //save program database
     dbgcmdnew("loaddb\1dbload", cbInstrLoaddb, true); //load program database
+    dbgcmdnew("exportdb\1dbexport", cbInstrExportdb, true); //export program database as JSON
     dbgcmdnew("functionadd\1func", cbInstrFunctionAdd, true); //function
     dbgcmdnew("functiondel\1funcc", cbInstrFunctionDel, true); //function
     dbgcmdnew("commentlist", cbInstrCommentList, true); //list comments
@@ -234,6 +235,8 @@ static void registercommands()
     dbgcmdnew("scriptload", cbScriptLoad, false);
     dbgcmdnew("msg", cbScriptMsg, false);
     dbgcmdnew("msgyn", cbScriptMsgyn, false);
+    dbgcmdnew("scriptbench", cbScriptBench, false); //run the loaded script without yielding and report lines/s
+    dbgcmdnew("scriptfastmode", cbScriptFastMode, false); //coalesce GUI updates while running scripts [arg1:enable,arg2:refresh interval]
     dbgcmdnew("log", cbInstrLog, false); //log command with superawesome hax
 
     //data
@@ -247,6 +250,7 @@ static void registercommands()
     dbgcmdnew("yara", cbInstrYara, true); //yara test command
     dbgcmdnew("yaramod", cbInstrYaramod, true); //yara rule on module
     dbgcmdnew("analyse\1analyze\1anal", cbInstrAnalyse, true); //secret analysis command
+    dbgcmdnew("tracecoverage", cbInstrTraceCoverage, true); //export trace record coverage (drcov + CSV) arg1:export,[arg2:output path]
 
     //undocumented
     dbgcmdnew("bench", cbDebugBenchmark, true); //benchmark test (readmem etc)
@@ -277,15 +281,31 @@ static void registercommands()
     dbgcmdnew("analxrefs\1analx", cbInstrAnalxrefs, true); //analyze xrefs
     dbgcmdnew("guiupdatedisable", cbInstrDisableGuiUpdate, true); //disable gui message
     dbgcmdnew("guiupdateenable", cbInstrEnableGuiUpdate, true); //enable gui message
+    dbgcmdnew("cmdbench\1benchcmd", cbInstrCommandBenchmark, false); //command dispatch benchmark arg1:count,arg2:command
+    dbgcmdnew("guibench\1benchgui", cbInstrGuiBenchmark, true); //debugger -> GUI round trip latency benchmark [arg1:count]
+    dbgcmdnew("stackworkerbench\1benchstackworker", cbInstrStackWorkerBenchmark, false); //stress the stop -> stack walk worker [arg1:count]
+    dbgcmdnew("paintbench\1benchpaint", cbInstrPaintBenchmark, true); //paint a 100-row disassembly page offscreen [arg1:count]
+    dbgcmdnew("msgqueuebench\1benchmsgqueue", cbInstrMsgQueueBenchmark, false); //command queue throughput benchmark [arg1:count, arg2:producers]
 }
 
 static bool cbCommandProvider(char* cmd, int maxlen)
 {
-    MESSAGE msg;
-    MsgWait(gMsgStack, &msg);
-    if(bStopCommandLoopThread)
+    // Commands are drained from the queue in batches, only the command loop thread touches these
+    static MESSAGE batch[32];
+    static int batchCount = 0;
+    static int batchIndex = 0;
+    if(batchIndex == batchCount)
+    {
+        batchCount = MsgWaitBatch(gMsgStack, batch, _countof(batch));
+        batchIndex = 0;
+    }
+    if(bStopCommandLoopThread || !batchCount)
+    {
+        for(; batchIndex < batchCount; batchIndex++)
+            efree((char*)batch[batchIndex].param1, "cbCommandProvider:newcmd");
         return false;
-    char* newcmd = (char*)msg.param1;
+    }
+    char* newcmd = (char*)batch[batchIndex++].param1;
     if(strlen(newcmd) >= deflen)
     {
         dprintf("command cut at ~%d characters\n", deflen);
@@ -301,7 +321,12 @@ extern "C" DLL_EXPORT bool _dbg_dbgcmdexec(const char* cmd)
     int len = (int)strlen(cmd);
     char* newcmd = (char*)emalloc((len + 1) * sizeof(char), "_dbg_dbgcmdexec:newcmd");
     strcpy_s(newcmd, len + 1, cmd);
-    return MsgSend(gMsgStack, 0, (duint)newcmd, 0);
+    if(!MsgSend(gMsgStack, 0, (duint)newcmd, 0)) //the debugger is shutting down
+    {
+        efree(newcmd, "_dbg_dbgcmdexec:newcmd");
+        return false;
+    }
+    return true;
 }
 
 static DWORD WINAPI DbgCommandLoopThread(void* a)
@@ -396,6 +421,7 @@ extern "C" DLL_EXPORT const char* _dbg_dbginit()
     if(sizeof(TITAN_ENGINE_CONTEXT_t) != sizeof(REGISTERCONTEXT))
         return "Invalid REGISTERCONTEXT alignment!";
 
+    dlogconfigure();
     dputs("Initializing wait objects...");
     waitinitialize();
     dputs("Initializing debugger...");
@@ -549,8 +575,9 @@ extern "C" DLL_EXPORT void _dbg_dbgexitsignal()
     pluginunload();
     dputs("Stopping command thread...");
     bStopCommandLoopThread = true;
-    MsgFreeStack(gMsgStack);
+    MsgAbort(gMsgStack);
     WaitForThreadTermination(hCommandLoopThread);
+    MsgFreeStack(gMsgStack);
     dputs("Cleaning up allocated data...");
     cmdfree();
     varfree();
@@ -575,6 +602,7 @@ extern "C" DLL_EXPORT void _dbg_dbgexitsignal()
     }
     else
         DeleteFileW(StringUtils::Utf8ToUtf16(notesFile).c_str());
+    dlogstop();
     dputs("Exit signal processed successfully!");
     bIsStopped = true;
 }
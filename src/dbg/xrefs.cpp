@@ -12,6 +12,16 @@ struct XrefSerializer : AddrInfoSerializer<XREFSINFO>
     bool Save(const XREFSINFO & value) override
     {
         AddrInfoSerializer::Save(value);
+        if(isBinary())
+        {
+            //the binary database stores the references as a packed XREF_RECORD array
+            std::vector<XREF_RECORD> references;
+            references.reserve(value.references.size());
+            for(const auto & itr : value.references)
+                references.push_back(itr.second);
+            setBlob("references", references.data(), references.size() * sizeof(XREF_RECORD));
+            return true;
+        }
         auto references = json_array();
         for(const auto & itr : value.references)
         {
@@ -28,6 +38,23 @@ struct XrefSerializer : AddrInfoSerializer<XREFSINFO>
     {
         if(!AddrInfoSerializer::Load(value))
             return false;
+        value.references.clear();
+        if(isBinary())
+        {
+            const void* data;
+            size_t size;
+            if(!getBlob("references", data, size) || size % sizeof(XREF_RECORD))
+                return false;
+            value.type = XREF_DATA;
+            for(size_t i = 0; i < size / sizeof(XREF_RECORD); i++)
+            {
+                XREF_RECORD record;
+                memcpy(&record, (const char*)data + i * sizeof(XREF_RECORD), sizeof(record));
+                value.type = max(record.type, value.type);
+                value.references.insert({ record.addr, record });
+            }
+            return true;
+        }
         auto references = get("references");
         if(!references)
             return false;
@@ -94,6 +121,7 @@ bool XrefAdd(duint Address, duint From)
         found->second.references.insert({ xrefRecord.addr, xrefRecord });
         found->second.type = max(found->second.type, xrefRecord.type);
     }
+    xrefs.MarkDirty();
     return true;
 }
 
@@ -153,6 +181,21 @@ void XrefCacheLoad(JSON Root)
     xrefs.CacheLoad(Root);
 }
 
+void XrefCacheSave(DbFileWriter & Writer)
+{
+    xrefs.CacheSave(Writer);
+}
+
+void XrefCacheLoad(const DbFileReader & Reader)
+{
+    xrefs.CacheLoad(Reader);
+}
+
+duint XrefCacheGeneration()
+{
+    return xrefs.GetGeneration();
+}
+
 void XrefClear()
 {
     xrefs.Clear();
@@ -2,6 +2,7 @@
 #define _XREFS_H
 
 #include "_global.h"
+#include "dbfile.h"
 
 bool XrefAdd(duint Address, duint From);
 bool XrefGet(duint Address, XREF_INFO* List);
@@ -11,6 +12,9 @@ bool XrefDeleteAll(duint Address);
 void XrefDelRange(duint Start, duint End);
 void XrefCacheSave(JSON Root);
 void XrefCacheLoad(JSON Root);
+void XrefCacheSave(DbFileWriter & Writer);
+void XrefCacheLoad(const DbFileReader & Reader);
+duint XrefCacheGeneration();
 void XrefClear();
 
 #endif // _FUNCTION_H
\ No newline at end of file
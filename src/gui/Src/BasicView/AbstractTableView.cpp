@@ -1,5 +1,6 @@
 #include "AbstractTableView.h"
 #include <QStyleOptionButton>
+#include <QElapsedTimer>
 #include "Configuration.h"
 #include "ColumnReorderDialog.h"
 
@@ -281,6 +282,61 @@ void AbstractTableView::paintEvent(QPaintEvent* event)
     //emit repainted();
 }
 
+/**
+ * @brief       Paints the cells of the current page into an offscreen image, the rows that are
+ *              currently loaded are repeated to fill rowsPerPage rows.
+ *
+ * @param[in]   pages       Number of times to paint the page
+ * @param[in]   rowsPerPage Number of rows to paint per page
+ *
+ * @return      The elapsed time in milliseconds, -1 if there is nothing to paint.
+ */
+qint64 AbstractTableView::paintBenchmark(int pages, int rowsPerPage)
+{
+    if(mPrevTableOffset != mTableOffset || mShouldReload == true)
+    {
+        prepareData();
+        mPrevTableOffset = mTableOffset;
+        mShouldReload = false;
+    }
+    int loadedRows = mNbrOfLineToPrint;
+    if(!loadedRows || pages <= 0 || rowsPerPage <= 0)
+        return -1;
+    int width = 0;
+    for(int i = 0; i < getColumnCount(); i++)
+        if(!getColumnHidden(i))
+            width += getColumnWidth(i);
+    QImage image(qMax(width, 1), rowsPerPage * getRowHeight(), QImage::Format_RGB32);
+    QElapsedTimer timer;
+    timer.start();
+    for(int page = 0; page < pages; page++)
+    {
+        QPainter painter(&image);
+        painter.setFont(font());
+        painter.fillRect(image.rect(), QBrush(backgroundColor));
+        int x = 0;
+        for(int k = 0; k < getColumnCount(); k++)
+        {
+            int j = mColumnOrder[k];
+            if(getColumnHidden(j))
+                continue;
+            int y = 0;
+            for(int i = 0; i < rowsPerPage; i++)
+            {
+                QString wStr = paintContent(&painter, mTableOffset, i % loadedRows, j, x, y, getColumnWidth(j), getRowHeight());
+                if(wStr.length())
+                {
+                    painter.setPen(textColor);
+                    painter.drawText(QRect(x + 4, y, getColumnWidth(j) - 4, getRowHeight()), Qt::AlignVCenter | Qt::AlignLeft, wStr);
+                }
+                y += getRowHeight();
+            }
+            x += getColumnWidth(j);
+        }
+    }
+    return timer.elapsed();
+}
+
 
 /************************************************************************************
                             Mouse Management
@@ -60,6 +60,7 @@ public:
 
     // Painting Stuff
     void paintEvent(QPaintEvent* event);
+    qint64 paintBenchmark(int pages, int rowsPerPage);
 
     // Mouse Management
     void mouseMoveEvent(QMouseEvent* event);
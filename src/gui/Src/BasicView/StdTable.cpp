@@ -163,6 +163,11 @@ void StdTable::enableColumnSorting(bool enabled)
     mIsColumnSortingAllowed = enabled;
 }
 
+bool StdTable::isSorted() const
+{
+    return mSort.first != -1;
+}
+
 /************************************************************************************
                                 Selection Management
 ************************************************************************************/
@@ -264,6 +269,25 @@ void StdTable::setRowCount(int count)
     AbstractTableView::setRowCount(count);
 }
 
+void StdTable::insertRowAt(int r)
+{
+    if(r < 0 || r > mData.size())
+        return;
+    QList<QString> row;
+    for(int j = 0; j < getColumnCount(); j++)
+        row.append("");
+    mData.insert(r, row);
+    AbstractTableView::setRowCount(mData.size());
+}
+
+void StdTable::removeRowAt(int r)
+{
+    if(r < 0 || r >= mData.size())
+        return;
+    mData.removeAt(r);
+    AbstractTableView::setRowCount(mData.size());
+}
+
 void StdTable::deleteAllColumns()
 {
     setRowCount(0);
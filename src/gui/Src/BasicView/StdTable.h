@@ -19,6 +19,7 @@ public:
 
     void enableMultiSelection(bool enabled);
     void enableColumnSorting(bool enabled);
+    bool isSorted() const;
 
     // Selection Management
     void expandSelectionUpTo(int to);
@@ -31,6 +32,8 @@ public:
     // Data Management
     void addColumnAt(int width, QString title, bool isClickable, QString copyTitle = "");
     void setRowCount(int count);
+    void insertRowAt(int r);
+    void removeRowAt(int r);
     void deleteAllColumns();
     void setCellContent(int r, int c, QString s);
     QString getCellContent(int r, int c);
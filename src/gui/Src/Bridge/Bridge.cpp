@@ -1,5 +1,6 @@
 #include "Bridge.h"
 #include <QClipboard>
+#include <QThread>
 #include "QBeaEngine.h"
 #include "main.h"
 #include "Exports.h"
@@ -14,18 +15,14 @@ static Bridge* mBridge;
 ************************************************************************************/
 Bridge::Bridge(QObject* parent) : QObject(parent)
 {
-    mBridgeMutex = new QMutex();
     winId = 0;
     scriptView = 0;
     referenceManager = 0;
-    bridgeResult = 0;
-    hasBridgeResult = false;
     dbgStopped = false;
 }
 
 Bridge::~Bridge()
 {
-    delete mBridgeMutex;
 }
 
 void Bridge::CopyToClipboard(const QString & text)
@@ -34,10 +31,32 @@ void Bridge::CopyToClipboard(const QString & text)
     clipboard->setText(text);
 }
 
+/**
+\brief Sets the result of the request whose slot is running. Slots that open a modal dialog run
+       other requests in the nested event loop, those finish first, so the innermost one is ours.
+*/
 void Bridge::setResult(dsint result)
 {
-    bridgeResult = result;
-    hasBridgeResult = true;
+    if(mDispatching.empty() || QThread::currentThread() != thread()) //nobody is waiting for this result
+        return;
+    mDispatching.back()->mResult = result;
+}
+
+void Bridge::dispatchResult(BridgeResult* result)
+{
+    mDispatching.push_back(result);
+    result->mEmitter();
+    mDispatching.pop_back();
+    //the waiting thread owns the request, it must not be touched after it was woken
+    QMutexLocker locker(&mResultMutex);
+    result->mDone = true;
+    mResultCondition.wakeAll();
+}
+
+void Bridge::customEvent(QEvent* event)
+{
+    if(event->type() == BridgeResultEvent::EventType)
+        dispatchResult(((BridgeResultEvent*)event)->result);
 }
 
 /************************************************************************************
@@ -64,8 +83,10 @@ void Bridge::emitLoadSourceFile(const QString path, int line, int selection)
 
 void Bridge::emitMenuAddToList(QWidget* parent, QMenu* menu, int hMenu, int hParentMenu)
 {
-    BridgeResult result;
-    emit menuAddMenuToList(parent, menu, hMenu, hParentMenu);
+    BridgeResult result([&]()
+    {
+        emit menuAddMenuToList(parent, menu, hMenu, hParentMenu);
+    });
     result.Wait();
 }
 
@@ -125,8 +146,10 @@ void* Bridge::processMessage(GUIMSG type, void* param1, void* param2)
 
     case GUI_SCRIPT_ADD:
     {
-        BridgeResult result;
-        emit scriptAdd((int)param1, (const char**)param2);
+        BridgeResult result([&]()
+        {
+            emit scriptAdd((int)param1, (const char**)param2);
+        });
         result.Wait();
     }
     break;
@@ -141,8 +164,10 @@ void* Bridge::processMessage(GUIMSG type, void* param1, void* param2)
 
     case GUI_SCRIPT_ERROR:
     {
-        BridgeResult result;
-        emit scriptError((int)param1, QString((const char*)param2));
+        BridgeResult result([&]()
+        {
+            emit scriptError((int)param1, QString((const char*)param2));
+        });
         result.Wait();
     }
     break;
@@ -157,16 +182,20 @@ void* Bridge::processMessage(GUIMSG type, void* param1, void* param2)
 
     case GUI_SCRIPT_MESSAGE:
     {
-        BridgeResult result;
-        emit scriptMessage(QString((const char*)param1));
+        BridgeResult result([&]()
+        {
+            emit scriptMessage(QString((const char*)param1));
+        });
         result.Wait();
     }
     break;
 
     case GUI_SCRIPT_MSGYN:
     {
-        BridgeResult result;
-        emit scriptQuestion(QString((const char*)param1));
+        BridgeResult result([&]()
+        {
+            emit scriptQuestion(QString((const char*)param1));
+        });
         return (void*)result.Wait();
     }
     break;
@@ -238,8 +267,10 @@ void* Bridge::processMessage(GUIMSG type, void* param1, void* param2)
 
     case GUI_REF_INITIALIZE:
     {
-        BridgeResult result;
-        emit referenceInitialize(QString((const char*)param1));
+        BridgeResult result([&]()
+        {
+            emit referenceInitialize(QString((const char*)param1));
+        });
         result.Wait();
     }
     break;
@@ -291,32 +322,40 @@ void* Bridge::processMessage(GUIMSG type, void* param1, void* param2)
 
     case GUI_MENU_ADD:
     {
-        BridgeResult result;
-        emit menuAddMenu((int)param1, QString((const char*)param2));
+        BridgeResult result([&]()
+        {
+            emit menuAddMenu((int)param1, QString((const char*)param2));
+        });
         return (void*)result.Wait();
     }
     break;
 
     case GUI_MENU_ADD_ENTRY:
     {
-        BridgeResult result;
-        emit menuAddMenuEntry((int)param1, QString((const char*)param2));
+        BridgeResult result([&]()
+        {
+            emit menuAddMenuEntry((int)param1, QString((const char*)param2));
+        });
         return (void*)result.Wait();
     }
     break;
 
     case GUI_MENU_ADD_SEPARATOR:
     {
-        BridgeResult result;
-        emit menuAddSeparator((int)param1);
+        BridgeResult result([&]()
+        {
+            emit menuAddSeparator((int)param1);
+        });
         result.Wait();
     }
     break;
 
     case GUI_MENU_CLEAR:
     {
-        BridgeResult result;
-        emit menuClearMenu((int)param1);
+        BridgeResult result([&]()
+        {
+            emit menuClearMenu((int)param1);
+        });
         result.Wait();
     }
     break;
@@ -327,21 +366,23 @@ void* Bridge::processMessage(GUIMSG type, void* param1, void* param2)
         SELECTIONDATA* selection = (SELECTIONDATA*)param2;
         if(!DbgIsDebugging())
             return (void*)false;
-        BridgeResult result;
-        switch(hWindow)
-        {
-        case GUI_DISASSEMBLY:
-            emit selectionDisasmGet(selection);
-            break;
-        case GUI_DUMP:
-            emit selectionDumpGet(selection);
-            break;
-        case GUI_STACK:
-            emit selectionStackGet(selection);
-            break;
-        default:
+        if(hWindow != GUI_DISASSEMBLY && hWindow != GUI_DUMP && hWindow != GUI_STACK)
             return (void*)false;
-        }
+        BridgeResult result([&]()
+        {
+            switch(hWindow)
+            {
+            case GUI_DISASSEMBLY:
+                emit selectionDisasmGet(selection);
+                break;
+            case GUI_DUMP:
+                emit selectionDumpGet(selection);
+                break;
+            case GUI_STACK:
+                emit selectionStackGet(selection);
+                break;
+            }
+        });
         result.Wait();
         if(selection->start > selection->end) //swap start and end
         {
@@ -359,21 +400,23 @@ void* Bridge::processMessage(GUIMSG type, void* param1, void* param2)
         const SELECTIONDATA* selection = (const SELECTIONDATA*)param2;
         if(!DbgIsDebugging())
             return (void*)false;
-        BridgeResult result;
-        switch(hWindow)
-        {
-        case GUI_DISASSEMBLY:
-            emit selectionDisasmSet(selection);
-            break;
-        case GUI_DUMP:
-            emit selectionDumpSet(selection);
-            break;
-        case GUI_STACK:
-            emit selectionStackSet(selection);
-            break;
-        default:
+        if(hWindow != GUI_DISASSEMBLY && hWindow != GUI_DUMP && hWindow != GUI_STACK)
             return (void*)false;
-        }
+        BridgeResult result([&]()
+        {
+            switch(hWindow)
+            {
+            case GUI_DISASSEMBLY:
+                emit selectionDisasmSet(selection);
+                break;
+            case GUI_DUMP:
+                emit selectionDumpSet(selection);
+                break;
+            case GUI_STACK:
+                emit selectionStackSet(selection);
+                break;
+            }
+        });
         return (void*)result.Wait();
     }
     break;
@@ -381,8 +424,10 @@ void* Bridge::processMessage(GUIMSG type, void* param1, void* param2)
     case GUI_GETLINE_WINDOW:
     {
         QString text = "";
-        BridgeResult result;
-        emit getStrWindow(QString((const char*)param1), &text);
+        BridgeResult result([&]()
+        {
+            emit getStrWindow(QString((const char*)param1), &text);
+        });
         if(result.Wait())
         {
             strcpy_s((char*)param2, GUI_MAX_LINE_SIZE, text.toUtf8().constData());
@@ -440,16 +485,17 @@ void* Bridge::processMessage(GUIMSG type, void* param1, void* param2)
     {
         int hMenu = (int)param1;
         const ICONDATA* icon = (const ICONDATA*)param2;
-        BridgeResult result;
-        if(!icon)
-            emit setIconMenu(hMenu, QIcon());
-        else
+        QIcon qIcon;
+        if(icon)
         {
             QImage img;
             img.loadFromData((uchar*)icon->data, icon->size);
-            QIcon qIcon(QPixmap::fromImage(img));
-            emit setIconMenu(hMenu, qIcon);
+            qIcon = QIcon(QPixmap::fromImage(img));
         }
+        BridgeResult result([&]()
+        {
+            emit setIconMenu(hMenu, qIcon);
+        });
         result.Wait();
     }
     break;
@@ -458,16 +504,17 @@ void* Bridge::processMessage(GUIMSG type, void* param1, void* param2)
     {
         int hEntry = (int)param1;
         const ICONDATA* icon = (const ICONDATA*)param2;
-        BridgeResult result;
-        if(!icon)
-            emit setIconMenuEntry(hEntry, QIcon());
-        else
+        QIcon qIcon;
+        if(icon)
         {
             QImage img;
             img.loadFromData((uchar*)icon->data, icon->size);
-            QIcon qIcon(QPixmap::fromImage(img));
-            emit setIconMenuEntry(hEntry, qIcon);
+            qIcon = QIcon(QPixmap::fromImage(img));
         }
+        BridgeResult result([&]()
+        {
+            emit setIconMenuEntry(hEntry, qIcon);
+        });
         result.Wait();
     }
     break;
@@ -506,8 +553,10 @@ void* Bridge::processMessage(GUIMSG type, void* param1, void* param2)
 
     case GUI_GET_GLOBAL_NOTES:
     {
-        BridgeResult result;
-        emit getGlobalNotes(param1);
+        BridgeResult result([&]()
+        {
+            emit getGlobalNotes(param1);
+        });
         result.Wait();
     }
     break;
@@ -521,8 +570,10 @@ void* Bridge::processMessage(GUIMSG type, void* param1, void* param2)
 
     case GUI_GET_DEBUGGEE_NOTES:
     {
-        BridgeResult result;
-        emit getDebuggeeNotes(param1);
+        BridgeResult result([&]()
+        {
+            emit getDebuggeeNotes(param1);
+        });
         result.Wait();
     }
     break;
@@ -541,8 +592,10 @@ void* Bridge::processMessage(GUIMSG type, void* param1, void* param2)
 
     case GUI_REGISTER_SCRIPT_LANG:
     {
-        BridgeResult result;
-        emit registerScriptLang((SCRIPTTYPEINFO*)param1);
+        BridgeResult result([&]()
+        {
+            emit registerScriptLang((SCRIPTTYPEINFO*)param1);
+        });
         result.Wait();
     }
     break;
@@ -574,6 +627,16 @@ void* Bridge::processMessage(GUIMSG type, void* param1, void* param2)
         }
     }
     break;
+
+    case GUI_PAINT_BENCHMARK:
+    {
+        BridgeResult result([&]()
+        {
+            emit paintBenchmark(int(param1));
+        });
+        result.Wait();
+    }
+    break;
     }
     return nullptr;
 }
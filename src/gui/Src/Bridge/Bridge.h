@@ -5,10 +5,27 @@
 #include <QObject>
 #include <QWidget>
 #include <QMutex>
+#include <QWaitCondition>
+#include <QEvent>
+#include <vector>
 #include "Imports.h"
 #include "ReferenceManager.h"
 #include "BridgeResult.h"
 
+class BridgeResultEvent : public QEvent
+{
+public:
+    static const QEvent::Type EventType = QEvent::User;
+
+    explicit BridgeResultEvent(BridgeResult* result)
+        : QEvent(EventType),
+          result(result)
+    {
+    }
+
+    BridgeResult* result;
+};
+
 class Bridge : public QObject
 {
     Q_OBJECT
@@ -123,11 +140,17 @@ signals:
     void focusDisasm();
     void focusDump();
     void focusStack();
+    void paintBenchmark(int count);
+
+protected:
+    void customEvent(QEvent* event) override;
 
 private:
-    QMutex* mBridgeMutex;
-    dsint bridgeResult;
-    volatile bool hasBridgeResult;
+    void dispatchResult(BridgeResult* result);
+
+    QMutex mResultMutex;
+    QWaitCondition mResultCondition;
+    std::vector<BridgeResult*> mDispatching; //requests whose slots are running on the GUI thread, innermost last
     volatile bool dbgStopped;
 };
 
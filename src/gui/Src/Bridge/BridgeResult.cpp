@@ -1,20 +1,31 @@
 #include "BridgeResult.h"
 #include "Bridge.h"
+#include <QThread>
+#include <QCoreApplication>
 
-BridgeResult::BridgeResult()
+BridgeResult::BridgeResult(const std::function<void()> & emitter)
+    : mEmitter(emitter),
+      mResult(0),
+      mDone(false)
 {
-    Bridge::getBridge()->mBridgeMutex->lock();
-    Bridge::getBridge()->hasBridgeResult = false;
-}
-
-BridgeResult::~BridgeResult()
-{
-    Bridge::getBridge()->mBridgeMutex->unlock();
 }
 
+/**
+\brief Emits the request on the GUI thread and waits until its slots returned.
+\return The value the slot passed to Bridge::setResult.
+*/
 dsint BridgeResult::Wait()
 {
-    while(!Bridge::getBridge()->hasBridgeResult) //wait for thread completion
-        Sleep(100);
-    return Bridge::getBridge()->bridgeResult;
+    Bridge* bridge = Bridge::getBridge();
+    if(QThread::currentThread() == bridge->thread())
+    {
+        bridge->dispatchResult(this);
+        return mResult;
+    }
+    //posted events reach the GUI thread in the order they were posted, like queued signals
+    QCoreApplication::postEvent(bridge, new BridgeResultEvent(this));
+    QMutexLocker locker(&bridge->mResultMutex);
+    while(!mDone) //wait for the GUI thread to handle the request
+        bridge->mResultCondition.wait(&bridge->mResultMutex);
+    return mResult;
 }
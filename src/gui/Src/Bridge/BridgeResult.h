@@ -1,14 +1,21 @@
 #ifndef BRIDGERESULT_H
 #define BRIDGERESULT_H
 
+#include <functional>
 #include "Imports.h"
 
 class BridgeResult
 {
 public:
-    BridgeResult();
-    ~BridgeResult();
+    explicit BridgeResult(const std::function<void()> & emitter);
     dsint Wait();
+
+private:
+    friend class Bridge;
+
+    std::function<void()> mEmitter; //emits the request signal, runs on the GUI thread
+    dsint mResult;
+    bool mDone;
 };
 
 #endif // BRIDGERESULT_H
@@ -30,6 +30,7 @@ CPUDisassembly::CPUDisassembly(CPUWidget* parent) : Disassembly(parent)
     connect(Bridge::getBridge(), SIGNAL(selectionDisasmSet(const SELECTIONDATA*)), this, SLOT(selectionSetSlot(const SELECTIONDATA*)));
     connect(Bridge::getBridge(), SIGNAL(displayWarning(QString, QString)), this, SLOT(displayWarningSlot(QString, QString)));
     connect(Bridge::getBridge(), SIGNAL(focusDisasm()), this, SLOT(setFocus()));
+    connect(Bridge::getBridge(), SIGNAL(paintBenchmark(int)), this, SLOT(paintBenchmarkSlot(int)));
 
     Initialize();
 }
@@ -380,6 +381,7 @@ void CPUDisassembly::setupRightClickContextMenu()
     QAction* traceRecordEnableBit = makeAction(tr("Bit"), SLOT(ActionTraceRecordBitSlot()));
     QAction* traceRecordEnableByte = makeAction(tr("Byte"), SLOT(ActionTraceRecordByteSlot()));
     QAction* traceRecordEnableWord = makeAction(tr("Word"), SLOT(ActionTraceRecordWordSlot()));
+    QAction* traceRecordEnableFullCounter = makeAction(tr("Full counter"), SLOT(ActionTraceRecordFullCounterSlot()));
     mMenuBuilder->addMenu(makeMenu(QIcon(":/icons/images/trace.png"), tr("Trace record")), [ = ](QMenu * menu)
     {
         if(DbgFunctions()->GetTraceRecordType(rvaToVa(getInitialSelection())) == TRACERECORDTYPE::TraceRecordNone)
@@ -387,6 +389,7 @@ void CPUDisassembly::setupRightClickContextMenu()
             menu->addAction(traceRecordEnableBit);
             menu->addAction(traceRecordEnableByte);
             menu->addAction(traceRecordEnableWord);
+            menu->addAction(traceRecordEnableFullCounter);
         }
         else
             menu->addAction(traceRecordDisable);
@@ -1024,6 +1027,17 @@ void CPUDisassembly::selectionGetSlot(SELECTIONDATA* selection)
     Bridge::getBridge()->setResult(1);
 }
 
+void CPUDisassembly::paintBenchmarkSlot(int count)
+{
+    const int rows = 100;
+    qint64 elapsed = paintBenchmark(count, rows);
+    if(elapsed < 0)
+        GuiAddLogMessage(tr("Nothing to paint!\n").toUtf8().constData());
+    else
+        GuiAddLogMessage(tr("%1 page(s) of %2 rows painted in %3ms (%4us per page)\n").arg(count).arg(rows).arg(elapsed).arg(elapsed * 1000.0 / count, 0, 'f', 1).toUtf8().constData());
+    Bridge::getBridge()->setResult(1);
+}
+
 void CPUDisassembly::selectionSetSlot(const SELECTIONDATA* selection)
 {
     dsint selMin = getBase();
@@ -1424,6 +1438,12 @@ void CPUDisassembly::ActionTraceRecordWordSlot()
         GuiAddLogMessage("Failed to set trace record.\n");
 }
 
+void CPUDisassembly::ActionTraceRecordFullCounterSlot()
+{
+    if(!(DbgFunctions()->SetTraceRecordType(rvaToVa(getInitialSelection()), TRACERECORDTYPE::TraceRecordByteWithExecTypeAndFullCounter)))
+        GuiAddLogMessage("Failed to set trace record.\n");
+}
+
 void CPUDisassembly::ActionTraceRecordDisableSlot()
 {
     if(!(DbgFunctions()->SetTraceRecordType(rvaToVa(getInitialSelection()), TRACERECORDTYPE::TraceRecordNone)))
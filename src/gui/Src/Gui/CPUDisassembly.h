@@ -66,6 +66,7 @@ public slots:
     void findPatternSlot();
     void selectionGetSlot(SELECTIONDATA* selection);
     void selectionSetSlot(const SELECTIONDATA* selection);
+    void paintBenchmarkSlot(int count);
     void enableHighlightingModeSlot();
     void binaryEditSlot();
     void binaryFillSlot();
@@ -90,6 +91,7 @@ public slots:
     void ActionTraceRecordBitSlot();
     void ActionTraceRecordByteSlot();
     void ActionTraceRecordWordSlot();
+    void ActionTraceRecordFullCounterSlot();
     void ActionTraceRecordDisableSlot();
     void displayWarningSlot(QString title, QString text);
     void labelHelpSlot();
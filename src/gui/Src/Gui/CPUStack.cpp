@@ -17,6 +17,9 @@ CPUStack::CPUStack(CPUMultiDump* multiDump, QWidget* parent) : HexDump(parent)
     mMultiDump = multiDump;
 
     mForceColumn = 1;
+    mAnnotationsStart = 0;
+    mAnnotationsCsp = 0;
+    mAnnotationsValid = false;
 
     wColDesc.isData = true; //void*
     wColDesc.itemCount = 1;
@@ -48,6 +51,7 @@ CPUStack::CPUStack(CPUMultiDump* multiDump, QWidget* parent) : HexDump(parent)
     connect(Bridge::getBridge(), SIGNAL(selectionStackSet(const SELECTIONDATA*)), this, SLOT(selectionSet(const SELECTIONDATA*)));
     connect(Bridge::getBridge(), SIGNAL(dbgStateChanged(DBGSTATE)), this, SLOT(dbgStateChangedSlot(DBGSTATE)));
     connect(Bridge::getBridge(), SIGNAL(focusStack()), this, SLOT(setFocus()));
+    connect(Bridge::getBridge(), SIGNAL(updateDump()), this, SLOT(invalidateAnnotationsSlot()));
 
     Initialize();
 }
@@ -318,7 +322,7 @@ void CPUStack::getColumnRichText(int col, dsint rva, RichTextPainter::List & ric
     if(wVa < mCsp) //inactive stack
         wActiveStack = false;
 
-    STACK_COMMENT comment;
+    const STACK_ANNOTATION* annotation;
     RichTextPainter::CustomRichText_t curData;
     curData.highlight = false;
     curData.flags = RichTextPainter::FlagColor;
@@ -337,8 +341,9 @@ void CPUStack::getColumnRichText(int col, dsint rva, RichTextPainter::List & ric
             }
         }
     }
-    else if(col && DbgStackCommentGet(rvaToVa(wRva), &comment)) //paint stack comments
+    else if(col && (annotation = getAnnotation(wVa)) && annotation->hasComment) //paint stack comments
     {
+        const STACK_COMMENT & comment = annotation->comment;
         if(wActiveStack)
         {
             if(*comment.color)
@@ -373,7 +378,8 @@ QString CPUStack::paintContent(QPainter* painter, dsint rowBase, int rowOffset,
     if(col == 0) // paint stack address
     {
         QColor background;
-        if(DbgGetLabelAt(wVa, SEG_DEFAULT, nullptr)) //label
+        auto annotation = getAnnotation(wVa);
+        if(annotation ? annotation->hasLabel : DbgGetLabelAt(wVa, SEG_DEFAULT, nullptr)) //label
         {
             if(wVa == mCsp) //CSP
             {
@@ -522,11 +528,46 @@ void CPUStack::mouseDoubleClickEvent(QMouseEvent* event)
     }
 }
 
+/**
+ * @brief       Returns the annotation of a stack slot. A window of three screens around the
+ *              slot is fetched at once and reused until the stack is updated, so repaints and
+ *              scrolling within the window do not call into the debugger.
+ *
+ * @param[in]   va      Address of the stack slot
+ *
+ * @return      The annotation, nullptr if the window could not be read.
+ */
+const STACK_ANNOTATION* CPUStack::getAnnotation(duint va)
+{
+    if(!DbgIsDebugging())
+        return nullptr;
+    const duint slotSize = sizeof(duint);
+    if(mAnnotationsValid && mAnnotationsCsp == mCsp && va >= mAnnotationsStart && (va - mAnnotationsStart) % slotSize == 0)
+    {
+        duint index = (va - mAnnotationsStart) / slotSize;
+        if(index < mAnnotations.size())
+            return &mAnnotations[index];
+    }
+    duint rows = qMax(getViewableRowsCount(), 16);
+    duint before = qMin(rows, va / slotSize);
+    mAnnotations.resize(rows * 3);
+    mAnnotationsStart = va - before * slotSize;
+    mAnnotationsCsp = mCsp;
+    mAnnotationsValid = DbgFunctions()->GetStackAnnotations(mAnnotationsStart, mAnnotations.size(), mAnnotations.data());
+    return mAnnotationsValid ? &mAnnotations[before] : nullptr;
+}
+
+void CPUStack::invalidateAnnotationsSlot()
+{
+    mAnnotationsValid = false;
+}
+
 void CPUStack::stackDumpAt(duint addr, duint csp)
 {
     setFocus();
     addVaToHistory(addr);
     mCsp = csp;
+    mAnnotationsValid = false;
     printDumpAt(addr);
 }
 
@@ -690,6 +731,7 @@ void CPUStack::binaryEditSlot()
     mMemPage->read(data, selStart, newSize);
     QByteArray patched = hexEdit.mHexEdit->applyMaskedData(QByteArray((const char*)data, newSize));
     mMemPage->write(patched.constData(), selStart, patched.size());
+    mAnnotationsValid = false;
     GuiUpdateAllViews();
 }
 
@@ -711,6 +753,7 @@ void CPUStack::binaryFillSlot()
     hexEdit.mHexEdit->fill(0, QString(pattern));
     QByteArray patched(hexEdit.mHexEdit->data());
     mMemPage->write(patched, selStart, patched.size());
+    mAnnotationsValid = false;
     GuiUpdateAllViews();
 }
 
@@ -740,6 +783,7 @@ void CPUStack::binaryPasteSlot()
     if(patched.size() < selSize)
         selSize = patched.size();
     mMemPage->write(patched.constData(), selStart, selSize);
+    mAnnotationsValid = false;
     GuiUpdateAllViews();
 }
 
@@ -756,6 +800,7 @@ void CPUStack::binaryPasteIgnoreSizeSlot()
     QByteArray patched = hexEdit.mHexEdit->applyMaskedData(QByteArray((const char*)data, selSize));
     delete [] data;
     mMemPage->write(patched.constData(), selStart, patched.size());
+    mAnnotationsValid = false;
     GuiUpdateAllViews();
 }
 
@@ -867,6 +912,7 @@ void CPUStack::undoSelectionSlot()
     if(!DbgFunctions()->PatchInRange(start, end)) //nothing patched in selected range
         return;
     DbgFunctions()->PatchRestoreRange(start, end);
+    mAnnotationsValid = false;
     reloadData();
 }
 
@@ -881,6 +927,7 @@ void CPUStack::modifySlot()
         return;
     value = wEditDialog.getVal();
     mMemPage->write(&value, addr, sizeof(dsint));
+    mAnnotationsValid = false;
     GuiUpdateAllViews();
 }
 
@@ -898,6 +945,7 @@ void CPUStack::freezeStackSlot()
 
 void CPUStack::dbgStateChangedSlot(DBGSTATE state)
 {
+    mAnnotationsValid = false;
     if(state == initialized)
         bStackFrozen = false;
 
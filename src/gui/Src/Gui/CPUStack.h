@@ -66,11 +66,20 @@ public slots:
     void modifySlot();
     void freezeStackSlot();
     void dbgStateChangedSlot(DBGSTATE state);
+    void invalidateAnnotationsSlot();
 
 private:
+    const STACK_ANNOTATION* getAnnotation(duint va);
+
     duint mCsp;
     bool bStackFrozen;
 
+    // Comments and label flags of the slots around the visible rows, fetched in one call
+    std::vector<STACK_ANNOTATION> mAnnotations;
+    duint mAnnotationsStart;
+    duint mAnnotationsCsp;
+    bool mAnnotationsValid;
+
     QMenu* mBinaryMenu;
     QAction* mBinaryEditAction;
     QAction* mBinaryFillAction;
@@ -203,22 +203,19 @@ void HandlesView::disableAllPrivilegesSlot()
 
 void HandlesView::enumHandles()
 {
-    BridgeList<HANDLEINFO> handles;
-    if(DbgFunctions()->EnumHandles(&handles))
+    BridgeList<HANDLEDETAILS> handles;
+    if(DbgFunctions()->EnumHandleDetails(&handles, true))
     {
         auto count = handles.Count();
         mHandlesTable->setRowCount(count);
         for(auto i = 0; i < count; i++)
         {
-            const HANDLEINFO & handle = handles[i];
-            char name[MAX_STRING_SIZE] = "";
-            char typeName[MAX_STRING_SIZE] = "";
-            DbgFunctions()->GetHandleName(handle.Handle, name, sizeof(name), typeName, sizeof(typeName));
-            mHandlesTable->setCellContent(i, 0, typeName);
+            const HANDLEDETAILS & handle = handles[i];
+            mHandlesTable->setCellContent(i, 0, handle.TypeName);
             mHandlesTable->setCellContent(i, 1, ToHexString(handle.TypeNumber));
             mHandlesTable->setCellContent(i, 2, ToHexString(handle.Handle));
             mHandlesTable->setCellContent(i, 3, ToHexString(handle.GrantedAccess));
-            mHandlesTable->setCellContent(i, 4, name);
+            mHandlesTable->setCellContent(i, 4, handle.Name);
         }
     }
     else
@@ -1,26 +1,39 @@
 #include "LogView.h"
 #include "Configuration.h"
 #include "Bridge.h"
+#include "LineEditDialog.h"
+#include <QDateTime>
+#include <QFile>
 
-LogView::LogView(QWidget* parent) : QTextEdit(parent)
+LogView::LogView(QWidget* parent) : AbstractTableView(parent)
 {
-    updateStyle();
-    this->setUndoRedoEnabled(false);
-    this->setReadOnly(true);
+    mSelection.firstSelectedIndex = 0;
+    mSelection.fromIndex = 0;
+    mSelection.toIndex = -1;
+    mSelecting = false;
+    mSearchCaseSensitive = false;
+
+    duint maxLines = ConfigUint("Gui", "LogMaxLines");
+    mStore.setMaxLines(maxLines ? dsint(maxLines) : 1000000);
+    mStore.setSpillToDisk(ConfigBool("Gui", "LogSpillToDisk"));
+
+    setShowHeader(false);
+    setDrawDebugOnly(false);
+    addColumnAt(0, "", false);
     this->setLoggingEnabled(true);
 
-    connect(Config(), SIGNAL(colorsUpdated()), this, SLOT(updateStyle()));
-    connect(Config(), SIGNAL(fontsUpdated()), this, SLOT(updateStyle()));
     connect(Bridge::getBridge(), SIGNAL(addMsgToLog(QString)), this, SLOT(addMsgToLogSlot(QString)));
     connect(Bridge::getBridge(), SIGNAL(clearLog()), this, SLOT(clearLogSlot()));
 
     setupContextMenu();
+
+    Initialize();
 }
 
-void LogView::updateStyle()
+void LogView::updateFonts()
 {
     setFont(ConfigFont("Log"));
-    setStyleSheet(QString("QTextEdit { color: %1; background-color: %2 }").arg(ConfigColor("AbstractTableViewTextColor").name(), ConfigColor("AbstractTableViewBackgroundColor").name()));
+    invalidateCachedFont();
 }
 
 void LogView::setupContextMenu()
@@ -30,13 +43,17 @@ void LogView::setupContextMenu()
     actionClear->setShortcutContext(Qt::WidgetShortcut);
     this->addAction(actionClear);
     actionCopy = new QAction(tr("&Copy"), this);
-    connect(actionCopy, SIGNAL(triggered()), this, SLOT(copy()));
+    connect(actionCopy, SIGNAL(triggered()), this, SLOT(copySlot()));
     actionCopy->setShortcutContext(Qt::WidgetShortcut);
     this->addAction(actionCopy);
     actionSelectAll = new QAction(tr("Select &All"), this);
-    connect(actionSelectAll, SIGNAL(triggered()), this, SLOT(selectAll()));
+    connect(actionSelectAll, SIGNAL(triggered()), this, SLOT(selectAllSlot()));
     actionSelectAll->setShortcutContext(Qt::WidgetShortcut);
     this->addAction(actionSelectAll);
+    actionFind = new QAction(tr("&Find"), this);
+    connect(actionFind, SIGNAL(triggered()), this, SLOT(findSlot()));
+    actionFind->setShortcutContext(Qt::WidgetShortcut);
+    this->addAction(actionFind);
     actionSave = new QAction(tr("&Save"), this);
     actionSave->setShortcutContext(Qt::WidgetShortcut);
     connect(actionSave, SIGNAL(triggered()), this, SLOT(saveSlot()));
@@ -53,6 +70,7 @@ void LogView::setupContextMenu()
 void LogView::refreshShortcutsSlot()
 {
     actionCopy->setShortcut(ConfigShortcut("ActionCopy"));
+    actionFind->setShortcut(ConfigShortcut("ActionFind"));
     // More shortcuts?
 }
 
@@ -62,6 +80,7 @@ void LogView::contextMenuEvent(QContextMenuEvent* event)
     wMenu.addAction(actionClear);
     wMenu.addAction(actionSelectAll);
     wMenu.addAction(actionCopy);
+    wMenu.addAction(actionFind);
     wMenu.addAction(actionSave);
     if(getLoggingEnabled())
         actionToggleLogging->setText(tr("Disable &Logging"));
@@ -72,19 +91,190 @@ void LogView::contextMenuEvent(QContextMenuEvent* event)
     wMenu.exec(event->globalPos());
 }
 
+QString LogView::paintContent(QPainter* painter, dsint rowBase, int rowOffset, int col, int x, int y, int w, int h)
+{
+    Q_UNUSED(col);
+    dsint index = rowBase + rowOffset;
+    if(index >= mSelection.fromIndex && index <= mSelection.toIndex)
+        painter->fillRect(QRect(x, y, w, h), QBrush(selectionColor));
+    return mStore.line(index);
+}
+
+void LogView::mouseMoveEvent(QMouseEvent* event)
+{
+    if(mSelecting && transY(event->y()) >= 0 && transY(event->y()) <= this->getTableHeigth())
+    {
+        dsint index = getTableOffset() + getIndexOffsetFromY(transY(event->y()));
+        if(index < getRowCount())
+        {
+            expandSelectionUpTo(index);
+            updateViewport();
+            return;
+        }
+    }
+    AbstractTableView::mouseMoveEvent(event);
+}
+
+void LogView::mousePressEvent(QMouseEvent* event)
+{
+    if((event->buttons() & Qt::LeftButton) != 0 && (event->buttons() & Qt::RightButton) == 0 && getGuiState() == AbstractTableView::NoState)
+    {
+        dsint index = getTableOffset() + getIndexOffsetFromY(transY(event->y()));
+        if(index < getRowCount())
+        {
+            if(event->modifiers() & Qt::ShiftModifier)
+                expandSelectionUpTo(index);
+            else
+                setSingleSelection(index);
+            mSelecting = true;
+            updateViewport();
+            return;
+        }
+    }
+    AbstractTableView::mousePressEvent(event);
+}
+
+void LogView::mouseReleaseEvent(QMouseEvent* event)
+{
+    if((event->buttons() & Qt::LeftButton) == 0 && mSelecting)
+    {
+        mSelecting = false;
+        updateViewport();
+        return;
+    }
+    AbstractTableView::mouseReleaseEvent(event);
+}
+
+void LogView::keyPressEvent(QKeyEvent* event)
+{
+    int key = event->key();
+    if((key == Qt::Key_Up || key == Qt::Key_Down) && getRowCount())
+    {
+        dsint index = mSelection.firstSelectedIndex + (key == Qt::Key_Up ? -1 : 1);
+        index = index < 0 ? 0 : index;
+        index = index >= getRowCount() ? getRowCount() - 1 : index;
+        setSingleSelection(index);
+        showLine(index);
+        updateViewport();
+    }
+    else
+        AbstractTableView::keyPressEvent(event);
+}
+
+void LogView::setSingleSelection(dsint index)
+{
+    mSelection.firstSelectedIndex = index;
+    mSelection.fromIndex = index;
+    mSelection.toIndex = index;
+}
+
+void LogView::expandSelectionUpTo(dsint index)
+{
+    if(index < mSelection.firstSelectedIndex)
+    {
+        mSelection.fromIndex = index;
+        mSelection.toIndex = mSelection.firstSelectedIndex;
+    }
+    else
+    {
+        mSelection.fromIndex = mSelection.firstSelectedIndex;
+        mSelection.toIndex = index;
+    }
+}
+
+void LogView::showLine(dsint index)
+{
+    dsint wTopIndex = getTableOffset();
+    dsint wBotIndex = wTopIndex + getViewableRowsCount() - 2;
+    if(index < wTopIndex)
+        setTableOffset(index);
+    else if(index > wBotIndex)
+        setTableOffset(index - getViewableRowsCount() + 2);
+}
+
 void LogView::addMsgToLogSlot(QString msg)
 {
     if(!loggingEnabled)
         return;
-    if(this->document()->characterCount() > 10000 * 100) //limit the log to ~100mb
-        this->clear();
-    this->moveCursor(QTextCursor::End);
-    this->insertPlainText(msg);
+
+    // Only follow the output when the last line is already visible
+    bool follow = getTableOffset() >= getRowCount() - getViewableRowsCount() + 1;
+    dsint evicted = mStore.append(msg);
+    if(evicted)
+    {
+        mSelection.firstSelectedIndex -= evicted;
+        mSelection.fromIndex = qMax(mSelection.fromIndex - evicted, dsint(0));
+        mSelection.toIndex -= evicted;
+    }
+    dsint wOffset = qMax(getTableOffset() - evicted, dsint(0));
+    setRowCount(mStore.lineCount());
+    setTableOffset(follow ? getRowCount() : wOffset);
+
+    int width = mStore.maxLineLength() * mFontMetrics->width(QChar(' ')) + 8;
+    if(width > getColumnWidth(0))
+        setColumnWidth(0, width);
+
+    reloadData();
 }
 
 void LogView::clearLogSlot()
 {
-    this->clear();
+    mStore.clear();
+    setSingleSelection(0);
+    mSelection.toIndex = -1;
+    setRowCount(0);
+    setTableOffset(0);
+    setColumnWidth(0, 0);
+    reloadData();
+}
+
+void LogView::copySlot()
+{
+    QString text;
+    for(dsint i = qMax(mSelection.fromIndex, dsint(0)); i <= mSelection.toIndex && i < mStore.lineCount(); i++)
+    {
+        if(i != mSelection.fromIndex)
+            text += "\r\n";
+        text += mStore.line(i);
+    }
+    if(text.length())
+        Bridge::CopyToClipboard(text);
+}
+
+void LogView::selectAllSlot()
+{
+    setSingleSelection(0);
+    expandSelectionUpTo(getRowCount() - 1);
+    updateViewport();
+}
+
+void LogView::findSlot()
+{
+    LineEditDialog mLineEdit(this);
+    mLineEdit.setWindowTitle(tr("Find"));
+    mLineEdit.setText(mLastSearch);
+    mLineEdit.enableCheckBox(true);
+    mLineEdit.setCheckBoxText(tr("Case sensitive"));
+    mLineEdit.setCheckBox(mSearchCaseSensitive);
+    if(mLineEdit.exec() != QDialog::Accepted || mLineEdit.editText.isEmpty())
+        return;
+    mLastSearch = mLineEdit.editText;
+    mSearchCaseSensitive = mLineEdit.bChecked;
+
+    // Search from the line after the selection and wrap around once
+    Qt::CaseSensitivity cs = mSearchCaseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    dsint start = mSelection.toIndex >= 0 ? mSelection.firstSelectedIndex + 1 : 0;
+    dsint found = mStore.find(mLastSearch, start, cs);
+    if(found == -1 && start)
+        found = mStore.find(mLastSearch, 0, cs);
+    if(found == -1)
+    {
+        GuiAddStatusBarMessage(tr("\"%1\" not found in the log\n").arg(mLastSearch).toUtf8().constData());
+        return;
+    }
+    setSingleSelection(found);
+    showLine(found);
+    reloadData();
 }
 
 void LogView::setLoggingEnabled(bool enabled)
@@ -103,13 +293,12 @@ void LogView::saveSlot()
     fileName = QString("log-%1.txt").arg(QDateTime::currentDateTime().toString().replace(QChar(':'), QChar('-')));
     QFile savedLog(fileName);
     savedLog.open(QIODevice::Append | QIODevice::Text);
-    if(savedLog.error() != QFile::NoError)
+    if(savedLog.error() != QFile::NoError || !mStore.save(savedLog))
     {
         addMsgToLogSlot(tr("Error, log have not been saved.\n"));
     }
     else
     {
-        savedLog.write(this->document()->toPlainText().toUtf8().constData());
         savedLog.close();
         addMsgToLogSlot(tr("Log have been saved to %1\n").arg(fileName));
     }
@@ -1,9 +1,10 @@
 #ifndef LOGVIEW_H
 #define LOGVIEW_H
 
-#include <QTextEdit>
+#include "AbstractTableView.h"
+#include "LogStore.h"
 
-class LogView : public QTextEdit
+class LogView : public AbstractTableView
 {
     Q_OBJECT
 public:
@@ -11,21 +12,48 @@ public:
     void setupContextMenu();
     void contextMenuEvent(QContextMenuEvent* event);
 
+    // Reimplemented Functions
+    QString paintContent(QPainter* painter, dsint rowBase, int rowOffset, int col, int x, int y, int w, int h) override;
+    void updateFonts() override;
+    void mouseMoveEvent(QMouseEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void mouseReleaseEvent(QMouseEvent* event) override;
+    void keyPressEvent(QKeyEvent* event) override;
+
 public slots:
     void refreshShortcutsSlot();
-    void updateStyle();
     void addMsgToLogSlot(QString msg);
     void setLoggingEnabled(bool enabled);
     bool getLoggingEnabled();
 
     void clearLogSlot();
+    void copySlot();
+    void selectAllSlot();
+    void findSlot();
     void saveSlot();
     void toggleLoggingSlot();
+
 private:
+    void setSingleSelection(dsint index);
+    void expandSelectionUpTo(dsint index);
+    void showLine(dsint index);
+
     bool loggingEnabled;
+    LogStore mStore;
+
+    struct
+    {
+        dsint firstSelectedIndex;
+        dsint fromIndex;
+        dsint toIndex;
+    } mSelection;
+    bool mSelecting;
+    QString mLastSearch;
+    bool mSearchCaseSensitive;
 
     QAction* actionCopy;
     QAction* actionSelectAll;
+    QAction* actionFind;
     QAction* actionClear;
     QAction* actionSave;
     QAction* actionToggleLogging;
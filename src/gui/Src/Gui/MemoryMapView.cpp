@@ -1,4 +1,6 @@
 #include <QFileDialog>
+#include <algorithm>
+#include <functional>
 
 #include "MemoryMapView.h"
 #include "Configuration.h"
@@ -8,7 +10,7 @@
 #include "EntropyDialog.h"
 #include "HexEditDialog.h"
 
-MemoryMapView::MemoryMapView(StdTable* parent) : StdTable(parent)
+MemoryMapView::MemoryMapView(StdTable* parent) : StdTable(parent), mMapGeneration(0)
 {
     enableMultiSelection(false);
 
@@ -191,12 +193,8 @@ QString MemoryMapView::paintContent(QPainter* painter, dsint rowBase, int rowOff
 {
     if(col == 0) //address
     {
-        QString wStr = getCellContent(rowBase + rowOffset, col);
-#ifdef _WIN64
-        duint addr = wStr.toULongLong(0, 16);
-#else //x86
-        duint addr = wStr.toULong(0, 16);
-#endif //_WIN64
+        dsint row = rowBase + rowOffset;
+        duint addr = row < mRowBases.size() ? mRowBases[row] : 0;
         if((DbgGetBpxTypeAt(addr)&bp_memory) == bp_memory)
         {
             QString wStr = getCellContent(rowBase + rowOffset, col);
@@ -233,81 +231,189 @@ QString MemoryMapView::paintContent(QPainter* painter, dsint rowBase, int rowOff
     return StdTable::paintContent(painter, rowBase, rowOffset, col, x, y, w, h);
 }
 
-void MemoryMapView::refreshMap()
+void MemoryMapView::setRowContent(int row, const MEMPAGE & page)
 {
-    MEMMAP wMemMapStruct;
-    int wI;
+    QString wS;
+    const MEMORY_BASIC_INFORMATION & wMbi = page.mbi;
 
-    memset(&wMemMapStruct, 0, sizeof(MEMMAP));
+    // Base address
+    wS = QString("%1").arg((duint)wMbi.BaseAddress, sizeof(duint) * 2, 16, QChar('0')).toUpper();
+    setCellContent(row, 0, wS);
 
-    DbgMemMap(&wMemMapStruct);
+    // Size
+    wS = QString("%1").arg((duint)wMbi.RegionSize, sizeof(duint) * 2, 16, QChar('0')).toUpper();
+    setCellContent(row, 1, wS);
 
-    setRowCount(wMemMapStruct.count);
+    // Information
+    wS = QString(page.info);
+    setCellContent(row, 2, wS);
+
+    // State
+    switch(wMbi.State)
+    {
+    case MEM_FREE:
+        wS = QString("FREE");
+        break;
+    case MEM_COMMIT:
+        wS = QString("COMM");
+        break;
+    case MEM_RESERVE:
+        wS = QString("RESV");
+        break;
+    default:
+        wS = QString("????");
+    }
+    setCellContent(row, 3, wS);
 
-    for(wI = 0; wI < wMemMapStruct.count; wI++)
+    // Type
+    switch(wMbi.Type)
     {
-        QString wS;
-        MEMORY_BASIC_INFORMATION wMbi = (wMemMapStruct.page)[wI].mbi;
+    case MEM_IMAGE:
+        wS = QString("IMG");
+        break;
+    case MEM_MAPPED:
+        wS = QString("MAP");
+        break;
+    case MEM_PRIVATE:
+        wS = QString("PRV");
+        break;
+    default:
+        wS = QString("N/A");
+        break;
+    }
+    setCellContent(row, 3, wS);
+
+    // current access protection
+    wS = getProtectionString(wMbi.Protect);
+    setCellContent(row, 4, wS);
+
+    // allocation protection
+    wS = getProtectionString(wMbi.AllocationProtect);
+    setCellContent(row, 5, wS);
+}
+
+// Insertion position of a base address while the rows are in address order
+int MemoryMapView::findRow(duint base) const
+{
+    return int(std::lower_bound(mRowBases.begin(), mRowBases.end(), base) - mRowBases.begin());
+}
 
-        // Base address
-        wS = QString("%1").arg((duint)wMbi.BaseAddress, sizeof(duint) * 2, 16, QChar('0')).toUpper();
-        setCellContent(wI, 0, wS);
+// Row of a base address, -1 if there is none
+int MemoryMapView::rowOf(duint base) const
+{
+    if(isSorted())
+        return mBaseRows.value(base, -1);
+    int row = findRow(base);
+    return row < mRowBases.size() && mRowBases[row] == base ? row : -1;
+}
 
-        // Size
-        wS = QString("%1").arg((duint)wMbi.RegionSize, sizeof(duint) * 2, 16, QChar('0')).toUpper();
-        setCellContent(wI, 1, wS);
+int MemoryMapView::nearestRow(duint base, int fallback) const
+{
+    if(!isSorted())
+        return qMin(findRow(base), mRowBases.size() - 1);
+    int row = rowOf(base);
+    return row != -1 ? row : qMin(fallback, mRowBases.size() - 1);
+}
 
-        // Information
-        wS = QString((wMemMapStruct.page)[wI].info);
-        setCellContent(wI, 2, wS);
+void MemoryMapView::rebuildRowIndex()
+{
+    mBaseRows.clear();
+    if(!isSorted())
+        return;
+    mRowBases.resize(int(getRowCount()));
+    for(int row = 0; row < mRowBases.size(); row++)
+    {
+        mRowBases[row] = getCellContent(row, 0).toULongLong(nullptr, 16);
+        mBaseRows.insert(mRowBases[row], row);
+    }
+}
+
+void MemoryMapView::reloadData()
+{
+    StdTable::reloadData(); //sorts the rows when the user sorted a column
+    rebuildRowIndex();
+}
 
-        // State
-        switch(wMbi.State)
+void MemoryMapView::refreshMap()
+{
+    MEMMAPCHANGES changes;
+    if(!DbgFunctions()->GetMemMapChanges(mMapGeneration, &changes))
+        return;
+    if(!changes.reset && changes.generation == mMapGeneration)
+        return;
+
+    // Remember the regions at the selection and at the top of the view, the rows move around them
+    int selection = getInitialSelection();
+    duint selectedBase = selection >= 0 && selection < mRowBases.size() ? mRowBases[selection] : 0;
+    dsint offset = getTableOffset();
+    duint topBase = offset >= 0 && offset < mRowBases.size() ? mRowBases[offset] : 0;
+
+    if(changes.reset)
+    {
+        setRowCount(changes.pageCount);
+        mRowBases.resize(changes.pageCount);
+        for(int i = 0; i < changes.pageCount; i++)
         {
-        case MEM_FREE:
-            wS = QString("FREE");
-            break;
-        case MEM_COMMIT:
-            wS = QString("COMM");
-            break;
-        case MEM_RESERVE:
-            wS = QString("RESV");
-            break;
-        default:
-            wS = QString("????");
+            mRowBases[i] = (duint)changes.pages[i].mbi.BaseAddress;
+            setRowContent(i, changes.pages[i]);
         }
-        setCellContent(wI, 3, wS);
-
-        // Type
-        switch(wMbi.Type)
+    }
+    else
+    {
+        // Remove from the last row so the row numbers stay valid
+        QVector<int> removedRows;
+        for(int i = 0; i < changes.removedCount; i++)
         {
-        case MEM_IMAGE:
-            wS = QString("IMG");
-            break;
-        case MEM_MAPPED:
-            wS = QString("MAP");
-            break;
-        case MEM_PRIVATE:
-            wS = QString("PRV");
-            break;
-        default:
-            wS = QString("N/A");
-            break;
+            int row = rowOf(changes.removed[i]);
+            if(row != -1)
+                removedRows.append(row);
         }
-        setCellContent(wI, 3, wS);
-
-        // current access protection
-        wS = getProtectionString(wMbi.Protect);
-        setCellContent(wI, 4, wS);
+        std::sort(removedRows.begin(), removedRows.end(), std::greater<int>());
+        for(int row : removedRows)
+        {
+            removeRowAt(row);
+            mRowBases.remove(row);
+        }
+        if(!removedRows.isEmpty() && isSorted())
+        {
+            mBaseRows.clear();
+            for(int row = 0; row < mRowBases.size(); row++)
+                mBaseRows.insert(mRowBases[row], row);
+        }
+        for(int i = 0; i < changes.pageCount; i++)
+        {
+            duint base = (duint)changes.pages[i].mbi.BaseAddress;
+            int row = rowOf(base);
+            if(row == -1)
+            {
+                // A sorted table is sorted again by reloadData, new rows can go anywhere
+                row = isSorted() ? mRowBases.size() : findRow(base);
+                insertRowAt(row);
+                mRowBases.insert(row, base);
+                if(isSorted())
+                    mBaseRows.insert(base, row);
+            }
+            setRowContent(row, changes.pages[i]);
+        }
+    }
+    if(changes.pages)
+        BridgeFree(changes.pages);
+    if(changes.removed)
+        BridgeFree(changes.removed);
+    mMapGeneration = changes.generation;
 
-        // allocation protection
-        wS = getProtectionString(wMbi.AllocationProtect);
-        setCellContent(wI, 5, wS);
+    reloadData(); //refresh memory map
 
+    if(mRowBases.size())
+    {
+        setSingleSelection(nearestRow(selectedBase, selection));
+        setTableOffset(nearestRow(topBase, int(offset)));
+    }
+    else
+    {
+        setSingleSelection(0);
+        setTableOffset(0);
     }
-    if(wMemMapStruct.page != 0)
-        BridgeFree(wMemMapStruct.page);
-    reloadData(); //refresh memory map
 }
 
 void MemoryMapView::stateChangedSlot(DBGSTATE state)
@@ -1,6 +1,7 @@
 #ifndef MEMORYMAPVIEW_H
 #define MEMORYMAPVIEW_H
 
+#include <QHash>
 #include "StdTable.h"
 
 class MemoryMapView : public StdTable
@@ -9,6 +10,7 @@ class MemoryMapView : public StdTable
 public:
     explicit MemoryMapView(StdTable* parent = 0);
     QString paintContent(QPainter* painter, dsint rowBase, int rowOffset, int col, int x, int y, int w, int h);
+    void reloadData() override;
     void setupContextMenu();
 
 signals:
@@ -39,6 +41,15 @@ public slots:
 
 private:
     QString getProtectionString(DWORD Protect);
+    void setRowContent(int row, const MEMPAGE & page);
+    int findRow(duint base) const;
+    int rowOf(duint base) const;
+    int nearestRow(duint base, int fallback) const;
+    void rebuildRowIndex();
+
+    duint mMapGeneration; //generation of the memory map the rows reflect
+    QVector<duint> mRowBases; //base address of every row, in row order (sorted by address unless the user sorted a column)
+    QHash<duint, int> mBaseRows; //row of every base address, only kept while the user sorted a column
 
     QAction* mFollowDump;
     QAction* mFollowDisassembly;
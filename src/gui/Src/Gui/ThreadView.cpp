@@ -2,6 +2,8 @@
 #include "Configuration.h"
 #include "Bridge.h"
 #include "StringUtil.h"
+#include <QSet>
+#include <QHash>
 
 void ThreadView::contextMenuSlot(const QPoint & pos)
 {
@@ -214,187 +216,184 @@ ThreadView::ThreadView(StdTable* parent) : StdTable(parent)
     setupContextMenu();
 }
 
+static QString priorityString(THREADPRIORITY value)
+{
+    switch(value)
+    {
+    case _PriorityIdle:
+        return "Idle";
+    case _PriorityAboveNormal:
+        return "AboveNormal";
+    case _PriorityBelowNormal:
+        return "BelowNormal";
+    case _PriorityHighest:
+        return "Highest";
+    case _PriorityLowest:
+        return "Lowest";
+    case _PriorityNormal:
+        return "Normal";
+    case _PriorityTimeCritical:
+        return "TimeCritical";
+    default:
+        return "Unknown";
+    }
+}
+
+static QString waitReasonString(THREADWAITREASON value)
+{
+    switch(value)
+    {
+    case _Executive:
+        return "Executive";
+    case _FreePage:
+        return "FreePage";
+    case _PageIn:
+        return "PageIn";
+    case _PoolAllocation:
+        return "PoolAllocation";
+    case _DelayExecution:
+        return "DelayExecution";
+    case _Suspended:
+        return "Suspended";
+    case _UserRequest:
+        return "UserRequest";
+    case _WrExecutive:
+        return "WrExecutive";
+    case _WrFreePage:
+        return "WrFreePage";
+    case _WrPageIn:
+        return "WrPageIn";
+    case _WrPoolAllocation:
+        return "WrPoolAllocation";
+    case _WrDelayExecution:
+        return "WrDelayExecution";
+    case _WrSuspended:
+        return "WrSuspended";
+    case _WrUserRequest:
+        return "WrUserRequest";
+    case _WrEventPair:
+        return "WrEventPair";
+    case _WrQueue:
+        return "WrQueue";
+    case _WrLpcReceive:
+        return "WrLpcReceive";
+    case _WrLpcReply:
+        return "WrLpcReply";
+    case _WrVirtualMemory:
+        return "WrVirtualMemory";
+    case _WrPageOut:
+        return "WrPageOut";
+    case _WrRendezvous:
+        return "WrRendezvous";
+    case _Spare2:
+        return "Spare2";
+    case _Spare3:
+        return "Spare3";
+    case _Spare4:
+        return "Spare4";
+    case _Spare5:
+        return "Spare5";
+    case _WrCalloutStack:
+        return "WrCalloutStack";
+    case _WrKernel:
+        return "WrKernel";
+    case _WrResource:
+        return "WrResource";
+    case _WrPushLock:
+        return "WrPushLock";
+    case _WrMutex:
+        return "WrMutex";
+    case _WrQuantumEnd:
+        return "WrQuantumEnd";
+    case _WrDispatchInt:
+        return "WrDispatchInt";
+    case _WrPreempted:
+        return "WrPreempted";
+    case _WrYieldExecution:
+        return "WrYieldExecution";
+    case _WrFastMutex:
+        return "WrFastMutex";
+    case _WrGuardedMutex:
+        return "WrGuardedMutex";
+    case _WrRundown:
+        return "WrRundown";
+    default:
+        return "Unknown";
+    }
+}
+
 void ThreadView::updateThreadList()
 {
-    THREADLIST threadList;
-    memset(&threadList, 0, sizeof(THREADLIST));
-    DbgGetThreadList(&threadList);
-    setRowCount(threadList.count);
-    for(int i = 0; i < threadList.count; i++)
+    BridgeList<THREADINFO> threads;
+    int currentThread = -1;
+    if(!DbgFunctions()->EnumThreads(&threads, &currentThread))
+        return;
+
+    // Only cells that changed are set, the details are fetched when a row is painted.
+    // Rows are matched by thread ID (column 1) because the user may have sorted the table.
+    int count = threads.Count();
+    QSet<QString> threadIds;
+    for(int i = 0; i < count; i++)
+        threadIds.insert(ToHexString(threads[i].ThreadId));
+    for(int row = int(getRowCount()) - 1; row >= 0; row--)
+        if(!threadIds.contains(getCellContent(row, 1)))
+            removeRowAt(row);
+    QHash<QString, int> rows;
+    for(int row = 0; row < getRowCount(); row++)
+        rows.insert(getCellContent(row, 1), row);
+    auto setCellIfChanged = [this](int row, int col, const QString & text)
     {
-        if(!threadList.list[i].BasicInfo.ThreadNumber)
-            setCellContent(i, 0, "Main");
+        if(getCellContent(row, col) != text)
+            setCellContent(row, col, text);
+    };
+    for(int i = 0; i < count; i++)
+    {
+        const THREADINFO & thread = threads[i];
+        QString threadId = ToHexString(thread.ThreadId);
+        auto found = rows.find(threadId);
+        int row;
+        if(found != rows.end())
+            row = found.value();
         else
-            setCellContent(i, 0, ToDecString(threadList.list[i].BasicInfo.ThreadNumber));
-        setCellContent(i, 1, ToHexString(threadList.list[i].BasicInfo.ThreadId));
-        setCellContent(i, 2, ToPtrString(threadList.list[i].BasicInfo.ThreadStartAddress));
-        setCellContent(i, 3, ToPtrString(threadList.list[i].BasicInfo.ThreadLocalBase));
-        setCellContent(i, 4, ToPtrString(threadList.list[i].ThreadCip));
-        setCellContent(i, 5, ToDecString(threadList.list[i].SuspendCount));
-        QString priorityString;
-        switch(threadList.list[i].Priority)
-        {
-        case _PriorityIdle:
-            priorityString = "Idle";
-            break;
-        case _PriorityAboveNormal:
-            priorityString = "AboveNormal";
-            break;
-        case _PriorityBelowNormal:
-            priorityString = "BelowNormal";
-            break;
-        case _PriorityHighest:
-            priorityString = "Highest";
-            break;
-        case _PriorityLowest:
-            priorityString = "Lowest";
-            break;
-        case _PriorityNormal:
-            priorityString = "Normal";
-            break;
-        case _PriorityTimeCritical:
-            priorityString = "TimeCritical";
-            break;
-        default:
-            priorityString = "Unknown";
-            break;
-        }
-        setCellContent(i, 6, priorityString);
-        QString waitReasonString;
-        switch(threadList.list[i].WaitReason)
         {
-        case _Executive:
-            waitReasonString = "Executive";
-            break;
-        case _FreePage:
-            waitReasonString = "FreePage";
-            break;
-        case _PageIn:
-            waitReasonString = "PageIn";
-            break;
-        case _PoolAllocation:
-            waitReasonString = "PoolAllocation";
-            break;
-        case _DelayExecution:
-            waitReasonString = "DelayExecution";
-            break;
-        case _Suspended:
-            waitReasonString = "Suspended";
-            break;
-        case _UserRequest:
-            waitReasonString = "UserRequest";
-            break;
-        case _WrExecutive:
-            waitReasonString = "WrExecutive";
-            break;
-        case _WrFreePage:
-            waitReasonString = "WrFreePage";
-            break;
-        case _WrPageIn:
-            waitReasonString = "WrPageIn";
-            break;
-        case _WrPoolAllocation:
-            waitReasonString = "WrPoolAllocation";
-            break;
-        case _WrDelayExecution:
-            waitReasonString = "WrDelayExecution";
-            break;
-        case _WrSuspended:
-            waitReasonString = "WrSuspended";
-            break;
-        case _WrUserRequest:
-            waitReasonString = "WrUserRequest";
-            break;
-        case _WrEventPair:
-            waitReasonString = "WrEventPair";
-            break;
-        case _WrQueue:
-            waitReasonString = "WrQueue";
-            break;
-        case _WrLpcReceive:
-            waitReasonString = "WrLpcReceive";
-            break;
-        case _WrLpcReply:
-            waitReasonString = "WrLpcReply";
-            break;
-        case _WrVirtualMemory:
-            waitReasonString = "WrVirtualMemory";
-            break;
-        case _WrPageOut:
-            waitReasonString = "WrPageOut";
-            break;
-        case _WrRendezvous:
-            waitReasonString = "WrRendezvous";
-            break;
-        case _Spare2:
-            waitReasonString = "Spare2";
-            break;
-        case _Spare3:
-            waitReasonString = "Spare3";
-            break;
-        case _Spare4:
-            waitReasonString = "Spare4";
-            break;
-        case _Spare5:
-            waitReasonString = "Spare5";
-            break;
-        case _WrCalloutStack:
-            waitReasonString = "WrCalloutStack";
-            break;
-        case _WrKernel:
-            waitReasonString = "WrKernel";
-            break;
-        case _WrResource:
-            waitReasonString = "WrResource";
-            break;
-        case _WrPushLock:
-            waitReasonString = "WrPushLock";
-            break;
-        case _WrMutex:
-            waitReasonString = "WrMutex";
-            break;
-        case _WrQuantumEnd:
-            waitReasonString = "WrQuantumEnd";
-            break;
-        case _WrDispatchInt:
-            waitReasonString = "WrDispatchInt";
-            break;
-        case _WrPreempted:
-            waitReasonString = "WrPreempted";
-            break;
-        case _WrYieldExecution:
-            waitReasonString = "WrYieldExecution";
-            break;
-        case _WrFastMutex:
-            waitReasonString = "WrFastMutex";
-            break;
-        case _WrGuardedMutex:
-            waitReasonString = "WrGuardedMutex";
-            break;
-        case _WrRundown:
-            waitReasonString = "WrRundown";
-            break;
-        default:
-            waitReasonString = "Unknown";
-            break;
+            row = int(getRowCount());
+            insertRowAt(row);
         }
-        setCellContent(i, 7, waitReasonString);
-        setCellContent(i, 8, QString("%1").arg(threadList.list[i].LastError, sizeof(unsigned int) * 2, 16, QChar('0')).toUpper());
-        setCellContent(i, 9, threadList.list[i].BasicInfo.threadName);
+        if(!thread.ThreadNumber)
+            setCellIfChanged(row, 0, "Main");
+        else
+            setCellIfChanged(row, 0, ToDecString(thread.ThreadNumber));
+        setCellIfChanged(row, 1, threadId);
+        setCellIfChanged(row, 2, ToPtrString(thread.ThreadStartAddress));
+        setCellIfChanged(row, 3, ToPtrString(thread.ThreadLocalBase));
+        setCellIfChanged(row, 9, thread.threadName);
     }
+    mDetailsFetched.fill(false, count);
     mCurrentThreadId = "NONE";
-    if(threadList.count)
-    {
-        int currentThread = threadList.CurrentThread;
-        if(currentThread >= 0 && currentThread < threadList.count)
-            mCurrentThreadId = ToHexString(threadList.list[currentThread].BasicInfo.ThreadId);
-        BridgeFree(threadList.list);
-    }
+    if(currentThread >= 0 && currentThread < count)
+        mCurrentThreadId = ToHexString(threads[currentThread].ThreadId);
     reloadData();
 }
 
+void ThreadView::updateThreadDetails(int row)
+{
+    if(row < 0 || row >= mDetailsFetched.size() || mDetailsFetched[row])
+        return;
+    mDetailsFetched[row] = true;
+    THREADALLINFO info;
+    DWORD threadId = getCellContent(row, 1).toUInt(nullptr, 16);
+    if(!DbgFunctions()->GetThreadDetails(threadId, &info))
+        return;
+    setCellContent(row, 4, ToPtrString(info.ThreadCip));
+    setCellContent(row, 5, ToDecString(info.SuspendCount));
+    setCellContent(row, 6, priorityString(info.Priority));
+    setCellContent(row, 7, waitReasonString(info.WaitReason));
+    setCellContent(row, 8, QString("%1").arg(info.LastError, sizeof(unsigned int) * 2, 16, QChar('0')).toUpper());
+}
+
 QString ThreadView::paintContent(QPainter* painter, dsint rowBase, int rowOffset, int col, int x, int y, int w, int h)
 {
+    updateThreadDetails(int(rowBase + rowOffset));
     QString ret = StdTable::paintContent(painter, rowBase, rowOffset, col, x, y, w, h);
     QString threadId = getCellContent(rowBase + rowOffset, 1);
     if(threadId == mCurrentThreadId && !col)
@@ -3,6 +3,7 @@
 
 #include "StdTable.h"
 #include <QMenu>
+#include <QVector>
 
 class ThreadView : public StdTable
 {
@@ -33,7 +34,10 @@ signals:
     void showCpu();
 
 private:
+    void updateThreadDetails(int row);
+
     QString mCurrentThreadId;
+    QVector<bool> mDetailsFetched;
     QAction* mSwitchThread;
     QAction* mSuspendThread;
     QAction* mGoToThreadEntry;
@@ -4,6 +4,8 @@
 #include <QObject>
 #include <QFont>
 #include <QFontMetrics>
+#include <QStaticText>
+#include <QHash>
 
 class CachedFontMetrics : public QObject
 {
@@ -11,6 +13,7 @@ class CachedFontMetrics : public QObject
 public:
     explicit CachedFontMetrics(QObject* parent, const QFont & font)
         : QObject(parent),
+          mFont(font),
           mFontMetrics(font)
     {
         memset(mWidths, 0, sizeof(mWidths));
@@ -48,8 +51,38 @@ public:
         return result;
     }
 
+    struct StaticText
+    {
+        QStaticText text;
+        int width;
+    };
+
+    //the returned reference is valid until the next call
+    const StaticText & staticText(const QString & text)
+    {
+        auto found = mStaticTexts.constFind(text);
+        if(found != mStaticTexts.constEnd())
+            return found.value();
+        if(mStaticTexts.size() >= MaxStaticTexts) //the views repaint the same page over and over, start over instead of tracking usage
+            mStaticTexts.clear();
+        StaticText entry;
+        entry.text.setTextFormat(Qt::PlainText);
+        entry.text.setText(text);
+        entry.width = width(text);
+        return mStaticTexts.insert(text, entry).value();
+    }
+
+    const QFont & font() const
+    {
+        return mFont;
+    }
+
 private:
+    enum { MaxStaticTexts = 16384 };
+
+    QFont mFont;
     QFontMetrics mFontMetrics;
+    QHash<QString, StaticText> mStaticTexts;
     uchar mWidths[0x10000 - 0xE000 + 0xD800];
 };
 
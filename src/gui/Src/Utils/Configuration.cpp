@@ -187,6 +187,7 @@ Configuration::Configuration() : QObject(), noMoreMsgbox(false)
     QMap<QString, bool> guiBool;
     guiBool.insert("FpuRegistersLittleEndian", false);
     guiBool.insert("SaveColumnOrder", true);
+    guiBool.insert("LogSpillToDisk", false);
     defaultBools.insert("Gui", guiBool);
 
     QMap<QString, duint> guiUint;
@@ -205,6 +206,7 @@ Configuration::Configuration() : QObject(), noMoreMsgbox(false)
     AbstractTableView::setupColumnConfigDefaultValue(guiUint, "Handle", 5);
     AbstractTableView::setupColumnConfigDefaultValue(guiUint, "TcpConnection", 3);
     AbstractTableView::setupColumnConfigDefaultValue(guiUint, "Privilege", 2);
+    guiUint.insert("LogMaxLines", 1000000);
     defaultUints.insert("Gui", guiUint);
 
     //uint settings
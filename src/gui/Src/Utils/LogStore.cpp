@@ -0,0 +1,211 @@
+#include "LogStore.h"
+#include <QDir>
+
+LogStore::LogStore(dsint maxLines, bool spillToDisk)
+    : mLineCount(0),
+      mMaxLineLength(0),
+      mEvictedCount(0),
+      mMaxLines(maxLines),
+      mSpillToDisk(spillToDisk),
+      mSpillFile(nullptr)
+{
+}
+
+LogStore::~LogStore()
+{
+    clear();
+}
+
+/**
+ * @brief Appends text to the store. The text may contain any number of lines, a trailing
+ *        partial line is kept and continued by the next call.
+ *
+ * @return The number of lines evicted from the front of the store.
+ */
+dsint LogStore::append(const QString & text)
+{
+    int start = 0;
+    while(true)
+    {
+        int end = text.indexOf(QChar('\n'), start);
+        if(end == -1)
+        {
+            if(start < text.length())
+            {
+                mPartial += text.mid(start);
+                if(mPartial.length() > mMaxLineLength)
+                    mMaxLineLength = mPartial.length();
+            }
+            break;
+        }
+        int len = end - start;
+        if(len && text.at(end - 1) == QChar('\r'))
+            len--;
+        if(mPartial.isEmpty())
+            addLine(text.mid(start, len));
+        else
+        {
+            mPartial += text.mid(start, len);
+            addLine(mPartial);
+            mPartial.clear();
+        }
+        start = end + 1;
+    }
+    return evict();
+}
+
+void LogStore::clear()
+{
+    qDeleteAll(mChunks);
+    mChunks.clear();
+    mLineCount = 0;
+    mPartial.clear();
+    mMaxLineLength = 0;
+    mEvictedCount = 0;
+    delete mSpillFile; //removes the file
+    mSpillFile = nullptr;
+}
+
+dsint LogStore::lineCount() const
+{
+    return mLineCount + (mPartial.isEmpty() ? 0 : 1);
+}
+
+QString LogStore::line(dsint index) const
+{
+    if(index >= 0 && index < mLineCount)
+        return mChunks.at(int(index / ChunkLines))->at(int(index % ChunkLines));
+    if(index == mLineCount)
+        return mPartial;
+    return QString();
+}
+
+int LogStore::maxLineLength() const
+{
+    return mMaxLineLength;
+}
+
+dsint LogStore::evictedCount() const
+{
+    return mEvictedCount;
+}
+
+/**
+ * @brief Searches the lines still in memory for text, starting at line from.
+ *
+ * @return The index of the first matching line, -1 when there is none.
+ */
+dsint LogStore::find(const QString & text, dsint from, Qt::CaseSensitivity cs) const
+{
+    dsint i = from < 0 ? 0 : from;
+    while(i < mLineCount)
+    {
+        const Chunk & chunk = *mChunks.at(int(i / ChunkLines));
+        for(int j = int(i % ChunkLines); j < chunk.size(); j++, i++)
+            if(chunk.at(j).contains(text, cs))
+                return i;
+    }
+    if(i == mLineCount && !mPartial.isEmpty() && mPartial.contains(text, cs))
+        return mLineCount;
+    return -1;
+}
+
+/**
+ * @brief Streams the whole log (spilled lines first) to device in blocks of about 1MB.
+ */
+bool LogStore::save(QIODevice & device)
+{
+    const int blockSize = 1024 * 1024;
+    if(mSpillFile)
+    {
+        mSpillFile->flush();
+        mSpillFile->seek(0);
+        while(!mSpillFile->atEnd())
+        {
+            QByteArray block = mSpillFile->read(blockSize);
+            if(block.isEmpty() || device.write(block) != block.size())
+                return false;
+        }
+        mSpillFile->seek(mSpillFile->size());
+    }
+    QByteArray block;
+    block.reserve(blockSize + 4096);
+    for(const Chunk* chunk : mChunks)
+    {
+        for(const QString & line : *chunk)
+        {
+            block.append(line.toUtf8());
+            block.append('\n');
+            if(block.size() >= blockSize)
+            {
+                if(device.write(block) != block.size())
+                    return false;
+                block.clear();
+            }
+        }
+    }
+    block.append(mPartial.toUtf8());
+    return device.write(block) == block.size();
+}
+
+void LogStore::setMaxLines(dsint maxLines)
+{
+    mMaxLines = maxLines;
+}
+
+void LogStore::setSpillToDisk(bool spillToDisk)
+{
+    mSpillToDisk = spillToDisk;
+}
+
+void LogStore::addLine(const QString & text)
+{
+    if(mChunks.isEmpty() || mChunks.last()->size() == ChunkLines)
+    {
+        mChunks.append(new Chunk());
+        mChunks.last()->reserve(ChunkLines);
+    }
+    mChunks.last()->append(text);
+    mLineCount++;
+    if(text.length() > mMaxLineLength)
+        mMaxLineLength = text.length();
+}
+
+dsint LogStore::evict()
+{
+    //only whole chunks are evicted, so up to ChunkLines - 1 lines above the cap are kept
+    dsint evicted = 0;
+    while(mChunks.size() > 1 && mLineCount - ChunkLines >= mMaxLines)
+    {
+        Chunk* chunk = mChunks.takeFirst();
+        if(mSpillToDisk)
+            spill(*chunk);
+        delete chunk;
+        mLineCount -= ChunkLines;
+        evicted += ChunkLines;
+    }
+    mEvictedCount += evicted;
+    return evicted;
+}
+
+void LogStore::spill(const Chunk & chunk)
+{
+    if(!mSpillFile)
+    {
+        mSpillFile = new QTemporaryFile(QDir::tempPath() + QDir::separator() + "x64dbg-log-XXXXXX.txt");
+        if(!mSpillFile->open())
+        {
+            delete mSpillFile;
+            mSpillFile = nullptr;
+            mSpillToDisk = false;
+            return;
+        }
+    }
+    QByteArray data;
+    for(const QString & line : chunk)
+    {
+        data.append(line.toUtf8());
+        data.append('\n');
+    }
+    mSpillFile->write(data);
+}
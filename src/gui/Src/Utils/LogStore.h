@@ -0,0 +1,61 @@
+#ifndef LOGSTORE_H
+#define LOGSTORE_H
+
+#include <QString>
+#include <QVector>
+#include <QList>
+#include <QIODevice>
+#include <QTemporaryFile>
+#include "Imports.h"
+
+/**
+ * @brief Chunked, append-only line store backing the log view.
+ *
+ * Lines are kept in fixed-size chunks so appending never moves existing
+ * lines. Once the line count exceeds the cap, whole chunks are evicted
+ * oldest-first (optionally spilling them to a temporary file so they
+ * still end up in a saved log).
+ */
+class LogStore
+{
+public:
+    enum
+    {
+        ChunkLines = 4096
+    };
+
+    explicit LogStore(dsint maxLines = 1000000, bool spillToDisk = false);
+    ~LogStore();
+
+    dsint append(const QString & text);
+    void clear();
+
+    dsint lineCount() const;
+    QString line(dsint index) const;
+    int maxLineLength() const;
+    dsint evictedCount() const;
+
+    dsint find(const QString & text, dsint from, Qt::CaseSensitivity cs) const;
+    bool save(QIODevice & device);
+
+    void setMaxLines(dsint maxLines);
+    void setSpillToDisk(bool spillToDisk);
+
+private:
+    typedef QVector<QString> Chunk;
+
+    void addLine(const QString & text);
+    dsint evict();
+    void spill(const Chunk & chunk);
+
+    QList<Chunk*> mChunks;
+    dsint mLineCount; //complete lines in mChunks
+    QString mPartial; //text after the last newline
+    int mMaxLineLength;
+    dsint mEvictedCount;
+    dsint mMaxLines;
+    bool mSpillToDisk;
+    QTemporaryFile* mSpillFile;
+};
+
+#endif // LOGSTORE_H
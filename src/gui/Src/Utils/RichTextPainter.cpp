@@ -1,52 +1,72 @@
 #include "RichTextPainter.h"
 
-//TODO: fix performance (possibly use QTextLayout?)
+/**
+ * @brief       Paints the rich text segments from left to right, starting at x + xinc. Segments
+ *              without a background or highlight are merged into runs that share the current pen,
+ *              every run is drawn once from the QStaticText cache of fontMetrics so it is only
+ *              shaped the first time it is painted.
+ */
 void RichTextPainter::paintRichText(QPainter* painter, int x, int y, int w, int h, int xinc, const List & richText, CachedFontMetrics* fontMetrics)
 {
     QPen pen;
     QPen highlightPen;
     highlightPen.setWidth(2);
     QBrush brush(Qt::cyan);
+    QString run;
+    int runX = xinc;
+    int runWidth = 0;
+    auto flushRun = [&]()
+    {
+        if(run.isEmpty())
+            return;
+        const QStaticText & staticText = fontMetrics->staticText(run).text;
+        if(runX + runWidth > w) //clip the text that goes outside the specified width
+        {
+            painter->save();
+            painter->setClipRect(QRect(x + runX, y, w - runX, h), Qt::IntersectClip);
+            painter->drawStaticText(x + runX, y, staticText);
+            painter->restore();
+        }
+        else
+            painter->drawStaticText(x + runX, y, staticText);
+        run.clear();
+        runWidth = 0;
+    };
     for(const auto & curRichText : richText)
     {
-        int textWidth = fontMetrics->width(curRichText.text);
+        int textWidth = fontMetrics->staticText(curRichText.text).width;
         int backgroundWidth = textWidth;
         if(backgroundWidth + xinc > w)
             backgroundWidth = w - xinc;
         if(backgroundWidth <= 0) //stop drawing when going outside the specified width
             break;
-        switch(curRichText.flags)
+        if(curRichText.flags == FlagBackground || curRichText.flags == FlagAll)
+        {
+            flushRun();
+            brush.setColor(curRichText.textBackground);
+            painter->fillRect(QRect(x + xinc, y, backgroundWidth, h), brush);
+        }
+        if(curRichText.flags == FlagColor || curRichText.flags == FlagAll)
         {
-        case FlagNone: //defaults
-            break;
-        case FlagColor: //color only
             pen.setColor(curRichText.textColor);
-            painter->setPen(pen);
-            break;
-        case FlagBackground: //background only
-            if(backgroundWidth > 0)
-            {
-                brush.setColor(curRichText.textBackground);
-                painter->fillRect(QRect(x + xinc, y, backgroundWidth, h), brush);
-            }
-            break;
-        case FlagAll: //color+background
-            if(backgroundWidth > 0)
+            if(painter->pen() != pen)
             {
-                brush.setColor(curRichText.textBackground);
-                painter->fillRect(QRect(x + xinc, y, backgroundWidth, h), brush);
+                flushRun();
+                painter->setPen(pen);
             }
-            pen.setColor(curRichText.textColor);
-            painter->setPen(pen);
-            break;
         }
-        painter->drawText(QRect(x + xinc, y, w - xinc, h), 0, curRichText.text); //TODO: this bottlenecks
+        if(run.isEmpty())
+            runX = xinc;
+        run += curRichText.text;
+        runWidth += textWidth;
         if(curRichText.highlight)
         {
+            flushRun();
             highlightPen.setColor(curRichText.highlightColor);
             painter->setPen(highlightPen);
             painter->drawLine(x + xinc + 1, y + h - 1, x + xinc + backgroundWidth - 1, y + h - 1);
         }
         xinc += textWidth;
     }
+    flushRun();
 }
@@ -152,6 +152,7 @@ SOURCES += \
     Src/Utils/HexValidator.cpp \
     Src/Utils/LongLongValidator.cpp \
     Src/Utils/MiscUtil.cpp \
+    Src/Utils/LogStore.cpp \
     Src/Gui/XrefBrowseDialog.cpp \
     Src/Gui/CodepageSelectionDialog.cpp \
     Src/Gui/ColumnReorderDialog.cpp
@@ -247,6 +248,7 @@ HEADERS += \
     Src/Utils/HexValidator.h \
     Src/Utils/LongLongValidator.h \
     Src/Utils/MiscUtil.h \
+    Src/Utils/LogStore.h \
     Src/Gui/XrefBrowseDialog.h \
     Src/Gui/CodepageSelectionDialog.h \
     Src/Utils/CachedFontMetrics.h \